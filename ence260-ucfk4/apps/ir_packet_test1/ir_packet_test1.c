@@ -0,0 +1,115 @@
+/** @file   ir_packet_test1.c
+    @author agent
+    @date   19 October 2026
+    @brief  Test program for reliable IR packet communications.
+
+    @defgroup ir_packet_test1 Test program for reliable IR packet communications.
+
+    Push the navswitch east or west to change the count on both boards.
+    Each change is sent as a packet with the new count and a packet
+    number so that lost or repeated packets can be seen.
+*/
+
+#include "system.h"
+#include "navswitch.h"
+#include "tinygl.h"
+#include "pacer.h"
+#include "ir_packet.h"
+#include "../fonts/font5x7_1.h"
+
+
+/* Define polling rate in Hz.  */
+#define LOOP_RATE 300
+
+/* Define text update rate (characters per 10 s).  */
+#define MESSAGE_RATE 10
+
+
+typedef struct
+{
+    uint8_t number;
+    uint8_t count;
+} message_t;
+
+
+static void show_count (uint8_t count)
+{
+    char buffer[2];
+
+    buffer[0] = (count % 10) + '0';
+    buffer[1] = 0;
+    tinygl_text (buffer);
+}
+
+
+int main (void)
+{
+    message_t msg = {0, 5};
+    uint8_t expected = 0;
+
+    system_init ();
+    tinygl_init (LOOP_RATE);
+    tinygl_font_set (&font5x7_1);
+    tinygl_text_speed_set (MESSAGE_RATE);
+    tinygl_text_mode_set (TINYGL_TEXT_MODE_STEP);
+
+    navswitch_init ();
+    ir_packet_init ();
+
+    show_count (msg.count);
+
+    pacer_init (LOOP_RATE);
+
+    /* Paced loop.  */
+    while (1)
+    {
+        message_t rx;
+
+        /* Wait for next tick.  */
+        pacer_wait ();
+
+        tinygl_update ();
+
+        navswitch_update ();
+
+        ir_packet_update ();
+
+        if (ir_packet_send_ready_p ())
+        {
+            bool changed = 0;
+
+            if (navswitch_push_event_p (NAVSWITCH_WEST))
+            {
+                msg.count--;
+                changed = 1;
+            }
+
+            if (navswitch_push_event_p (NAVSWITCH_EAST))
+            {
+                msg.count++;
+                changed = 1;
+            }
+
+            if (changed)
+            {
+                ir_packet_send (&msg, sizeof (msg));
+                msg.number++;
+                show_count (msg.count);
+            }
+        }
+
+        if (ir_packet_recv (&rx, sizeof (rx)) == sizeof (rx))
+        {
+            /* A gap in the packet numbers means that a packet was
+               discarded after too many retries.  */
+            if (rx.number != expected)
+                tinygl_text ("!");
+            else
+                show_count (rx.count);
+            expected = rx.number + 1;
+            msg.count = rx.count;
+        }
+    }
+
+    return 0;
+}
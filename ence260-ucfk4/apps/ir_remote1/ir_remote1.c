@@ -0,0 +1,160 @@
+/** @file   ir_remote1.c
+    @author agent
+    @date   19 October 2026
+    @brief  Learning infrared remote control.
+
+    @defgroup ir_remote1 Learning infrared remote control.
+
+    Push the navswitch north, east, south, or west to send the code
+    stored for that direction.  Push the navswitch down to learn a
+    code: point a remote control at the board, press one of its
+    buttons, and then push the navswitch in the direction to store the
+    code for.  The codes are kept in EEPROM.
+
+    The display shows the protocol of each code learnt or sent: N for
+    NEC, R for an NEC repeat, 5 for RC5, or ? for an unknown protocol.
+*/
+
+#include "system.h"
+#include "navswitch.h"
+#include "tinygl.h"
+#include "pacer.h"
+#include "eeprom.h"
+#include "ir_remote.h"
+#include "../fonts/font5x7_1.h"
+
+
+/* Define polling rate in Hz.  */
+#define LOOP_RATE 500
+
+/* Define text update rate (characters per 10 s).  */
+#define MESSAGE_RATE 10
+
+
+typedef enum {STATE_NORMAL, STATE_LEARN, STATE_STORE} state_t;
+
+
+static const char protocol_chars[] = "?NR5";
+
+
+static int switch_get (void)
+{
+    if (navswitch_push_event_p (NAVSWITCH_NORTH))
+        return 0;
+    else if (navswitch_push_event_p (NAVSWITCH_EAST))
+        return 1;
+    else if (navswitch_push_event_p (NAVSWITCH_SOUTH))
+        return 2;
+    else if (navswitch_push_event_p (NAVSWITCH_WEST))
+        return 3;
+
+    return -1;
+}
+
+
+static void protocol_show (const ir_remote_code_t *code)
+{
+    char buffer[2];
+    uint32_t value;
+
+    buffer[0] = protocol_chars[ir_remote_decode (code, &value)];
+    buffer[1] = 0;
+    tinygl_text (buffer);
+}
+
+
+static bool code_read (int slot, ir_remote_code_t *code)
+{
+    eeprom_read (slot * sizeof (*code), code, sizeof (*code));
+
+    /* When the EEPROM is erased all the bytes are 0xFF.  */
+    return code->count != 0 && code->count <= IR_REMOTE_RUNS_MAX;
+}
+
+
+static void code_write (int slot, const ir_remote_code_t *code)
+{
+    eeprom_write (slot * sizeof (*code), code, sizeof (*code));
+}
+
+
+int main (void)
+{
+    state_t state = STATE_NORMAL;
+    ir_remote_code_t code;
+    int slot;
+
+    system_init ();
+    tinygl_init (LOOP_RATE);
+    tinygl_font_set (&font5x7_1);
+    tinygl_text_speed_set (MESSAGE_RATE);
+    tinygl_text_mode_set (TINYGL_TEXT_MODE_STEP);
+
+    navswitch_init ();
+    ir_remote_init ();
+
+    pacer_init (LOOP_RATE);
+
+    tinygl_text ("X");
+
+    while (1)
+    {
+        /* Wait for next tick.  */
+        pacer_wait ();
+
+        tinygl_update ();
+        navswitch_update ();
+
+        slot = switch_get ();
+
+        switch (state)
+        {
+        case STATE_NORMAL:
+            if (slot != -1 && code_read (slot, &code))
+            {
+                protocol_show (&code);
+                ir_remote_transmit (&code);
+            }
+
+            if (navswitch_push_event_p (NAVSWITCH_PUSH))
+            {
+                tinygl_text ("L");
+                state = STATE_LEARN;
+            }
+
+            /* Discard anything received while not learning.  */
+            ir_remote_receive (&code);
+            break;
+
+        case STATE_LEARN:
+            if (ir_remote_receive (&code))
+            {
+                protocol_show (&code);
+                state = STATE_STORE;
+            }
+
+            if (navswitch_push_event_p (NAVSWITCH_PUSH))
+            {
+                tinygl_text ("X");
+                state = STATE_NORMAL;
+            }
+            break;
+
+        case STATE_STORE:
+            if (slot != -1)
+            {
+                code_write (slot, &code);
+                state = STATE_NORMAL;
+            }
+
+            if (navswitch_push_event_p (NAVSWITCH_PUSH))
+            {
+                tinygl_text ("X");
+                state = STATE_NORMAL;
+            }
+            break;
+        }
+    }
+
+    return 0;
+}
@@ -6,40 +6,48 @@
 #include "system.h"
 #include "ball.h"
 #include <stdbool.h>
-#include "ir_uart.h"
-#include <stdlib.h>
 
 
 
 
-ball_t ball_create(uint8_t pos)
+void ball_create(ball_t* balls, uint8_t num_balls, uint8_t board, uint8_t pos)
 {
-    ball_t ball;
-    ball.active = true; //true if on screen
-    ball.pos = pos;
-    ball.dist = 1; //spawns one row in front of player
-    ball.send = true; //away from player
-    ball.ticks = 0; //timer for moving balls at different rates
-    return ball;
+    for (int i = 0; i < num_balls; i++) {
+        if (!balls[i].active) {
+            balls[i].active = true; //true if on screen
+            balls[i].pos = pos;
+            balls[i].dist = 1; //spawns one row in front of player
+            balls[i].send = true; //away from player
+            balls[i].ticks = 0; //timer for moving balls at different rates
+            balls[i].board = board;
+            return;
+        }
+    }
+    // No free slot so the shot is lost; this is the same on both boards
 }
 
-void ball_update(ball_t* balls, uint8_t* num_balls, uint16_t fire_rate, uint8_t* player_pos, uint8_t* lives)
+void ball_update(ball_t* balls, uint8_t num_balls, uint8_t fire_rate, player_t* players)
 {
-    for (int i = 0; i < *num_balls; i++) {
+    for (int i = 0; i < num_balls; i++) {
         if (balls[i].active) {
             if (balls[i].ticks > fire_rate) {
                 balls[i].ticks = 0;
                 if (balls[i].send) { //if ball moving away from player
-                    if (balls[i].dist < 4) {
+                    if (balls[i].dist < BALL_DIST_MAX) {
                         balls[i].dist++;
                     } else {
-                        balls[i].active = false;
-                        ball_send(balls[i].pos);
-
+                        // Cross to the other board, which faces this one
+                        balls[i].board ^= 1;
+                        balls[i].pos = BALL_LANES - 1 - balls[i].pos;
+                        balls[i].send = false;
                     }
                 } else {
-                    if ((balls[i].dist < 1) && (balls[i].pos == *player_pos)) { //if player hit
-                        (*lives)--;
+                    player_t* player = &players[balls[i].board];
+
+                    if ((balls[i].dist < 1) && (balls[i].pos == player->pos)) { //if player hit
+                        if (player->lives) {
+                            player->lives--;
+                        }
                         balls[i].active = false;
                     } else if (balls[i].dist > 0) {
                         balls[i].dist--; //move ball towards enemy
@@ -53,31 +61,3 @@ void ball_update(ball_t* balls, uint8_t* num_balls, uint16_t fire_rate, uint8_t*
         }
     }
 }
-
-
-void ball_send(uint8_t pos)
-{
-    ir_uart_putc(pos + '0');
-}
-
-
-ball_t ball_recieve(char recieved_ball_char) 
-{
-    ball_t ball = {true, ('6' - recieved_ball_char), 4, false, 0};
-    return ball;
-}
-
-uint8_t ball_arr_clean(ball_t* balls, uint8_t num_balls, uint8_t MAX_BALLS) //Deletes inactive balls in array after certain length
-{
-    ball_t* ballstemp = calloc(MAX_BALLS, sizeof(ball_t));
-    uint8_t new_num_balls = 0;
-    for (int i = 0; i < num_balls; i++) {
-        if (balls[i].active) {
-            ballstemp[new_num_balls] = balls[i];
-            new_num_balls++;
-        }
-    }
-    free(balls);
-    balls = ballstemp; //Points to new array
-    return new_num_balls;
-}
\ No newline at end of file
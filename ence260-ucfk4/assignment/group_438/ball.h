@@ -2,6 +2,10 @@
 #define BALL_H
 
 #include "system.h"
+#include "player.h"
+
+#define BALL_LANES 7            /* Number of lanes (player positions) */
+#define BALL_DIST_MAX 4         /* Furthest row from the player */
 
 
 typedef struct { //struct for representing ball
@@ -10,13 +14,14 @@ typedef struct { //struct for representing ball
     int8_t dist;
     bool send;
     uint8_t ticks;
+    uint8_t board;              /* Player whose board the ball is on */
 } ball_t;
 
-ball_t ball_create(uint8_t pos);
-void ball_update(ball_t* balls, uint8_t* num_balls, uint16_t fire_rate, uint8_t* player_pos, uint8_t* lives);
-ball_t ball_recieve(char recieved_ball_char);
-void ball_send(uint8_t pos);
-uint8_t ball_arr_clean(ball_t* balls, uint8_t num_balls, uint8_t MAX_BALLS);
+// Fire a ball from player on board into a free slot of the pool
+void ball_create(ball_t* balls, uint8_t num_balls, uint8_t board, uint8_t pos);
+
+// Move the balls in the pool, crossing to the other board and hitting players
+void ball_update(ball_t* balls, uint8_t num_balls, uint8_t fire_rate, player_t* players);
 
 
-#endif
\ No newline at end of file
+#endif
@@ -7,31 +7,34 @@
 #include "tinygl.h"
 #include "navswitch.h"
 #include "ir_uart.h"
-#include <stdlib.h>
+#include "ir_clock.h"
+#include "sync.h"
 #include <stdbool.h>
 #include "pacer.h"
 #include "../fonts/font3x5_1.h"
 
 #include "player.h"
 #include "ball.h"
+#include "world.h"
+#include "rollback.h"
 
 
 /* Define polling rates in Hz. */
 #define DISPLAY_TASK_RATE 250      /* Display rate */
 #define NAVSWITCH_TASK_RATE 250    /* Navswitch rate */
-#define GAME_TASK_RATE 250         /* Game rate */
+#define GAME_TASK_RATE 50          /* Game rate (frames exchanged over IR) */
 
 #define PACER_RATE 500             /* Pacer loop - controls main loop */
 #define MESSAGE_RATE 20            /* Text scroll rate */
 #define PIXEL_ON true              /* Pixel turned on */
 #define GUN_COL 4                  /* Column number for the gun */
-#define MAX_BALLS 50               /* Maximum number of balls allowed in array */
-#define LEVEL_1_SPEED 50           /* Level 1: Fire rate (in PACER_RATE cycles) */
-#define LEVEL_2_SPEED 25           /* Level 2: Fire rate (in PACER_RATE cycles) */
-#define LEVEL_3_SPEED 10           /* Level 3: Fire rate (in PACER_RATE cycles) */
+#define LEVEL_1_SPEED 8            /* Level 1: Fire rate (in game frames) */
+#define LEVEL_2_SPEED 3            /* Level 2: Fire rate (in game frames) */
+#define LEVEL_3_SPEED 0            /* Level 3: Fire rate (in game frames) */
 #define START_MSG " PRESS TO START "  /* Start message */
 #define LOSS_MSG " YOU LOST :( PRESS " /* Loss message */
 #define WON_MSG " YOU WON :) PRESS "   /* Win message */
+#define DRAW_MSG " DRAW PRESS "        /* Both players lost in the same frame */
 
 typedef enum {
     STATE_START,       /* Game starting state */
@@ -42,23 +45,10 @@ typedef enum {
 } state_t;
 
 static state_t state = STATE_START;   /* Current game state */
-static player_t* player;            /* Player data structure pointer */
-static ball_t* balls;              /* Array of ball data structures */
 static char LEVEL = '1';            /* Current game level (default: level 1) */
-static uint8_t num_balls = 0;      /* Number of active balls on the screen */
-static uint16_t fire_rate = 0;     /* Ball movement speed (depends on the level selected) */
-
-static char recieve_ir_level = '!'; /* Received level via IR communication ('!' when random character received)*/
-static char received_char;          /* Received character via IR communication */
-
-/* Function to allocate memory for player and balls */
-void allocate_mem(void) {
-    ball_t* ballstemp = calloc(MAX_BALLS, sizeof(ball_t));  // Create array of balls, MAX_BALLS long
-    balls = ballstemp;
-    player_t* playertemp = calloc(1, sizeof(player_t)); // Allocate memory for the player struct
-    player = playertemp;
-    num_balls = 0;
-}
+static uint8_t input = 0;          /* Navswitch events for the next game frame */
+
+static char recieve_ir_level = SYNC_NO_LEVEL; /* Received level via IR communication */
 
 /* Function to increase the game level */
 void inc_level(void) {
@@ -74,23 +64,27 @@ void dec_level(void) {
     }
 }
 
-/* Function to set the fire rate based on the current game level */
-void set_fire_rate(void) {
-    switch (LEVEL) {
-        case '1':
-            fire_rate = LEVEL_1_SPEED; // Slow
-            break;
+/* Function to get the fire rate for a game level */
+uint8_t level_fire_rate(char level) {
+    switch (level) {
         case '2':
-            fire_rate = LEVEL_2_SPEED; // Medium
-            break;
+            return LEVEL_2_SPEED; // Medium
         case '3':
-            fire_rate = LEVEL_3_SPEED; // Fast
-            break;
+            return LEVEL_3_SPEED; // Fast
         default:
-            break;
+            return LEVEL_1_SPEED; // Slow
     }
 }
 
+/* Function to start a game at the current level */
+static void game_start(void) {
+    tinygl_clear();
+    sync_clear();     // Drop anything left from the last game
+    rollback_start(level_fire_rate(LEVEL)); // Both players start the same on both boards
+    input = 0;
+    state = STATE_PLAYING;
+}
+
 /* Function to display scrolling text on the LED matrix */
 static void display_text(const char str[]) {
     tinygl_font_set(&font3x5_1);                        //Smaller sideways text
@@ -109,25 +103,23 @@ void display_character(char character) {
 
 /* Function to check for the level received via IR communication */
 char check_level_sent(void) {
-    if (ir_uart_read_ready_p()) {
-        recieve_ir_level = ir_uart_getc();
-        if ((recieve_ir_level >= '1') && (recieve_ir_level <= '3')) {
-            return recieve_ir_level;
-        }
-    }
-    return '!';    // Wrong character received
+    return sync_level_get();
 }
 
 /* Function to display the player's position on the LED matrix */
-void display_player(player_t* player) {
+void display_player(const player_t* player) {
     display_pixel_set(GUN_COL, player->pos, PIXEL_ON);
 }
 
-/* Function to display the balls on the LED matrix */
-void display_balls(void) {
-    for (int i = 0; i < num_balls; i++) {
-        if (balls[i].active) {
-            display_pixel_set(GUN_COL - balls[i].dist, balls[i].pos, PIXEL_ON);
+/* Function to display the balls on this board on the LED matrix */
+void display_balls(const world_t* world) {
+    for (int p = 0; p < WORLD_PLAYERS; p++) {
+        for (int i = 0; i < WORLD_BALLS; i++) {
+            const ball_t* ball = &world->balls[p][i];
+
+            if (ball->active && ball->board == 0) {
+                display_pixel_set(GUN_COL - ball->dist, ball->pos, PIXEL_ON);
+            }
         }
     }
 }
@@ -140,18 +132,15 @@ static void display_task(void) {
         case STATE_MENU_LEVEL:
             display_character(LEVEL); // Display characters for levels
             recieve_ir_level = check_level_sent();  // Check if other player has selected a level
-            if (recieve_ir_level != '!') { // If level charater received
+            if (recieve_ir_level != SYNC_NO_LEVEL) { // If level charater received
                 LEVEL = recieve_ir_level;
-                tinygl_clear();
-                player_init(player);   //Initialise player
-                state = STATE_PLAYING; //Start playing
+                game_start();          //Start playing
             }
-            set_fire_rate();  // Set ball speed
             break;
         case STATE_PLAYING:
             display_clear();
-            display_player(player);  // Display player pixel
-            display_balls();         // Display all active ball pixels
+            display_player(&rollback_world()->players[0]);  // Display player pixel
+            display_balls(rollback_world());         // Display all active ball pixels
             break;
         case STATE_OVER:
             break;
@@ -175,21 +164,15 @@ static void navswitch_task(void) {
                 state = STATE_MENU_LEVEL; // Transition to the level selection menu
                 break;
             case STATE_MENU_LEVEL:
-                tinygl_clear(); // Clear the display
-                player_init(player); // Initialize the player
-                state = STATE_PLAYING; // Transition to the playing state
-                ir_uart_putc(LEVEL); // Inform the other board of the selected level and to start
+                game_start(); // Transition to the playing state
+                sync_level_send(LEVEL); // Inform the other board of the selected level and to start
                 break;
             case STATE_PLAYING:
-                balls[num_balls] = ball_create(player->pos); // Create a new ball
-                num_balls++;
+                input |= WORLD_INPUT_FIRE; // Fire a ball in the next frame
                 break;
             case STATE_OVER:
                 tinygl_clear(); // Clear the display
                 display_text(START_MSG); // Display the start message
-                free(player); // Free memory associated with the player
-                free(balls); // Free memory associated with the balls
-                allocate_mem(); // Reallocate memory
                 state = STATE_START; // Transition to the start state
                 break;
             default:
@@ -206,7 +189,7 @@ static void navswitch_task(void) {
                 dec_level(); // Decrease the game level
                 break;
             case STATE_PLAYING:
-                player_left(player); // Move the player to the left
+                input |= WORLD_INPUT_LEFT; // Move the player to the left
                 break;
             default:
                 break;
@@ -222,7 +205,7 @@ static void navswitch_task(void) {
                 inc_level(); // Increase the game level
                 break;
             case STATE_PLAYING:
-                player_right(player); // Move the player to the right
+                input |= WORLD_INPUT_RIGHT; // Move the player to the right
                 break;
             default:
                 break;
@@ -230,37 +213,47 @@ static void navswitch_task(void) {
     }
 }
 
-/* Function for the game task, responsible for updating the game state */
+/* Function for the game task, responsible for advancing the game a frame */
 static void game_task(void) {
+    char level;
+
     switch (state) {
         case STATE_START:
             break;
         case STATE_MENU_LEVEL:
             break;
         case STATE_PLAYING:
-            if (ir_uart_read_ready_p()) {
-                received_char = ir_uart_getc();
-                if ((received_char >= '0') && (received_char <= '6')) {
-                    balls[num_balls] = ball_recieve(received_char); // Create a ball based on received data
-                    num_balls++;
-                } else if (received_char == 'G') {
+            // If both boards started at once they both play the higher level
+            level = sync_level_get();
+            if (level != SYNC_NO_LEVEL && level > LEVEL
+                && rollback_fire_rate_set(level_fire_rate(level))) {
+                LEVEL = level;
+            }
+
+            // The frame is skipped while waiting for the other board
+            if (rollback_step(input)) {
+                input = 0;
+            }
+
+            // Only decide the game on frames where both inputs are known
+            switch (world_loser(rollback_confirmed())) {
+                case 0:
+                    tinygl_clear(); // Clear the display
+                    display_text(LOSS_MSG); // Display the loss message
+                    state = STATE_OVER; // Transition to the game over state
+                    break;
+                case 1:
                     tinygl_clear(); // Clear the display
                     display_text(WON_MSG); // Display the win message
                     state = STATE_OVER; // Transition to the game over state
-                }
-            }
-            if (state == STATE_PLAYING) {
-                ball_update(balls, &num_balls, fire_rate, &(player->pos), &(player->lives)); // Update ball positions and check for collisions
-                if (player->lives == 0) {
+                    break;
+                case WORLD_DRAW:
                     tinygl_clear(); // Clear the display
-                    display_text(LOSS_MSG); // Display the loss message
-                    ir_uart_putc('G'); // Inform the other board of the game over
+                    display_text(DRAW_MSG); // Display the draw message
                     state = STATE_OVER; // Transition to the game over state
-                }
-            }
-            if (num_balls >= MAX_BALLS) {
-                // Handle the case when the maximum number of balls is reached
-                // num_balls = ball_arr_clean(balls, num_balls, MAX_BALLS);
+                    break;
+                default:
+                    break;
             }
             break;
         case STATE_OVER:
@@ -277,9 +270,10 @@ int main(void) {
     tinygl_init(DISPLAY_TASK_RATE);
     navswitch_init();
     ir_uart_init();
+    ir_clock_init();
+    sync_init();
 
     display_text(START_MSG); // Display the start message
-    allocate_mem(); // Allocate memory for player and balls
 
     uint16_t display_tick = 0;
     uint16_t navswitch_tick = 0;
@@ -289,6 +283,10 @@ int main(void) {
 
     while (1) {
         pacer_wait();
+        // Line up the ticks with the other board's using the shared clock
+        pacer_adjust(-ir_clock_phase_error(TIMER_RATE / PACER_RATE) / 2);
+
+        sync_update(); // Exchange batched game state with the other board
 
         // Update the display, navigation switch, and game tasks based on their respective rates
         if (display_tick >= (PACER_RATE / DISPLAY_TASK_RATE)) {
@@ -309,7 +307,5 @@ int main(void) {
         game_tick++;
     }
 
-    free(player); // Free memory associated with the player
-    free(balls); // Free memory associated with the balls
     return 0;
 }
@@ -0,0 +1,166 @@
+// File:   rollback.c
+// Author: agent
+// Date:   19/10/2026
+// Descr:  Input prediction and rollback for the shared game world
+
+#include "system.h"
+#include "rollback.h"
+
+#define ROLLBACK_MASK (ROLLBACK_HISTORY - 1)
+
+static world_t confirmed;               /* World at confirmed_frame */
+static uint16_t confirmed_frame;
+static world_t current;                 /* World at frame, partly predicted */
+static uint16_t frame;
+static bool mispredicted;               /* Current world needs recomputing */
+
+static uint8_t local_inputs[ROLLBACK_HISTORY];
+static uint8_t remote_inputs[ROLLBACK_HISTORY];
+static uint16_t remote_frames;
+static uint16_t acked;
+
+
+// True if frame a comes before frame b, allowing for wrap around
+static bool frame_before(uint16_t a, uint16_t b)
+{
+    return (int16_t)(a - b) < 0;
+}
+
+
+static uint16_t frame_min(uint16_t a, uint16_t b)
+{
+    return frame_before(a, b) ? a : b;
+}
+
+
+static void rollback_world_step(world_t* world, uint16_t f)
+{
+    uint8_t inputs[WORLD_PLAYERS];
+
+    inputs[0] = local_inputs[f & ROLLBACK_MASK];
+    // Navswitch events are rare so predict that there are none
+    inputs[1] = frame_before(f, remote_frames) ? remote_inputs[f & ROLLBACK_MASK] : 0;
+    world_step(world, inputs);
+}
+
+
+void rollback_start(uint8_t fire_rate)
+{
+    world_init(&confirmed, fire_rate);
+    current = confirmed;
+    confirmed_frame = 0;
+    frame = 0;
+    mispredicted = 0;
+    remote_frames = 0;
+    acked = 0;
+}
+
+
+bool rollback_fire_rate_set(uint8_t fire_rate)
+{
+    if (remote_frames) {
+        return 0;
+    }
+
+    // Nothing is confirmed yet so replay every frame at the new rate
+    confirmed.fire_rate = fire_rate;
+    mispredicted = 1;
+    rollback_resolve();
+    return 1;
+}
+
+
+bool rollback_step(uint8_t input)
+{
+    // Wait rather than overwrite inputs that are still needed
+    if ((uint16_t)(frame - frame_min(confirmed_frame, acked)) >= ROLLBACK_WINDOW) {
+        return 0;
+    }
+
+    local_inputs[frame & ROLLBACK_MASK] = input & WORLD_INPUT_MASK;
+    rollback_world_step(&current, frame);
+    frame++;
+
+    // The other inputs may have arrived first
+    rollback_resolve();
+    return 1;
+}
+
+
+uint16_t rollback_frames(void)
+{
+    return frame;
+}
+
+
+uint8_t rollback_input_get(uint16_t f)
+{
+    return local_inputs[f & ROLLBACK_MASK];
+}
+
+
+uint16_t rollback_acked(void)
+{
+    return acked;
+}
+
+
+void rollback_ack(uint16_t frames)
+{
+    if (frame_before(acked, frames) && !frame_before(frame, frames)) {
+        acked = frames;
+    }
+}
+
+
+uint16_t rollback_remote_frames(void)
+{
+    return remote_frames;
+}
+
+
+void rollback_remote_input(uint16_t f, uint8_t input)
+{
+    if (f != remote_frames || (uint16_t)(f - confirmed_frame) >= ROLLBACK_HISTORY) {
+        return;
+    }
+
+    input &= WORLD_INPUT_MASK;
+    remote_inputs[f & ROLLBACK_MASK] = input;
+    remote_frames++;
+
+    if (input && frame_before(f, frame)) {
+        mispredicted = 1;
+    }
+}
+
+
+void rollback_resolve(void)
+{
+    uint16_t target = frame_min(frame, remote_frames);
+
+    while (confirmed_frame != target) {
+        rollback_world_step(&confirmed, confirmed_frame);
+        confirmed_frame++;
+    }
+
+    if (mispredicted) {
+        mispredicted = 0;
+        current = confirmed;
+        for (uint16_t f = confirmed_frame; f != frame; f++) {
+            rollback_world_step(&current, f);
+        }
+    }
+}
+
+
+const world_t* rollback_world(void)
+{
+    return &current;
+}
+
+
+const world_t* rollback_confirmed(void)
+{
+    return &confirmed;
+}
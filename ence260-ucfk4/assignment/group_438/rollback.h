@@ -0,0 +1,60 @@
+#ifndef ROLLBACK_H
+#define ROLLBACK_H
+
+#include "system.h"
+#include "world.h"
+
+/* Rollback netcode for the deterministic world.
+   The local player's input is applied straight away and the other
+   player's input is predicted to be nothing, since the inputs are
+   navswitch events.  Two copies of the world are kept: the confirmed
+   world, computed from frames where both inputs are known, and the
+   current world, which is displayed.  When an input arrives from the
+   other board that differs from the prediction, the current world is
+   recomputed from the confirmed world using the inputs now known.
+
+   A board only runs ROLLBACK_WINDOW frames ahead of the frames it
+   knows the inputs for and that the other board has acknowledged;
+   beyond that it waits, as in plain lockstep.  */
+
+#define ROLLBACK_WINDOW 15      /* Frames predicted without the other inputs */
+#define ROLLBACK_HISTORY 32     /* Inputs kept per player, a power of 2 */
+
+
+// Start a new game
+void rollback_start(uint8_t fire_rate);
+
+// Change the fire rate; only possible before any inputs are received
+bool rollback_fire_rate_set(uint8_t fire_rate);
+
+// Advance a frame with the local input; false if waiting for the other board
+bool rollback_step(uint8_t input);
+
+// Number of frames of local input
+uint16_t rollback_frames(void);
+
+// Local input for a frame not yet acknowledged by the other board
+uint8_t rollback_input_get(uint16_t frame);
+
+// Number of frames of local input the other board has
+uint16_t rollback_acked(void);
+
+// The other board has acknowledged this many frames of local input
+void rollback_ack(uint16_t frames);
+
+// Number of frames of the other board's input known
+uint16_t rollback_remote_frames(void);
+
+// Input of the other board; ignored unless frame is rollback_remote_frames()
+void rollback_remote_input(uint16_t frame, uint8_t input);
+
+// Recompute the worlds after a batch of remote inputs
+void rollback_resolve(void);
+
+// World with predicted inputs, for display
+const world_t* rollback_world(void);
+
+// World with known inputs, for deciding the game
+const world_t* rollback_confirmed(void);
+
+#endif
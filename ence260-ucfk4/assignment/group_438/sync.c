@@ -0,0 +1,323 @@
+// File:   sync.c
+// Author: agent
+// Date:   19/10/2026
+// Descr:  Exchange of player inputs over IR for the rollback netcode
+
+#include "system.h"
+#include "sync.h"
+#include "rollback.h"
+#include "ir_uart.h"
+#include "ir_clock.h"
+#include "timer.h"
+#include "crc8.h"
+
+#define SYNC_HEADER 0x80        /* Marks the first byte of a message */
+#define SYNC_TYPE_MASK 0x03
+#define SYNC_TYPE_INPUTS 0x00
+#define SYNC_TYPE_START 0x01
+#define SYNC_COUNT_SHIFT 3
+#define SYNC_COUNT_MASK 0x0f
+#define SYNC_FRAME_MASK 0x7f
+#define SYNC_FIRST_MASK 0x3f
+#define SYNC_GAME_BIT 0x40      /* Low bit of the game number */
+#define SYNC_GAME_MASK 0x7f
+#define SYNC_INPUT_BITS 3
+#define SYNC_CHECK_MASK 0x7f
+#define SYNC_INPUTS_MAX 8       /* Inputs per message, to keep them short */
+#define SYNC_MSG_MAX (3 + SYNC_INPUTS_MAX / 2 + 1)
+
+// Outgoing state
+static char tx_level = SYNC_NO_LEVEL;   /* Level to send until the game starts */
+static uint16_t tx_ack;                 /* Acknowledgement last sent */
+static uint8_t tx_ticks;                /* Pacer ticks since the last message */
+static uint8_t tx_timeout;              /* Ticks before taking the turn back */
+static bool tx_turn;                    /* This board may send */
+static uint16_t tx_random;
+
+// Incoming state
+static uint8_t rx_msg[SYNC_MSG_MAX];
+static uint8_t rx_len;
+static uint8_t rx_need;
+static char rx_level = SYNC_NO_LEVEL;
+static uint8_t rx_game;                 /* Game number of the last start message */
+static bool rx_start;                   /* A start message arrived since sync_clear */
+static uint8_t rx_quiet;                /* Pacer ticks since a character arrived */
+
+static uint8_t game;                    /* Number of games started */
+
+// Counters printed on exit by the test scaffold
+static struct {
+    uint16_t tx_msgs;
+    uint16_t rx_msgs;
+    uint16_t rx_errors;
+    uint16_t rx_stale;
+    uint16_t timeouts;
+    uint16_t frames;
+    uint16_t remote;
+    uint16_t acked;
+} sync_stats;
+
+static const char* const sync_stats_names[] = {
+    "tx_msgs", "rx_msgs", "rx_errors", "rx_stale", "timeouts", "frames", "remote", "acked"
+};
+
+
+void sync_init(void)
+{
+    tx_level = SYNC_NO_LEVEL;
+    tx_ack = 0;
+    tx_ticks = 0;
+    tx_timeout = SYNC_TIMEOUT;
+    tx_turn = 1;
+    tx_random = timer_get();
+
+    rx_len = 0;
+    rx_level = SYNC_NO_LEVEL;
+    rx_quiet = 0;
+
+    system_stats_register("sync", sync_stats_names, (const uint16_t*)&sync_stats,
+                          ARRAY_SIZE(sync_stats_names));
+}
+
+
+void sync_level_send(char level)
+{
+    tx_level = level;
+    // The boards are started by the players at different times
+    tx_random ^= timer_get();
+
+    // sync_clear joined the game that the other board last started;
+    // this one is newer
+    if (game == rx_game) {
+        game = (game + 1) & SYNC_GAME_MASK;
+    }
+}
+
+
+// Pseudo-random number for the backoff
+static uint8_t sync_random(void)
+{
+    tx_random = tx_random * 25173 + 13849;
+    return tx_random >> 8;
+}
+
+
+// Recover a frame number from its low bits and a nearby frame
+static uint16_t sync_frame_expand(uint8_t bits, uint16_t near, uint8_t mask)
+{
+    uint8_t diff = (bits - near) & mask;
+
+    return diff > mask / 2 ? near + diff - mask - 1 : near + diff;
+}
+
+
+// Game bit for the first frame byte of an inputs message
+static uint8_t sync_game_bit(void)
+{
+    return game & 1 ? SYNC_GAME_BIT : 0;
+}
+
+
+// Number of bytes in a message, including the check byte, given its header
+static uint8_t sync_message_size(uint8_t header)
+{
+    uint8_t count = (header >> SYNC_COUNT_SHIFT) & SYNC_COUNT_MASK;
+
+    switch (header & SYNC_TYPE_MASK) {
+        case SYNC_TYPE_START:
+            return 3;
+        case SYNC_TYPE_INPUTS:
+            if (count > SYNC_INPUTS_MAX) {
+                return 0;
+            }
+            return 3 + (count + 1) / 2 + 1;
+        default:
+            return 0;
+    }
+}
+
+
+// Check byte for a message; bit 7 is dropped so it is never a header
+static uint8_t sync_check(const uint8_t* msg, uint8_t len)
+{
+    return crc8(CRC8_INIT, msg, len) & SYNC_CHECK_MASK;
+}
+
+
+static void sync_message_process(void)
+{
+    uint8_t header = rx_msg[0];
+    uint8_t count = (header >> SYNC_COUNT_SHIFT) & SYNC_COUNT_MASK;
+
+    // A lost character can leave the rest of a clock message to be
+    // taken for a message
+    if (sync_check(rx_msg, rx_need - 1) != rx_msg[rx_need - 1]) {
+        sync_stats.rx_errors++;
+        return;
+    }
+    sync_stats.rx_msgs++;
+
+    // The other board has finished sending so it is our turn
+    tx_turn = 1;
+    tx_random ^= timer_get();
+
+    if ((header & SYNC_TYPE_MASK) == SYNC_TYPE_START) {
+        rx_level = '0' + (count & 0x03);
+        rx_game = rx_msg[1];
+        rx_start = 1;
+        // If both boards started at once they both play the higher game
+        if (rx_game > game) {
+            game = rx_game;
+        }
+        return;
+    }
+
+    // Inputs sent before the last game ended would be taken for inputs
+    // of this game
+    if ((rx_msg[1] & SYNC_GAME_BIT) != sync_game_bit()) {
+        sync_stats.rx_stale++;
+        return;
+    }
+
+    uint16_t first = sync_frame_expand(rx_msg[1], rollback_remote_frames(), SYNC_FIRST_MASK);
+
+    rollback_ack(sync_frame_expand(rx_msg[2], rollback_acked(), SYNC_FRAME_MASK));
+    for (uint8_t i = 0; i < count; i++) {
+        uint8_t input = rx_msg[3 + i / 2] >> (SYNC_INPUT_BITS * (i & 1));
+
+        rollback_remote_input(first + i, input); // Known inputs are ignored
+    }
+    rollback_resolve();
+}
+
+
+// Build a message with the inputs not yet acknowledged; 0 if none
+static uint8_t sync_inputs_build(uint8_t* msg)
+{
+    uint16_t first = rollback_acked();
+    uint16_t frames = rollback_frames();
+    uint8_t count = frames - first;
+    uint8_t len;
+
+    if (!count && tx_ack == rollback_remote_frames()) {
+        return 0;
+    }
+    if (count > SYNC_INPUTS_MAX) {
+        count = SYNC_INPUTS_MAX;
+    }
+
+    tx_ack = rollback_remote_frames();
+    msg[0] = SYNC_HEADER | (count << SYNC_COUNT_SHIFT) | SYNC_TYPE_INPUTS;
+    msg[1] = sync_game_bit() | (first & SYNC_FIRST_MASK);
+    msg[2] = tx_ack & SYNC_FRAME_MASK;
+    for (uint8_t i = 0; i < count; i += 2) {
+        msg[3 + i / 2] = rollback_input_get(first + i);
+        if (i + 1 < count) {
+            msg[3 + i / 2] |= rollback_input_get(first + i + 1) << SYNC_INPUT_BITS;
+        }
+    }
+    len = 3 + (count + 1) / 2;
+    msg[len] = sync_check(msg, len);
+    return len + 1;
+}
+
+
+void sync_update(void)
+{
+    uint8_t ch;
+
+    while (ir_uart_read(&ch, 1)) {
+        rx_quiet = 0;
+        // Clock messages start with 0xfc, which is never a header
+        // since bit 2 is always clear
+        if (ir_clock_receive(ch)) {
+            continue;
+        }
+        if (ch & SYNC_HEADER) {
+            rx_msg[0] = ch;
+            rx_len = 1;
+            rx_need = sync_message_size(ch);
+        } else if (rx_len && rx_len < rx_need) {
+            rx_msg[rx_len++] = ch;
+        }
+        if (rx_len && rx_len == rx_need) {
+            rx_len = 0;
+            sync_message_process();
+        }
+    }
+
+    sync_stats.frames = rollback_frames();
+    sync_stats.remote = rollback_remote_frames();
+    sync_stats.acked = rollback_acked();
+
+    // The game has started on the other board once its inputs arrive
+    if (rollback_remote_frames()) {
+        tx_level = SYNC_NO_LEVEL;
+    }
+
+    if (rx_quiet < SYNC_QUIET) {
+        rx_quiet++;
+    }
+    if (tx_ticks < UINT8_MAX) {
+        tx_ticks++;
+    }
+
+    // The message or its answer was lost, or both boards sent at
+    // once; the random backoff stops them colliding again
+    if (!tx_turn && tx_ticks >= tx_timeout) {
+        tx_turn = 1;
+        sync_stats.timeouts++;
+    }
+
+    // Only send in our turn, once the last message has gone, and
+    // when nothing is being received
+    if (!tx_turn || rx_quiet < SYNC_QUIET || !ir_uart_write_finished_p()) {
+        return;
+    }
+
+    // Clock polls and replies go first
+    ir_clock_update();
+    if (!ir_uart_write_finished_p() || tx_ticks < SYNC_SEND_PERIOD) {
+        return;
+    }
+
+    uint8_t msg[3 + SYNC_MSG_MAX];
+    uint8_t len = 0;
+
+    if (tx_level != SYNC_NO_LEVEL) {
+        msg[0] = SYNC_HEADER | ((tx_level - '0') << SYNC_COUNT_SHIFT) | SYNC_TYPE_START;
+        msg[1] = game;
+        msg[2] = sync_check(msg, 2);
+        len = 3;
+    }
+    len += sync_inputs_build(&msg[len]);
+    if (!len) {
+        return;
+    }
+
+    // The other board answers when this has arrived
+    ir_uart_write(msg, len);
+    sync_stats.tx_msgs++;
+    tx_turn = 0;
+    tx_ticks = 0;
+    tx_timeout = SYNC_TIMEOUT + (sync_random() & SYNC_BACKOFF_MASK);
+}
+
+
+char sync_level_get(void)
+{
+    char level = rx_level;
+
+    rx_level = SYNC_NO_LEVEL;
+    return level;
+}
+
+
+void sync_clear(void)
+{
+    // Join the game the other board started or start the next one
+    game = rx_start ? rx_game : (game + 1) & SYNC_GAME_MASK;
+    rx_start = 0;
+    rx_len = 0;
+    rx_level = SYNC_NO_LEVEL;
+}
@@ -0,0 +1,65 @@
+#ifndef SYNC_H
+#define SYNC_H
+
+#include "system.h"
+
+/* Exchange of player inputs between the two boards.
+   Only the inputs of each game frame are sent; each board computes
+   the game from them (see world.h and rollback.h).  There are two
+   messages:
+
+     start:   1 0 0 ll 0 01  0 nnnnnnn  0 kkkkkkk       l = level
+     inputs:  1 cccc 0 00  0 g ffffff  0 aaaaaaa  00 iii iii ...  0 kkkkkkk
+
+   An inputs message carries c inputs for the frames starting at f,
+   two to a byte with the first in the low bits, and acknowledges
+   the first a frames of the other board's inputs; f and a are the
+   low 6 and 7 bits of the frame numbers.  g is the low bit of the
+   number of games started so that inputs left over from the last
+   game are ignored.  The last byte of a message, k,
+   is the low 7 bits of the CRC-8 of the rest.  Each message carries
+   all the inputs that have not been acknowledged so a lost message
+   is made up by the next.
+
+   A start message is repeated until the first input arrives from
+   the other board.  It carries n, the number of the game, which the
+   other board takes for the game it joins so that the game bits agree
+   even if one board has been reset.  If both boards start at once
+   they both take the higher number.
+
+   The IR link is half-duplex so the boards take turns: a board sends
+   one message and waits for the other board's message before sending
+   again.  A board only starts sending when no character has arrived
+   for SYNC_QUIET ticks.  If no message arrives within SYNC_TIMEOUT
+   ticks, plus a random backoff, the board sends anyway since a
+   message was lost or both boards sent at once.  Clock messages are
+   sent at the start of a turn.  An inputs message carries at most 8
+   inputs so it takes at most 33 ms at 2400 baud.
+
+   Header bytes always have bit 2 clear and the other bytes have
+   bit 7 clear so neither is the 0xfc that starts an ir_clock
+   message.  The link is shared with these messages that keep the
+   frames of the two boards in step.  */
+
+#define SYNC_NO_LEVEL '!'       /* Returned when no level received */
+#define SYNC_SEND_PERIOD 20     /* Minimum pacer ticks between messages */
+#define SYNC_TIMEOUT 80         /* Pacer ticks to wait for the other board */
+#define SYNC_BACKOFF_MASK 0x3f  /* Random pacer ticks added to the timeout */
+#define SYNC_QUIET 3            /* Pacer ticks with nothing received to send */
+
+
+void sync_init(void);
+
+// Queue a level selection ('1' to '3') that starts a game
+void sync_level_send(char level);
+
+// Receive and transmit, including clock messages; call every pacer tick
+void sync_update(void);
+
+// Level received since last call or SYNC_NO_LEVEL
+char sync_level_get(void);
+
+// Start a new game, discarding a level and inputs left over from the last one
+void sync_clear(void);
+
+#endif
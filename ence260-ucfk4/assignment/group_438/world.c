@@ -0,0 +1,60 @@
+// File:   world.c
+// Author: agent
+// Date:   19/10/2026
+// Descr:  Deterministic game step shared by both boards
+
+#include "system.h"
+#include "world.h"
+
+
+void world_init(world_t* world, uint8_t fire_rate)
+{
+    for (uint8_t p = 0; p < WORLD_PLAYERS; p++) {
+        player_init(&world->players[p]);
+        for (uint8_t i = 0; i < WORLD_BALLS; i++) {
+            world->balls[p][i].active = 0;
+        }
+    }
+    world->fire_rate = fire_rate;
+}
+
+
+void world_step(world_t* world, const uint8_t inputs[WORLD_PLAYERS])
+{
+    // Fire then move, in the order the navswitch events were handled
+    for (uint8_t p = 0; p < WORLD_PLAYERS; p++) {
+        player_t* player = &world->players[p];
+
+        if (inputs[p] & WORLD_INPUT_FIRE) {
+            ball_create(world->balls[p], WORLD_BALLS, p, player->pos);
+        }
+        if (inputs[p] & WORLD_INPUT_LEFT) {
+            player_left(player);
+        }
+        if (inputs[p] & WORLD_INPUT_RIGHT) {
+            player_right(player);
+        }
+    }
+
+    for (uint8_t p = 0; p < WORLD_PLAYERS; p++) {
+        ball_update(world->balls[p], WORLD_BALLS, world->fire_rate, world->players);
+    }
+}
+
+
+uint8_t world_loser(const world_t* world)
+{
+    bool lost0 = world->players[0].lives == 0;
+    bool lost1 = world->players[1].lives == 0;
+
+    if (lost0 && lost1) {
+        return WORLD_DRAW;
+    }
+    if (lost0) {
+        return 0;
+    }
+    if (lost1) {
+        return 1;
+    }
+    return WORLD_NO_LOSER;
+}
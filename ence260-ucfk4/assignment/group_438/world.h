@@ -0,0 +1,48 @@
+#ifndef WORLD_H
+#define WORLD_H
+
+#include "system.h"
+#include "player.h"
+#include "ball.h"
+
+/* Deterministic game state shared by the two boards.
+   Each board simulates the whole game, both players and all the
+   balls, from the inputs of both players.  Given the same inputs
+   every board computes exactly the same state, so only the inputs
+   need to be exchanged.
+
+   Each board is player 0 in its own copy of the world and the other
+   board is player 1.  The step treats the two players in exactly the
+   same way, and each player's balls stay in that player's pool even
+   after they cross, so the two copies are mirror images of each
+   other and no board has to be the master.  */
+
+#define WORLD_PLAYERS 2
+#define WORLD_BALLS 10          /* Balls in flight per player */
+
+#define WORLD_INPUT_LEFT 0x01   /* Input bits for a frame */
+#define WORLD_INPUT_RIGHT 0x02
+#define WORLD_INPUT_FIRE 0x04
+#define WORLD_INPUT_MASK 0x07
+
+#define WORLD_NO_LOSER 0xff
+#define WORLD_DRAW 0xfe
+
+
+typedef struct {
+    player_t players[WORLD_PLAYERS];
+    ball_t balls[WORLD_PLAYERS][WORLD_BALLS];
+    uint8_t fire_rate;          /* Game frames between ball moves */
+} world_t;
+
+
+// Start a new game
+void world_init(world_t* world, uint8_t fire_rate);
+
+// Advance one game frame with the inputs of each player
+void world_step(world_t* world, const uint8_t inputs[WORLD_PLAYERS]);
+
+// Player with no lives left, WORLD_DRAW, or WORLD_NO_LOSER
+uint8_t world_loser(const world_t* world);
+
+#endif
@@ -0,0 +1,389 @@
+/** @file   hotpath1.c
+    @author agent
+    @date   19 October 2026
+    @brief  Microbenchmarks for the hot paths of the drivers and utils.
+
+    @defgroup hotpath1 Hot path microbenchmarks.
+
+    This calls each of the functions that run on every display refresh
+    or scheduler tick many times and reports the time per call on the
+    PC and the number of simulated register accesses per call.  The
+    time is only a relative measure since the PC is much faster than
+    the AVR but it shows when a change makes a hot path slower.  The
+    register accesses are counted by the scaffold (see
+    drivers/test/avrtest.h) and are the same on every run, so they can
+    be compared exactly between commits.
+
+    The benchmarks to run can be given on the command line, otherwise
+    all are run.  Each is timed REPEATS times and the fastest is
+    reported, as a single line of name=value pairs, for example,
+
+    bench=hotpath1 op=display_update iterations=200000 ns_per_op=127.7 sfr_reads_per_op=9.00 sfr_writes_per_op=9.00
+
+    tinygl_text_advance is private to tinygl so it is measured through
+    tinygl_update with the message advanced on every update; the cost
+    of display_update is subtracted.  task_schedule never returns so
+    the dispatch benchmark jumps out of it from a task once enough
+    tasks have run.  The times include the overhead of counting the
+    register accesses.
+*/
+
+#include "system.h"
+#include "avrtest.h"
+#include "display.h"
+#include "ledmat.h"
+#include "navswitch.h"
+#include "tinygl.h"
+#include "font.h"
+#include "task.h"
+#include "mmelody.h"
+#include "../../fonts/font5x7_1.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <time.h>
+
+
+/* Number of times each benchmark is timed.  */
+#define REPEATS 5
+
+/* Rate that mmelody_update is called (Hz).  */
+#define MMELODY_RATE 500
+
+
+typedef struct
+{
+    /* Name of the function being measured.  */
+    const char *name;
+    /* Called before each timing run.  */
+    void (*setup) (void);
+    /* Called for each iteration.  */
+    void (*op) (uint32_t i);
+    /* Number of iterations for each timing run.  */
+    uint32_t iterations;
+    /* Non-zero to subtract the cost of display_update.  */
+    bool net_display;
+} hotpath_t;
+
+
+typedef struct
+{
+    double ns;
+    double reads;
+    double writes;
+} result_t;
+
+
+static mmelody_obj_t mmelody_obj;
+static mmelody_t mmelody;
+
+static task_t tasks[3];
+static uint32_t task_runs;
+static uint32_t task_runs_max;
+static jmp_buf task_exit;
+
+static volatile uint32_t sink;
+
+
+static double now_get (void)
+{
+    struct timespec time;
+
+    clock_gettime (CLOCK_MONOTONIC, &time);
+    return time.tv_sec * 1e9 + time.tv_nsec;
+}
+
+
+static void tinygl_setup (void)
+{
+    tinygl_init (1000);
+    tinygl_font_set (&font5x7_1);
+    tinygl_clear ();
+}
+
+
+static void draw_line_op (uint32_t i)
+{
+    tinygl_coord_t x = i % TINYGL_WIDTH;
+
+    /* Alternate between steep and shallow lines.  */
+    if (i & 1)
+        tinygl_draw_line (tinygl_point (x, 0),
+                          tinygl_point (TINYGL_WIDTH - 1 - x,
+                                        TINYGL_HEIGHT - 1), i & 2);
+    else
+        tinygl_draw_line (tinygl_point (0, x),
+                          tinygl_point (TINYGL_WIDTH - 1, TINYGL_HEIGHT - 1 - x),
+                          i & 2);
+}
+
+
+static void draw_char_op (uint32_t i)
+{
+    tinygl_draw_char ('A' + i % 26, tinygl_point (0, 0));
+}
+
+
+static void text_setup (tinygl_text_mode_t mode)
+{
+    /* With an update rate of 1 Hz the advance period rounds to zero so
+       tinygl_update advances the message every time.  */
+    tinygl_init (1);
+    tinygl_font_set (&font5x7_1);
+    tinygl_text_mode_set (mode);
+    tinygl_text ("HELLO WORLD");
+}
+
+
+static void text_step_setup (void)
+{
+    text_setup (TINYGL_TEXT_MODE_STEP);
+}
+
+
+static void text_scroll_setup (void)
+{
+    text_setup (TINYGL_TEXT_MODE_SCROLL);
+}
+
+
+static void text_advance_op (uint32_t i)
+{
+    (void) i;
+    tinygl_update ();
+}
+
+
+static void font_pixel_get_op (uint32_t i)
+{
+    sink += font_pixel_get (&font5x7_1, 'A' + i % 26,
+                            i % FONT5X7_1_WIDTH, (i / 8) % FONT5X7_1_HEIGHT);
+}
+
+
+static void display_setup (void)
+{
+    uint8_t col;
+
+    display_init ();
+    for (col = 0; col < LEDMAT_COLS_NUM; col++)
+        display_pixel_set (col, col, 1);
+}
+
+
+static void display_update_op (uint32_t i)
+{
+    (void) i;
+    display_update ();
+}
+
+
+static void ledmat_setup (void)
+{
+    ledmat_init ();
+}
+
+
+static void ledmat_display_column_op (uint32_t i)
+{
+    ledmat_display_column (i, i % LEDMAT_COLS_NUM);
+}
+
+
+static void navswitch_setup (void)
+{
+    navswitch_init ();
+}
+
+
+static void navswitch_update_op (uint32_t i)
+{
+    (void) i;
+    navswitch_update ();
+}
+
+
+static void task_func (void *data)
+{
+    (void) data;
+
+    task_runs++;
+    if (task_runs >= task_runs_max)
+        longjmp (task_exit, 1);
+}
+
+
+static void task_setup (void)
+{
+    uint8_t i;
+
+    for (i = 0; i < ARRAY_SIZE (tasks); i++)
+    {
+        tasks[i].func = task_func;
+        tasks[i].data = 0;
+        tasks[i].period = 1 << i;
+        tasks[i].reschedule = 0;
+    }
+}
+
+
+/* One call runs the scheduler for all the iterations.  */
+static void task_schedule_op (uint32_t i)
+{
+    task_runs = 0;
+    task_runs_max = i;
+    if (!setjmp (task_exit))
+        task_schedule (tasks, ARRAY_SIZE (tasks));
+}
+
+
+static void mmelody_play_callback (void *data, uint8_t note, uint8_t volume)
+{
+    (void) data;
+    sink += note + volume;
+}
+
+
+static void mmelody_setup (void)
+{
+    mmelody = mmelody_init (&mmelody_obj, MMELODY_RATE,
+                            mmelody_play_callback, 0);
+    mmelody_speed_set (mmelody, 240);
+    mmelody_play (mmelody, "*8 C4E G C5/ <G4, A, B>2 C5. E4- :");
+}
+
+
+static void mmelody_update_op (uint32_t i)
+{
+    (void) i;
+    mmelody_update (mmelody);
+}
+
+
+static const hotpath_t hotpaths[] =
+{
+    {"tinygl_draw_line", tinygl_setup, draw_line_op, 100000, 0},
+    {"tinygl_draw_char", tinygl_setup, draw_char_op, 50000, 0},
+    {"display_update", display_setup, display_update_op, 200000, 0},
+    /* Fewer than the 255 repeats of the message.  */
+    {"tinygl_text_advance_step", text_step_setup, text_advance_op, 10000, 1},
+    {"tinygl_text_advance_scroll", text_scroll_setup, text_advance_op,
+     10000, 1},
+    {"font_pixel_get", 0, font_pixel_get_op, 1000000, 0},
+    {"ledmat_display_column", ledmat_setup, ledmat_display_column_op,
+     200000, 0},
+    {"navswitch_update", navswitch_setup, navswitch_update_op, 200000, 0},
+    {"task_schedule", task_setup, 0, 100000, 0},
+    {"mmelody_update", mmelody_setup, mmelody_update_op, 1000000, 0},
+};
+
+
+static void hotpath_run (const hotpath_t *hotpath, result_t *result)
+{
+    avrtest_accesses_t before;
+    avrtest_accesses_t after;
+    double start;
+    double ns;
+    uint32_t i;
+    int j;
+
+    result->ns = 0;
+    for (j = 0; j < REPEATS; j++)
+    {
+        if (hotpath->setup)
+            hotpath->setup ();
+
+        before = avrtest_accesses_get ();
+        start = now_get ();
+        if (hotpath->op)
+        {
+            for (i = 0; i < hotpath->iterations; i++)
+                hotpath->op (i);
+        }
+        else
+            task_schedule_op (hotpath->iterations);
+        ns = (now_get () - start) / hotpath->iterations;
+        after = avrtest_accesses_get ();
+
+        /* The fastest run has the least interference from the PC.  */
+        if (j == 0 || ns < result->ns)
+            result->ns = ns;
+
+        /* The accesses are the same for every run.  */
+        result->reads = (double)(after.reads - before.reads)
+            / hotpath->iterations;
+        result->writes = (double)(after.writes - before.writes)
+            / hotpath->iterations;
+    }
+}
+
+
+static const hotpath_t *hotpath_find (const char *name)
+{
+    unsigned int i;
+
+    for (i = 0; i < ARRAY_SIZE (hotpaths); i++)
+    {
+        if (!strcmp (hotpaths[i].name, name))
+            return &hotpaths[i];
+    }
+    return 0;
+}
+
+
+int main (int argc, char **argv)
+{
+    result_t display;
+    result_t result;
+    unsigned int i;
+    int j;
+
+    for (j = 1; j < argc; j++)
+    {
+        if (!hotpath_find (argv[j]))
+        {
+            fprintf (stderr, "%s: unknown benchmark %s\n", argv[0], argv[j]);
+            return 1;
+        }
+    }
+
+    /* Run headless on the virtual clock so nothing else runs.  */
+    setenv ("UCFK4_VIRTUAL", "1", 1);
+    system_init ();
+
+    /* This is subtracted from the text benchmarks.  */
+    hotpath_run (hotpath_find ("display_update"), &display);
+
+    for (i = 0; i < ARRAY_SIZE (hotpaths); i++)
+    {
+        const hotpath_t *hotpath = &hotpaths[i];
+        bool wanted = argc <= 1;
+
+        for (j = 1; j < argc; j++)
+        {
+            if (!strcmp (argv[j], hotpath->name))
+                wanted = 1;
+        }
+        if (!wanted)
+            continue;
+
+        hotpath_run (hotpath, &result);
+
+        if (hotpath->net_display)
+        {
+            result.ns -= display.ns;
+            if (result.ns < 0)
+                result.ns = 0;
+            result.reads -= display.reads;
+            result.writes -= display.writes;
+        }
+
+        printf ("bench=hotpath1 op=%s iterations=%u ns_per_op=%.1f"
+                " sfr_reads_per_op=%.2f sfr_writes_per_op=%.2f\n",
+                hotpath->name, (unsigned int)hotpath->iterations,
+                result.ns, result.reads, result.writes);
+        fflush (stdout);
+    }
+    return 0;
+}
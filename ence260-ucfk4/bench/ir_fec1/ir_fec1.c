@@ -0,0 +1,335 @@
+/** @file   ir_fec1.c
+    @author agent
+    @date   19 October 2026
+    @brief  Forward error correction benchmark for the simulated IR link.
+
+    @defgroup ir_fec1 Forward error correction benchmark.
+
+    This sends a block of pseudo-random bytes over the simulated IR
+    UART from one process to another, first as is and then with the
+    @ref ir_uart_fec "IR UART FEC" byte stream, and the receiver
+    compares what arrives with what was sent.
+
+    The bit flip probability is swept over the values given on the
+    command line (or a default set).  The number of bytes in each
+    block is BYTES_DEFAULT unless given with -n; enough are needed
+    for the byte error rate at the smaller probabilities to mean
+    anything.  At 2400 baud a block of 10000 bytes takes about 40 s
+    raw and 80 s with FEC; UCFK4_IR_BAUD can be set to run faster.
+    The other UCFK4_IR_* environment variables described in
+    drivers/test/ir_uart.c still apply.  Each measurement is printed
+    as a single line of name=value pairs.
+
+    The FEC byte stream discards codewords that it cannot correct and
+    characters can be lost on the link, so the received bytes are not
+    compared with the sent bytes by position.  Instead they are lined
+    up by finding the longest common subsequence of the two; the bytes
+    in it were received correctly and the other received bytes were
+    corrupted.  Since the data is pseudo-random, a corrupted byte is
+    unlikely to be lined up with a neighbour by chance.
+*/
+
+#include "system.h"
+#include "ir_uart.h"
+#include "ir_uart_fec.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+
+/* Number of bytes sent for each measurement unless given with -n.  */
+#define BYTES_DEFAULT 10000
+
+/* Stop waiting for characters after this long (s).  */
+#define TIMEOUT 0.2
+
+/* Give up if the first character does not arrive in this time (s).  */
+#define START_TIMEOUT 2.0
+
+
+typedef struct
+{
+    int received;
+    int good;
+    int errors;
+    int lost;
+    double elapsed;
+} result_t;
+
+
+static const double default_flips[] = {0, 0.001, 0.003, 0.01, 0.03};
+
+static int bytes = BYTES_DEFAULT;
+
+
+static double now_get (void)
+{
+    struct timespec time;
+
+    clock_gettime (CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+
+/* Return the length of the longest common subsequence of two byte
+   arrays.  */
+static int common_length (const uint8_t *a, int a_size,
+                          const uint8_t *b, int b_size)
+{
+    int *prev;
+    int *row;
+    int length;
+    int i;
+    int j;
+
+    prev = calloc (b_size + 1, sizeof (*prev));
+    row = calloc (b_size + 1, sizeof (*row));
+    if (!prev || !row)
+    {
+        perror ("calloc");
+        exit (1);
+    }
+
+    for (i = 0; i < a_size; i++)
+    {
+        row[0] = 0;
+        for (j = 0; j < b_size; j++)
+        {
+            if (a[i] == b[j])
+                row[j + 1] = prev[j] + 1;
+            else
+                row[j + 1] = row[j] > prev[j + 1] ? row[j] : prev[j + 1];
+        }
+        memcpy (prev, row, (b_size + 1) * sizeof (row[0]));
+    }
+    length = prev[b_size];
+    free (prev);
+    free (row);
+    return length;
+}
+
+
+/* Send the data with the given write function.  */
+static void block_send (const uint8_t *data,
+                        uint8_t (*write) (const void *data, uint8_t size),
+                        bool (*finished_p) (void))
+{
+    int sent = 0;
+
+    while (sent < bytes)
+    {
+        sent += write (&data[sent], bytes - sent > 255 ? 255 : bytes - sent);
+        usleep (50);
+    }
+    while (!finished_p ())
+        usleep (50);
+}
+
+
+/* Collect what arrives with the given read function, starting at
+   start, until the link goes quiet.  */
+static void block_receive (const uint8_t *data, double start,
+                           uint8_t (*read) (void *data, uint8_t size),
+                           result_t *result)
+{
+    uint8_t *received;
+    int received_max;
+    double last;
+    uint8_t ch;
+
+    /* Twice as many as were sent is plenty since the FEC only
+       discards and the link only loses characters.  */
+    received_max = 2 * bytes;
+    received = malloc (received_max);
+    if (!received)
+    {
+        perror ("malloc");
+        exit (1);
+    }
+
+    result->received = 0;
+
+    last = start;
+    while (now_get () - last < (result->received ? TIMEOUT : START_TIMEOUT))
+    {
+        while (read (&ch, 1))
+        {
+            if (result->received < received_max)
+                received[result->received++] = ch;
+            last = now_get ();
+        }
+        usleep (50);
+    }
+    result->elapsed = last - start;
+
+    result->good = common_length (data, bytes, received, result->received);
+    result->errors = result->received - result->good;
+    result->lost = bytes - result->good - result->errors;
+    if (result->lost < 0)
+        result->lost = 0;
+    free (received);
+}
+
+
+static void result_print (double flip, const char *mode,
+                          const result_t *result)
+{
+    printf ("bench=ir_fec1 flip=%g mode=%s bytes=%d received=%d errors=%d"
+            " lost=%d", flip, mode, bytes, result->received, result->errors,
+            result->lost);
+    if (mode[0] == 'f')
+    {
+        const ir_uart_fec_stats_t *stats = ir_uart_fec_stats_get ();
+
+        printf (" corrected=%u failed=%u unpaired=%u",
+                stats->corrected, stats->failed, stats->unpaired);
+    }
+    printf (" byte_error_rate=%.4f throughput_Bps=%.1f\n",
+            (double)(bytes - result->good) / bytes,
+            result->elapsed > 0 ? result->good / result->elapsed : 0);
+}
+
+
+/* Send a block from one process to another, which prints the
+   result.  The link parameters are only read when the IR UART is
+   initialised so each measurement uses new processes.  */
+static int measure (double flip, bool fec)
+{
+    uint8_t *data;
+    unsigned int seed = 1;
+    result_t result;
+    double start;
+    int fds[2];
+    pid_t pid;
+    char ch;
+    int i;
+
+    data = malloc (bytes);
+    if (!data)
+    {
+        perror ("malloc");
+        return 0;
+    }
+    for (i = 0; i < bytes; i++)
+        data[i] = rand_r (&seed);
+
+    if (pipe (fds) < 0)
+    {
+        perror ("pipe");
+        return 0;
+    }
+
+    fflush (stdout);
+    pid = fork ();
+    if (pid < 0)
+    {
+        perror ("fork");
+        return 0;
+    }
+    if (pid == 0)
+    {
+        /* The receiver binds its address before the sender starts.  */
+        if (fec)
+            ir_uart_fec_init ();
+        else
+            ir_uart_init ();
+        start = now_get ();
+        if (write (fds[1], "", 1) != 1)
+            _exit (1);
+
+        if (fec)
+            block_receive (data, start, ir_uart_fec_read, &result);
+        else
+            block_receive (data, start, ir_uart_read, &result);
+        result_print (flip, fec ? "fec" : "raw", &result);
+        fflush (stdout);
+        /* Skip the exit handlers so the statistics are only printed
+           by the sender.  */
+        _exit (0);
+    }
+
+    if (read (fds[0], &ch, 1) != 1)
+        return 0;
+    close (fds[0]);
+    close (fds[1]);
+
+    pid = fork ();
+    if (pid < 0)
+    {
+        perror ("fork");
+        return 0;
+    }
+    if (pid == 0)
+    {
+        if (fec)
+        {
+            ir_uart_fec_init ();
+            block_send (data, ir_uart_fec_write, ir_uart_fec_write_finished_p);
+        }
+        else
+        {
+            ir_uart_init ();
+            block_send (data, ir_uart_write, ir_uart_write_finished_p);
+        }
+        exit (0);
+    }
+
+    while (wait (0) > 0)
+        continue;
+    free (data);
+    return 1;
+}
+
+
+static void usage (const char *name)
+{
+    fprintf (stderr, "usage: %s [-n bytes] [flip ...]\n", name);
+    exit (1);
+}
+
+
+int main (int argc, char **argv)
+{
+    char link[32];
+    double flip;
+    int count;
+    int opt;
+    int i;
+
+    while ((opt = getopt (argc, argv, "n:")) != -1)
+    {
+        if (opt != 'n')
+            usage (argv[0]);
+        bytes = atoi (optarg);
+        if (bytes < 1)
+            usage (argv[0]);
+    }
+    argc -= optind - 1;
+    argv += optind - 1;
+
+    /* Use a private link so other programs do not interfere.  */
+    if (!getenv ("UCFK4_IR_LINK"))
+    {
+        snprintf (link, sizeof (link), "bench%d", (int)getpid ());
+        setenv ("UCFK4_IR_LINK", link, 1);
+    }
+
+    count = argc > 1 ? argc - 1
+        : (int)(sizeof (default_flips) / sizeof (default_flips[0]));
+
+    for (i = 0; i < count; i++)
+    {
+        char str[32];
+
+        flip = argc > 1 ? atof (argv[i + 1]) : default_flips[i];
+        snprintf (str, sizeof (str), "%g", flip);
+        setenv ("UCFK4_IR_FLIP", str, 1);
+
+        if (!measure (flip, 0) || !measure (flip, 1))
+            return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,168 @@
+/** @file   ir_link1.c
+    @author agent
+    @date   19 October 2026
+    @brief  Throughput and latency benchmark for the simulated IR link.
+
+    @defgroup ir_link1 Benchmark for the simulated IR link.
+
+    This runs two processes connected by the simulated IR UART; one
+    echoes back everything it receives.  The link is configured by the
+    UCFK4_IR_* environment variables described in drivers/test/ir_uart.c.
+    The results are printed as a single line of name=value pairs.
+*/
+
+#include "system.h"
+#include "ir_uart.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+
+/* Number of round trips for latency measurement.  */
+#define PINGS 50
+
+/* Number of characters for throughput measurement.  */
+#define BURST 240
+
+/* Give up waiting for a reply after this long (s).  */
+#define TIMEOUT 0.5
+
+/* Character sent for throughput measurement.  */
+#define PATTERN 0x55
+
+
+static double now_get (void)
+{
+    struct timespec time;
+
+    clock_gettime (CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+
+static void echo_run (void)
+{
+    while (1)
+    {
+        char ch;
+
+        if (ir_uart_read (&ch, 1))
+            ir_uart_putc (ch);
+        else
+            usleep (50);
+    }
+}
+
+
+/* Wait for a character until the deadline.  Return -1 on timeout.  */
+static int reply_wait (double deadline)
+{
+    uint8_t ch;
+
+    while (!ir_uart_read (&ch, 1))
+    {
+        if (now_get () > deadline)
+            return -1;
+        usleep (50);
+    }
+    return ch;
+}
+
+
+int main (void)
+{
+    char link[32];
+    pid_t pid;
+    double start;
+    double rtt;
+    double rtt_sum = 0;
+    double rtt_min = 1e9;
+    double rtt_max = 0;
+    int lost = 0;
+    int received = 0;
+    int corrupt = 0;
+    int sent;
+    int ch;
+    int i;
+
+    /* Use a private link so other programs do not interfere.  */
+    if (!getenv ("UCFK4_IR_LINK"))
+    {
+        snprintf (link, sizeof (link), "bench%d", (int)getpid ());
+        setenv ("UCFK4_IR_LINK", link, 1);
+    }
+
+    pid = fork ();
+    if (pid < 0)
+    {
+        perror ("fork");
+        return 1;
+    }
+
+    if (!ir_uart_init ())
+        return 1;
+
+    if (pid == 0)
+        echo_run ();
+
+    /* Let the echo process bind its address.  */
+    usleep (100000);
+
+    for (i = 0; i < PINGS; i++)
+    {
+        start = now_get ();
+        ir_uart_putc (i);
+        ch = reply_wait (start + TIMEOUT);
+        if (ch != i)
+        {
+            lost++;
+            /* Let any late reply drain.  */
+            while (reply_wait (now_get () + 0.05) >= 0)
+                continue;
+            continue;
+        }
+        rtt = now_get () - start;
+        rtt_sum += rtt;
+        if (rtt < rtt_min)
+            rtt_min = rtt;
+        if (rtt > rtt_max)
+            rtt_max = rtt;
+    }
+
+    start = now_get ();
+    for (sent = 0; sent < BURST; )
+    {
+        uint8_t data = PATTERN;
+
+        sent += ir_uart_write (&data, 1);
+        while ((ch = reply_wait (0)) >= 0)
+        {
+            received++;
+            if (ch != PATTERN)
+                corrupt++;
+        }
+    }
+    while ((ch = reply_wait (now_get () + TIMEOUT)) >= 0)
+    {
+        received++;
+        if (ch != PATTERN)
+            corrupt++;
+    }
+    /* Discount the final timeout.  */
+    rtt = now_get () - start - TIMEOUT;
+
+    kill (pid, SIGTERM);
+    waitpid (pid, 0, 0);
+
+    printf ("bench=ir_link1 pings=%d lost=%d rtt_min_ms=%.2f rtt_mean_ms=%.2f"
+            " rtt_max_ms=%.2f burst=%d received=%d corrupt=%d"
+            " throughput_Bps=%.1f\n",
+            PINGS, lost, PINGS > lost ? rtt_min * 1e3 : 0,
+            PINGS > lost ? rtt_sum / (PINGS - lost) * 1e3 : 0,
+            rtt_max * 1e3, BURST, received, corrupt,
+            received / rtt);
+    return 0;
+}
@@ -0,0 +1,242 @@
+/** @file   ir_mac1.c
+    @author agent
+    @date   19 October 2026
+    @brief  Multi-node benchmark for the IR MAC layer.
+
+    @defgroup ir_mac1 Multi-node benchmark for the IR MAC layer.
+
+    This runs a number of processes sharing the simulated IR UART,
+    each one a node using the @ref ir_mac "IR MAC" driver.  Every node
+    sends FRAMES unicast frames, each to a randomly chosen other node,
+    as fast as the MAC allows.  Collisions are modelled unless
+    UCFK4_IR_COLLIDE is set to 0.
+
+    The number of nodes is swept over the values given on the command
+    line (or a default set).  The other UCFK4_IR_* environment
+    variables described in drivers/test/ir_uart.c still apply.  Each
+    measurement is printed as a single line of name=value pairs.
+*/
+
+#include "system.h"
+#include "ir_mac.h"
+#include "ir_uart.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+
+
+/* Number of frames sent by each node.  */
+#define FRAMES 20
+
+/* Number of data bytes in each frame.  */
+#define SIZE 4
+
+/* Keep running this long after every node has finished sending so
+   that the last acknowledgements are sent (s).  */
+#define DRAIN 0.2
+
+/* Time for the nodes to start (s).  */
+#define START_DELAY 0.2
+
+
+typedef struct
+{
+    int sent;
+    int acked;
+    int failed;
+    int retries;
+    int received;
+    int duplicates;
+    int collisions;
+    int defers;
+    double elapsed;
+} result_t;
+
+
+static const int default_nodes[] = {2, 3, 4, 6};
+
+
+static double now_get (void)
+{
+    struct timespec time;
+
+    clock_gettime (CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+
+/* Number of nodes that have finished sending; this is shared by all
+   the nodes.  */
+static volatile int *done;
+
+
+static void node_run (int nodes, int node, double start, result_t *result)
+{
+    const ir_mac_stats_t *stats;
+    unsigned int seed = node + 1;
+    uint8_t data[IR_MAC_PAYLOAD_MAX];
+    uint8_t dest;
+    uint8_t src;
+    double last = 0;
+    bool finished = 0;
+
+    ir_mac_init (node);
+
+    while (now_get () < start)
+        usleep (100);
+
+    result->sent = 0;
+    result->received = 0;
+
+    /* A node has to keep running to acknowledge the others until they
+       have all finished.  */
+    while (*done < nodes || now_get () - last < DRAIN)
+    {
+        ir_mac_update ();
+
+        if (result->sent < FRAMES && ir_mac_send_ready_p ())
+        {
+            dest = rand_r (&seed) % (nodes - 1);
+            if (dest >= node)
+                dest++;
+            data[0] = node;
+            data[1] = result->sent;
+            ir_mac_send (dest, data, SIZE);
+            result->sent++;
+        }
+
+        while (ir_mac_recv (&src, data, sizeof (data)))
+            result->received++;
+
+        if (!finished && result->sent == FRAMES && ir_mac_send_ready_p ())
+        {
+            finished = 1;
+            result->elapsed = now_get () - start;
+            __sync_fetch_and_add (done, 1);
+        }
+        if (*done < nodes)
+            last = now_get ();
+
+        usleep (200);
+    }
+
+    stats = ir_mac_stats_get ();
+    result->acked = stats->tx_acked;
+    result->failed = stats->failures;
+    result->retries = stats->retries;
+    result->duplicates = stats->duplicates;
+    result->defers = stats->defers;
+    result->collisions = ir_uart_stats_get ()->framing_errors;
+}
+
+
+static int measure (int nodes)
+{
+    int fds[2];
+    pid_t pid;
+    double start;
+    double elapsed = 0;
+    result_t total = {0};
+    result_t result;
+    int node;
+
+    if (nodes < 2 || nodes > IR_MAC_NODES)
+    {
+        fprintf (stderr, "ir_mac1: nodes must be from 2 to %d\n",
+                 IR_MAC_NODES);
+        return 0;
+    }
+
+    if (pipe (fds) < 0)
+    {
+        perror ("pipe");
+        return 0;
+    }
+
+    *done = 0;
+    start = now_get () + START_DELAY;
+    fflush (stdout);
+    for (node = 0; node < nodes; node++)
+    {
+        pid = fork ();
+        if (pid < 0)
+        {
+            perror ("fork");
+            return 0;
+        }
+        if (pid == 0)
+        {
+            close (fds[0]);
+            node_run (nodes, node, start, &result);
+            if (write (fds[1], &result, sizeof (result)) != sizeof (result))
+                _exit (1);
+            /* Skip the exit handlers so the statistics are not
+               printed for every node.  */
+            _exit (0);
+        }
+    }
+    close (fds[1]);
+
+    while (read (fds[0], &result, sizeof (result)) == sizeof (result))
+    {
+        total.sent += result.sent;
+        total.acked += result.acked;
+        total.failed += result.failed;
+        total.retries += result.retries;
+        total.received += result.received;
+        total.duplicates += result.duplicates;
+        total.collisions += result.collisions;
+        total.defers += result.defers;
+        if (result.elapsed > elapsed)
+            elapsed = result.elapsed;
+    }
+    close (fds[0]);
+
+    while (wait (0) > 0)
+        continue;
+
+    printf ("bench=ir_mac1 nodes=%d sent=%d acked=%d failed=%d retries=%d"
+            " received=%d duplicates=%d collisions=%d defers=%d"
+            " delivery_ratio=%.3f throughput_fps=%.1f\n",
+            nodes, total.sent, total.acked, total.failed, total.retries,
+            total.received, total.duplicates, total.collisions,
+            total.defers, total.sent ? (double)total.received / total.sent : 0,
+            elapsed > 0 ? total.received / elapsed : 0);
+    return 1;
+}
+
+
+int main (int argc, char **argv)
+{
+    char link[32];
+    int count;
+    int i;
+
+    count = argc > 1 ? argc - 1
+        : (int)(sizeof (default_nodes) / sizeof (default_nodes[0]));
+
+    setenv ("UCFK4_IR_COLLIDE", "1", 0);
+
+    done = mmap (0, sizeof (*done), PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (done == MAP_FAILED)
+    {
+        perror ("mmap");
+        return 1;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        /* Use a new private link for each measurement so that other
+           programs and earlier nodes do not interfere.  */
+        snprintf (link, sizeof (link), "bench%d-%d", (int)getpid (), i);
+        setenv ("UCFK4_IR_LINK", link, 1);
+
+        if (!measure (argc > 1 ? atoi (argv[i + 1]) : default_nodes[i]))
+            return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,152 @@
+/** @file   ir_rc5_rx1.c
+    @author agent
+    @date   19 October 2026
+    @brief  Decoding benchmark for the RC5 receiver driver.
+
+    @defgroup ir_rc5_rx1 RC5 receiver decoding benchmark.
+
+    This feeds RC5 frames of pseudo-random codes to the @ref ir_rc5_rx
+    "RC5 receiver" through ir_capture_edge, as the edge capture
+    interrupt handler would, and checks the codes that ir_rc5_rx_read
+    returns.  Each edge is moved earlier or later by a random amount
+    up to the jitter, which is swept over the values (us) given on the
+    command line (or a default set).  Every other frame is preceded by
+    a short glitch that the decoder should ignore.  One line of
+    name=value pairs is printed for each jitter, for example,
+
+    bench=ir_rc5_rx1 jitter_us=200 frames=600 decoded=600 wrong=0 errors=0 missed=0
+
+    The decoder takes a gap between edges of 0.5 to 1.5 half bit
+    periods as short and up to 2.5 as long, so a gap can be off by
+    444 us and each edge by about half that.
+*/
+
+#include "system.h"
+#include "timer.h"
+#include "ir_capture.h"
+#include "ir_rc5_rx.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+
+/* Number of frames for each jitter.  */
+#define FRAMES 600
+
+#define BITS 14
+
+#define HALF_BIT_US (1778 / 2.0)
+
+/* RC5 frames are repeated every 113.8 ms.  */
+#define FRAME_PERIOD_US 113778.0
+
+/* Width of the glitch and how long it is before the frame.  */
+#define GLITCH_US 100.0
+#define GLITCH_LEAD_US 5000.0
+
+
+typedef struct
+{
+    int decoded;
+    int wrong;
+    int errors;
+} result_t;
+
+
+static const double default_jitters[] = {0, 100, 200, 300, 400};
+
+static unsigned int seed = 1;
+
+
+/* Inject an edge at a time (us) moved by up to the jitter.  */
+static void edge (uint8_t state, double when, double jitter)
+{
+    when += jitter * (2.0 * rand_r (&seed) / RAND_MAX - 1);
+
+    ir_capture_edge (state, (timer_tick_t)(uint32_t)(when * 1e-6 * TIMER_RATE));
+}
+
+
+/* Inject the edges of a frame that starts at a time (us).  */
+static void frame_send (uint16_t code, double start, double jitter)
+{
+    uint8_t level = 0;
+    uint8_t half;
+    int bit;
+    int i;
+
+    /* Each bit is Manchester encoded; a 1 is a space then a mark and a
+       0 is a mark then a space.  */
+    for (i = 0; i < BITS * 2; i++)
+    {
+        bit = (code >> (BITS - 1 - i / 2)) & 1;
+        half = (i & 1) ? bit : !bit;
+        if (half != level)
+        {
+            level = half;
+            edge (level, start + i * HALF_BIT_US, jitter);
+        }
+    }
+    if (level)
+        edge (0, start + BITS * 2 * HALF_BIT_US, jitter);
+}
+
+
+static void measure (double jitter, result_t *result)
+{
+    double start;
+    uint16_t code;
+    int16_t ret;
+    bool found;
+    int i;
+
+    result->decoded = result->wrong = result->errors = 0;
+
+    for (i = 0; i < FRAMES; i++)
+    {
+        start = (i + 1) * FRAME_PERIOD_US;
+        code = BIT (BITS - 1) | (rand_r (&seed) & (BIT (BITS - 1) - 1));
+
+        if (i & 1)
+        {
+            edge (1, start - GLITCH_LEAD_US, 0);
+            edge (0, start - GLITCH_LEAD_US + GLITCH_US, 0);
+        }
+        frame_send (code, start, jitter);
+
+        found = 0;
+        while ((ret = ir_rc5_rx_read ()) != IR_RC5_RX_NONE)
+        {
+            if (ret == IR_RC5_RX_ERROR)
+                result->errors++;
+            else if (ret == code && !found)
+                found = 1;
+            else
+                result->wrong++;
+        }
+        result->decoded += found;
+    }
+}
+
+
+int main (int argc, char **argv)
+{
+    result_t result;
+    double jitter;
+    int count;
+    int i;
+
+    ir_rc5_rx_init ();
+
+    count = argc > 1 ? argc - 1 : (int)ARRAY_SIZE (default_jitters);
+
+    for (i = 0; i < count; i++)
+    {
+        jitter = argc > 1 ? atof (argv[i + 1]) : default_jitters[i];
+
+        measure (jitter, &result);
+        printf ("bench=ir_rc5_rx1 jitter_us=%g frames=%d decoded=%d wrong=%d"
+                " errors=%d missed=%d\n", jitter, FRAMES, result.decoded,
+                result.wrong, result.errors, FRAMES - result.decoded);
+    }
+    return 0;
+}
@@ -0,0 +1,56 @@
+/** @file   ir_capture.c
+    @author agent
+    @date   19 October 2026
+    @brief  IR receiver edge capture.
+*/
+#include "system.h"
+#include "ir_capture.h"
+#include "pio.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+
+static ir_capture_handler_t ir_capture_handler;
+
+
+/* External interrupt 2 handler; this is called for both edges.  */
+ISR (INT2_vect)
+{
+    timer_tick_t now;
+
+    /* Interrupts are disabled here so TCNT1 can be read directly.  */
+    now = TCNT1;
+
+    /* The output of the IR receiver is inverted; it goes low when it
+       detects modulated IR light.  */
+    ir_capture_handler (!pio_input_get (IR_RX_PIO), now);
+}
+
+
+void
+ir_capture_enable (bool enable)
+{
+    if (enable)
+    {
+        /* Discard any edge that occurred while disabled.  */
+        EIFR = BIT (INTF2);
+        EIMSK |= BIT (INT2);
+    }
+    else
+        EIMSK &= ~BIT (INT2);
+}
+
+
+void
+ir_capture_init (ir_capture_handler_t handler)
+{
+    ir_capture_handler = handler;
+
+    pio_config_set (IR_RX_PIO, PIO_INPUT);
+    timer_init ();
+
+    /* Interrupt on any logical change of INT2.  */
+    EICRA = (EICRA & ~(BIT (ISC21) | BIT (ISC20))) | BIT (ISC20);
+    ir_capture_enable (1);
+    sei ();
+}
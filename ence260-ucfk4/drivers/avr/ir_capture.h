@@ -0,0 +1,40 @@
+/** @file   ir_capture.h
+    @author agent
+    @date   19 October 2026
+    @brief  IR receiver edge capture.
+
+    @defgroup ir_capture IR receiver edge capture
+
+    This module timestamps each transition of the IR receiver output
+    using the INT2 external interrupt (IR_RX_PIO is PD2) and the timer
+    module.  A handler is called from the interrupt service routine
+    with the new receiver state (1 = IR modulation detected) and the
+    time of the edge.  Since it is called from an interrupt the
+    handler must be short.
+
+    Note, INT2 shares its pin with the USART1 receiver so this cannot
+    be used at the same time as the IR UART.
+*/
+
+#ifndef IR_CAPTURE_H
+#define IR_CAPTURE_H
+
+#include "system.h"
+#include "timer.h"
+
+
+/** Handler called for each edge.  */
+typedef void (*ir_capture_handler_t) (uint8_t state, timer_tick_t when);
+
+
+/** Enable or disable the edge capture interrupt.  This is useful to
+    ignore our own transmissions.
+    @param enable non-zero to enable.  */
+void ir_capture_enable (bool enable);
+
+
+/** Initialise IR receiver edge capture.  This initialises the timer.
+    @param handler function to call for each edge.  */
+void ir_capture_init (ir_capture_handler_t handler);
+
+#endif
@@ -0,0 +1,36 @@
+/** @file   ir_carrier.c
+    @author agent
+    @date   19 October 2026
+    @brief  IR transmitter carrier gating.
+*/
+#include "system.h"
+#include "ir_carrier.h"
+#include "ir.h"
+#include "timer0.h"
+#include "pio.h"
+
+
+void
+ir_carrier_set (bool state)
+{
+    /* When the timer output is disconnected the pin is driven low by
+       the port.  */
+    timer0_output_set (TIMER0_OUTPUT_B, state ? TIMER0_OUTPUT_MODE_TOGGLE
+                       : TIMER0_OUTPUT_MODE_DISABLE);
+}
+
+
+void
+ir_carrier_init (void)
+{
+    /* The IR LED is on when IR_TX_HIGH_PIO is high and IR_TX_LOW_PIO
+       is low.  */
+    pio_config_set (IR_TX_HIGH_PIO, PIO_OUTPUT_LOW);
+    pio_config_set (IR_TX_LOW_PIO, PIO_OUTPUT_LOW);
+
+    timer0_init ();
+    timer0_period_set (F_CPU / (IR_MODULATION_FREQ * 2));
+    timer0_mode_set (TIMER0_MODE_CTC);
+    ir_carrier_set (0);
+    timer0_start ();
+}
@@ -0,0 +1,28 @@
+/** @file   ir_carrier.h
+    @author agent
+    @date   19 October 2026
+    @brief  IR transmitter carrier gating.
+
+    @defgroup ir_carrier IR transmitter carrier gating
+
+    This module modulates the IR LED at IR_MODULATION_FREQ using timer
+    0 to toggle the OC0B output (IR_TX_HIGH_PIO).  The carrier is
+    gated on and off by connecting or disconnecting the timer output
+    so it costs no CPU time while a symbol is being sent.
+*/
+
+#ifndef IR_CARRIER_H
+#define IR_CARRIER_H
+
+#include "system.h"
+
+
+/** Turn the carrier on or off.
+    @param state 1 to modulate the IR LED, 0 to turn it off.  */
+void ir_carrier_set (bool state);
+
+
+/** Initialise timer 0 to generate the carrier.  The carrier is off.  */
+void ir_carrier_init (void);
+
+#endif
@@ -6,15 +6,92 @@
 #include "ir_uart.h"
 #include "usart1.h"
 #include "timer0.h"
+#include "timer.h"
 #include "pio.h"
-#include "delay.h"
+#if IR_UART_BAUD_ADAPT
+#include <avr/boot.h>
+#endif
+
+
+/* The IR receiver has a delay of about 150 microseconds so an echo of
+   our own transmission can be received just after the transmitter
+   finishes.  */
+#define IR_UART_ECHO_GUARD_TICKS ((timer_tick_t)(TIMER_RATE * 500e-6 + 1))
+
+
+#if IR_UART_BAUD_ADAPT
+/* These are for the rate negotiation, which sits between the
+   application and usart1.  */
+
+uint8_t
+ir_uart_raw_read (void *data, uint8_t size)
+{
+    return usart1_read (data, size);
+}
+
+
+timer_tick_t
+ir_uart_raw_rx_time_get (void)
+{
+    return usart1_rx_time_get ();
+}
+
+
+uint8_t
+ir_uart_raw_write (const void *data, uint8_t size)
+{
+    return usart1_write (data, size);
+}
+
+
+bool
+ir_uart_raw_write_finished_p (void)
+{
+    return usart1_write_finished_p ();
+}
+
+
+void
+ir_uart_raw_rate_set (uint16_t baud)
+{
+    usart1_baud_divisor_set (USART1_BAUD_DIVISOR ((uint32_t)baud));
+}
+
+
+uint16_t
+ir_uart_raw_errors_get (void)
+{
+    const usart1_stats_t *stats = usart1_stats_get ();
+
+    return stats->framing_errors + stats->overrun_errors;
+}
+
+
+uint16_t
+ir_uart_raw_seed_get (void)
+{
+    uint16_t seed = 0;
+    uint8_t addr;
+
+    /* The USB AVRs have a serial number in the signature row.  If this
+       part does not, the boards are told apart by the times that
+       characters arrive, which depend on their clocks.  */
+    for (addr = 0x0e; addr < 0x18; addr++)
+        seed = seed * 31 + boot_signature_byte_get (addr);
+    return seed;
+}
+#endif
 
 
 /* Return non-zero if there is a character ready to be read.  */
 bool
 ir_uart_read_ready_p (void)
 {
+#if IR_UART_BAUD_ADAPT
+    return ir_uart_baud_read_ready_p ();
+#else
     return usart1_read_ready_p ();
+#endif
 }
 
 
@@ -23,7 +100,39 @@ ir_uart_read_ready_p (void)
 int8_t
 ir_uart_getc (void)
 {
+#if IR_UART_BAUD_ADAPT
+    uint8_t ch;
+
+    while (!ir_uart_baud_read (&ch, 1))
+        continue;
+    return ch;
+#else
     return usart1_getc ();
+#endif
+}
+
+
+/* Read up to size bytes from IR_UART without blocking.  */
+uint8_t
+ir_uart_read (void *data, uint8_t size)
+{
+#if IR_UART_BAUD_ADAPT
+    return ir_uart_baud_read (data, size);
+#else
+    return usart1_read (data, size);
+#endif
+}
+
+
+/* Return the time that the last character read was received.  */
+timer_tick_t
+ir_uart_rx_time_get (void)
+{
+#if IR_UART_BAUD_ADAPT
+    return ir_uart_baud_rx_time_get ();
+#else
+    return usart1_rx_time_get ();
+#endif
 }
 
 
@@ -31,6 +140,10 @@ ir_uart_getc (void)
 bool
 ir_uart_write_ready_p (void)
 {
+#if IR_UART_BAUD_ADAPT
+    if (!ir_uart_baud_write_ready_p ())
+        return 0;
+#endif
     return usart1_write_ready_p ();
 }
 
@@ -39,56 +152,60 @@ ir_uart_write_ready_p (void)
 bool
 ir_uart_write_finished_p (void)
 {
+#if IR_UART_BAUD_ADAPT
+    ir_uart_baud_update ();
+#endif
     return usart1_write_finished_p ();
 }
 
 
+/* Write up to size bytes to IR_UART without blocking.  */
+uint8_t
+ir_uart_write (const void *data, uint8_t size)
+{
+#if IR_UART_BAUD_ADAPT
+    if (!ir_uart_baud_write_ready_p ())
+        return 0;
+#endif
+    return usart1_write (data, size);
+}
+
+
 /** Write character to IR_UART.  This blocks until the character can
-    be written into the transmit buffer.  It does not check to see
-    if there is any echoed character (see ir_uart_putc).  */
+    be written into the transmit buffer.  Echoed characters are
+    discarded by the receive interrupt handler.  */
 void
 ir_uart_putc_nocheck (char ch)
 {
-    usart1_putc (ch);
+    ir_uart_putc (ch);
 }
 
 
-/** Write character to IR_UART.  This blocks until the character is
-    written.  It then checks if data has been received and if so, reads
-    the data and throws it away on the assumption that it is electrical
-    or optical echoing.  */
+/** Write character to IR_UART.  This only blocks if the transmit
+    buffer is full.
+
+    At 2400 baud with one start bit, 8 data bits, and no parity, each
+    character takes 3.75 ms to transmit.  Note, the maximum bit rate
+    for the IR receiver is 4000 bps.
+
+    Any character received while transmitting, or just after, is
+    thrown away by the receive interrupt handler on the assumption
+    that it is electrical or optical echoing.  The echoing is due to
+    an electrical common-path interference problem caused by a poor
+    PCB layout of the track powering the IR receiver.  Unfortunately,
+    it does not always occur with some combination of UCFK4 boards
+    and laptops.  Perhaps some laptops are more miserly with their
+    current allocation and some IR LEDs do not draw as much current?
+    It is also possible to get an optical reflection of the
+    transmitted signal.  */
 void
 ir_uart_putc (char ch)
 {
-    /* At 2400 baud with one start bit, 8 data bits, and no parity,
-       this will take 3.75 ms to transmit.  Note, the maximum bit rate
-       for the IR receiver is 4000 bps. */
-    usart1_putc (ch);
-
-    /* Gobble echoed character.  The echoing is due to an electrical
-       common-path interference problem caused by a poor PCB layout of the
-       track powering the IR receiver.  Unfortunately, it does not always
-       occur with some combination of UCFK4 boards and laptops.  Perhaps
-       some laptops are more miserly with their current allocation and
-       some IR LEDs do not draw as much current?  So as a workaround
-       we need to wait until the transmission has finished and then check
-       if something was immediately received. 
-
-       Having said all this, it is possible to get an optical reflection
-       of the transmitted signal.  The following code should handle this 
-       as well.  */
-
-    while (! ir_uart_write_finished_p ())
+#if IR_UART_BAUD_ADAPT
+    while (!ir_uart_baud_write_ready_p ())
         continue;
-
-    /* The IR receiver has a delay of about 150 microseconds.  So need
-       to wait for UART to have received the data and set its receive
-       complete bit.  */
-    DELAY_US (150);
-    
-    /* Check is something was inadvertently read.  */
-    if (ir_uart_read_ready_p ())
-        ir_uart_getc ();
+#endif
+    usart1_putc (ch);
 }
 
 
@@ -96,7 +213,16 @@ ir_uart_putc (char ch)
 void
 ir_uart_puts (const char *str)
 {
-    usart1_puts (str);
+    while (*str)
+        ir_uart_putc (*str++);
+}
+
+
+/** Return pointer to the link statistics.  */
+const ir_uart_stats_t *
+ir_uart_stats_get (void)
+{
+    return usart1_stats_get ();
 }
 
 
@@ -107,7 +233,8 @@ ir_uart_init (void)
     usart1_cfg_t usart1_cfg = 
         {
             .baud_divisor = USART1_BAUD_DIVISOR (IR_UART_BAUD_RATE),
-            .bits = 8
+            .bits = 8,
+            .echo_guard = IR_UART_ECHO_GUARD_TICKS
         };
 
 
@@ -122,5 +249,14 @@ ir_uart_init (void)
 
     timer0_start ();
 
-    return usart1_init (&usart1_cfg);
+    /* The timer is needed to time the echo guard period.  */
+    timer_init ();
+
+    if (!usart1_init (&usart1_cfg))
+        return 0;
+
+#if IR_UART_BAUD_ADAPT
+    ir_uart_baud_init ();
+#endif
+    return 1;
 }
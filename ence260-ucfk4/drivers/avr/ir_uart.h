@@ -4,6 +4,11 @@
 
     @defgroup IR_uart Infrared uart driver
 
+    Transmission and reception are interrupt driven using ring buffers
+    so ir_uart_write and ir_uart_read never block.  ir_uart_putc only
+    blocks if the transmit buffer is full and ir_uart_getc blocks
+    until a character has been received.
+
     Here's a simple application that transmits the ASCII code '?' repeatedly.
 
        @code
@@ -50,11 +55,15 @@
 #define IR_UART_H
 
 #include "system.h"
+#include "usart1.h"
 
 #ifndef IR_UART_BAUD_RATE
 #define IR_UART_BAUD_RATE 2400
 #endif
 
+/* This is the starting rate if IR_UART_BAUD_ADAPT is enabled.  */
+#include "ir_uart_baud.h"
+
 
 /* Return non-zero if there is a character ready to be read.  */
 bool
@@ -67,6 +76,21 @@ int8_t
 ir_uart_getc (void);
 
 
+/** Read up to size bytes from IR_UART without blocking.
+    @param data pointer to buffer to store data
+    @param size maximum number of bytes to read
+    @return number of bytes read.  */
+uint8_t
+ir_uart_read (void *data, uint8_t size);
+
+
+/** Return the time that the last character read was received.  This
+    is taken by the receive interrupt handler so it is not delayed by
+    the time the character waited to be read.  */
+timer_tick_t
+ir_uart_rx_time_get (void);
+
+
 /* Return non-zero if a character can be written without blocking.  */
 bool
 ir_uart_write_ready_p (void);
@@ -77,16 +101,25 @@ bool
 ir_uart_write_finished_p (void);
 
 
+/** Write up to size bytes to IR_UART without blocking.
+    @param data pointer to data to write
+    @param size maximum number of bytes to write
+    @return number of bytes queued for transmission.  */
+uint8_t
+ir_uart_write (const void *data, uint8_t size);
+
+
 /** Write character to IR_UART.  This blocks until the character can
-    be written into the transmit buffer.  It does not check to see
-    if there is any echoed character (see ir_uart_putc).  */
+    be written into the transmit buffer.  This is now the same as
+    ir_uart_putc since echoes are discarded by the receive interrupt
+    handler.  */
 void
 ir_uart_putc_nocheck (char ch);
 
 
-/* Write character to IR_UART.  This blocks until the character is
-   written.  It then checks if data has been received and if so, reads
-   the data and throws it away on the assumption that it is electrical
+/* Write character to IR_UART.  This only blocks if the transmit
+   buffer is full.  Characters received while transmitting, or just
+   after, are thrown away on the assumption that they are electrical
    or optical echoing.  */
 void
 ir_uart_putc (char ch);
@@ -97,6 +130,17 @@ void
 ir_uart_puts (const char *str);
 
 
+/** Link statistics; see usart1_stats_t.  */
+typedef usart1_stats_t ir_uart_stats_t;
+
+
+/** Return pointer to the link statistics.  These count the characters
+    sent and received and those discarded as echoes, with framing or
+    overrun errors, or since the receive buffer was full.  */
+const ir_uart_stats_t *
+ir_uart_stats_get (void);
+
+
 /* Initialise ir_uart and set baud rate.  */
 uint8_t
 ir_uart_init (void);
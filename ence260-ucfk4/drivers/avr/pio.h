@@ -350,6 +350,63 @@ void pio_output_set (pio_t pio, bool state)
 {
     state ? pio_output_high (pio) : pio_output_low (pio);
 }
+
+
+/** A group of PIOs on the same port is defined by ORing their PIO
+    definitions, say PC4_PIO | PC6_PIO.  pio_config_set and
+    pio_output_set act on all the pins of a group at once since they
+    are in the same register.  Groups are not supported if DEBUG is
+    defined.  */
+
+/** Return non-zero if two PIOs (or groups) are on the same port.  */
+#define PIO_SAME_PORT_P(PIO1, PIO2) ((((PIO1) ^ (PIO2)) & 0xff) == 0)
+
+
+/** Return the bitmask of a PIO (or group) in its port.
+    @param pio
+    @return bitmask  */
+static inline
+uint8_t pio_bitmask_get (pio_t pio)
+{
+    return PIO_BITMASK_ (pio);
+}
+
+
+/** Read input states from a group of PIOs.
+    @param group
+    @return bitmask of the pins in the group that are high  */
+static inline
+uint8_t pio_group_input_get (pio_t group)
+{
+    return PIO_PIN_ (group) & PIO_BITMASK_ (group);
+}
+
+
+/** Return the configuration of a group of PIOs for
+    pio_group_config_restore.
+    @param group
+    @return configuration  */
+static inline
+uint16_t pio_group_config_save (pio_t group)
+{
+    return ((PIO_DDR_ (group) & PIO_BITMASK_ (group)) << 8)
+        | (PIO_DATA_ (group) & PIO_BITMASK_ (group));
+}
+
+
+/** Restore the configuration of a group of PIOs.  The PORT register
+    is changed before the DDR register so that a pin going from input
+    to output is never driven to the wrong state.
+    @param group
+    @param config configuration from pio_group_config_save  */
+static inline
+void pio_group_config_restore (pio_t group, uint16_t config)
+{
+    uint8_t mask = PIO_BITMASK_ (group);
+
+    PIO_DATA_ (group) = (PIO_DATA_ (group) & ~mask) | (config & mask);
+    PIO_DDR_ (group) = (PIO_DDR_ (group) & ~mask) | ((config >> 8) & mask);
+}
 #endif
 
 #endif
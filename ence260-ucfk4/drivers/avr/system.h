@@ -73,4 +73,11 @@
 /** Initialise clock and disable watchdog timer.  */
 void system_init (void);
 
+
+/** Register an array of 16 bit counters for reporting.  The test
+    scaffold prints them on exit; there is nowhere to print them on
+    the AVR so this does nothing.  */
+#define system_stats_register(NAME, FIELDS, COUNTERS, NUM) \
+    ((void)(NAME), (void)(FIELDS), (void)(COUNTERS), (void)(NUM))
+
 #endif
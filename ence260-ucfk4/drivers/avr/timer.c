@@ -4,6 +4,8 @@
     @brief  Timer module
 */
 #include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
 #include "timer.h"
 #include "system.h"
 
@@ -27,6 +29,39 @@
 #endif
 
 
+static timer_alarm_handler_t timer_alarm_handler;
+
+
+/* Timer 1 compare match B interrupt handler.  */
+ISR (TIMER1_COMPB_vect)
+{
+    /* The alarm only fires once.  */
+    TIMSK1 &= ~BIT (OCIE1B);
+
+    timer_alarm_handler (OCR1B);
+}
+
+
+/** Set an alarm using output compare register B.  */
+void timer_alarm_set (timer_tick_t when, timer_alarm_handler_t handler)
+{
+    ATOMIC_BLOCK (ATOMIC_RESTORESTATE)
+    {
+        timer_alarm_handler = handler;
+        OCR1B = when;
+        TIFR1 = BIT (OCF1B);
+        TIMSK1 |= BIT (OCIE1B);
+    }
+}
+
+
+/** Cancel alarm.  */
+void timer_alarm_cancel (void)
+{
+    TIMSK1 &= ~BIT (OCIE1B);
+}
+
+
 /** Initialise timer.  */
 void timer_init (void)
 {
@@ -41,7 +76,16 @@ void timer_init (void)
     @return current time in ticks.  */
 timer_tick_t timer_get (void)
 {
-    return TCNT1;
+    timer_tick_t now;
+
+    /* Reading the 16-bit counter uses a shared temporary register for
+       the high byte so guard against interrupt handlers that also
+       read the timer.  */
+    ATOMIC_BLOCK (ATOMIC_RESTORESTATE)
+    {
+        now = TCNT1;
+    }
+    return now;
 }
 
 
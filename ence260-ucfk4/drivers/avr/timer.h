@@ -91,6 +91,23 @@ timer_tick_t timer_wait_until (timer_tick_t when);
 timer_tick_t timer_wait (timer_tick_t period);
 
 
+/** Alarm handler; this is called with the time the alarm was set for.  */
+typedef void (*timer_alarm_handler_t) (timer_tick_t when);
+
+
+/** Set an alarm.  The handler is called once, from an interrupt
+    handler, when the timer reaches the specified time.  Global
+    interrupts must be enabled.  The handler can set the next alarm.
+    Only a single alarm is supported.
+    @param when time to call handler
+    @param handler function to call.  */
+void timer_alarm_set (timer_tick_t when, timer_alarm_handler_t handler);
+
+
+/** Cancel alarm.  */
+void timer_alarm_cancel (void);
+
+
 /** Initialise timer.  */
 void timer_init (void);
 
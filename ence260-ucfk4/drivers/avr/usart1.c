@@ -6,7 +6,54 @@
 */
 #include "system.h"
 #include "usart1.h"
+#include "timer.h"
 #include <avr/io.h>
+#include <avr/interrupt.h>
+
+
+/* The buffer sizes must be powers of 2 so that the indices can be
+   wrapped with a mask.  */
+#if (USART1_RX_BUFFER_SIZE & (USART1_RX_BUFFER_SIZE - 1)) != 0
+#error USART1_RX_BUFFER_SIZE must be a power of 2
+#endif
+
+#if (USART1_TX_BUFFER_SIZE & (USART1_TX_BUFFER_SIZE - 1)) != 0
+#error USART1_TX_BUFFER_SIZE must be a power of 2
+#endif
+
+#define USART1_RX_MASK (USART1_RX_BUFFER_SIZE - 1)
+#define USART1_TX_MASK (USART1_TX_BUFFER_SIZE - 1)
+
+
+/* The indices are free-running and only masked when the buffer is
+   accessed.  The head index is only written by the producer and the
+   tail index is only written by the consumer so no locking is
+   required with 8-bit indices.  */
+static volatile uint8_t usart1_rx_buffer[USART1_RX_BUFFER_SIZE];
+static volatile uint8_t usart1_rx_head;
+static volatile uint8_t usart1_rx_tail;
+
+/* Time that each character in the receive buffer arrived.  */
+static volatile timer_tick_t usart1_rx_times[USART1_RX_BUFFER_SIZE];
+
+/* Time that the last character read arrived.  */
+static timer_tick_t usart1_rx_time;
+
+static volatile uint8_t usart1_tx_buffer[USART1_TX_BUFFER_SIZE];
+static volatile uint8_t usart1_tx_head;
+static volatile uint8_t usart1_tx_tail;
+
+/* Non-zero from when a character is queued until the transmit shift
+   register has emptied.  */
+static volatile bool usart1_tx_active;
+
+/* Time that the last transmission finished.  */
+static volatile timer_tick_t usart1_tx_done;
+
+static timer_tick_t usart1_echo_guard;
+
+static usart1_stats_t usart1_stats;
+
 
 void
 usart1_baud_divisor_set (uint16_t divisor)
@@ -16,33 +63,139 @@ usart1_baud_divisor_set (uint16_t divisor)
 }
 
 
+/** Return non-zero if a received character should be treated as an
+    echo of our own transmission.  This is the case if the transmitter
+    is busy or has only just finished.  */
+static inline bool
+usart1_echo_p (void)
+{
+    if (!usart1_echo_guard)
+        return 0;
+
+    if (usart1_tx_active)
+        return 1;
+
+    return (timer_tick_t)(timer_get () - usart1_tx_done) < usart1_echo_guard;
+}
+
+
+/* Receive complete interrupt handler.  */
+ISR (USART1_RX_vect)
+{
+    uint8_t status;
+    uint8_t ch;
+
+    /* The status must be read before the data register.  */
+    status = UCSR1A;
+    ch = UDR1;
+
+    /* Discard characters with framing or overrun errors.  An overrun
+       means that characters have been lost before this one.  */
+    if (status & (BIT (FE1) | BIT (DOR1)))
+    {
+        if (status & BIT (FE1))
+            usart1_stats.framing_errors++;
+        if (status & BIT (DOR1))
+            usart1_stats.overrun_errors++;
+        return;
+    }
+
+    if (usart1_echo_p ())
+    {
+        usart1_stats.echo_drops++;
+        return;
+    }
+
+    /* Discard the character if the buffer is full.  */
+    if ((uint8_t)(usart1_rx_head - usart1_rx_tail) >= USART1_RX_BUFFER_SIZE)
+    {
+        usart1_stats.rx_drops++;
+        return;
+    }
+
+    usart1_rx_buffer[usart1_rx_head & USART1_RX_MASK] = ch;
+    usart1_rx_times[usart1_rx_head & USART1_RX_MASK] = timer_get ();
+    usart1_rx_head++;
+    usart1_stats.rx_bytes++;
+}
+
+
+/* Data register empty interrupt handler.  */
+ISR (USART1_UDRE_vect)
+{
+    if (usart1_tx_head == usart1_tx_tail)
+    {
+        /* Nothing more to send; the transmit complete interrupt will
+           fire when the last character has been shifted out.  */
+        UCSR1B &= ~BIT (UDRIE1);
+        return;
+    }
+
+    UDR1 = usart1_tx_buffer[usart1_tx_tail & USART1_TX_MASK];
+    usart1_tx_tail++;
+    usart1_stats.tx_bytes++;
+}
+
+
+/* Transmit complete interrupt handler.  */
+ISR (USART1_TX_vect)
+{
+    /* A character may have been queued just as the last one was
+       shifted out; in which case we are still transmitting.  */
+    if (usart1_tx_head != usart1_tx_tail)
+        return;
+
+    usart1_tx_done = timer_get ();
+    usart1_tx_active = 0;
+}
+
+
 uint8_t
 usart1_init (const usart1_cfg_t *cfg)
 {
     uint8_t bits;
 
     usart1_baud_divisor_set (cfg->baud_divisor);
-    
+
     /* Default to 8 bits.  */
     bits = cfg->bits;
     if (bits < 5 || bits > 8)
         bits = 8;
 
-    /* Enable receiver and transmitter.  */
-    UCSR1B = BIT (RXEN1) | BIT (TXEN1);
+    usart1_echo_guard = cfg->echo_guard;
+
+    usart1_rx_head = usart1_rx_tail = 0;
+    usart1_tx_head = usart1_tx_tail = 0;
+    usart1_tx_active = 0;
+
+    /* Enable receiver and transmitter and the receive complete and
+       transmit complete interrupts.  The data register empty
+       interrupt is only enabled when there is something to send.  */
+    UCSR1B = BIT (RXEN1) | BIT (TXEN1) | BIT (RXCIE1) | BIT (TXCIE1);
 
     /* Set frame format: asynchronous USART, 1 stop bit, no parity.  */
     UCSR1C = ((bits - 5) << UCSZ10) | (0 << UPM10);
 
+    sei ();
+
     return 1;
 }
 
 
+/** Return pointer to the link statistics.  These are updated by the
+    interrupt handlers.  */
+const usart1_stats_t *
+usart1_stats_get (void)
+{
+    return &usart1_stats;
+}
+
+
 /** Return non-zero if there is a character ready to be read.  */
 bool
 usart1_read_ready_p (void)
 {
-    return (UCSR1A & BIT (RXC1)) != 0;
+    return usart1_rx_head != usart1_rx_tail;
 }
 
 
@@ -50,7 +203,7 @@ usart1_read_ready_p (void)
 bool
 usart1_write_ready_p (void)
 {
-    return (UCSR1A & BIT (UDRE1)) != 0;
+    return (uint8_t)(usart1_tx_head - usart1_tx_tail) < USART1_TX_BUFFER_SIZE;
 }
 
 
@@ -59,23 +212,73 @@ usart1_write_ready_p (void)
 bool
 usart1_write_finished_p (void)
 {
-    return (UCSR1A & BIT (TXC1)) != 0;
+    return !usart1_tx_active;
+}
+
+
+/** Write up to size bytes to USART1 without blocking.
+    @param data pointer to data to write
+    @param size maximum number of bytes to write
+    @return number of bytes queued for transmission.  */
+uint8_t
+usart1_write (const void *data, uint8_t size)
+{
+    const uint8_t *src = data;
+    uint8_t count;
+
+    for (count = 0; count < size && usart1_write_ready_p (); count++)
+    {
+        usart1_tx_buffer[usart1_tx_head & USART1_TX_MASK] = *src++;
+        usart1_tx_head++;
+    }
+
+    if (count)
+    {
+        usart1_tx_active = 1;
+        /* Kick the transmitter.  */
+        UCSR1B |= BIT (UDRIE1);
+    }
+    return count;
+}
+
+
+/** Read up to size bytes from USART1 without blocking.
+    @param data pointer to buffer to store data
+    @param size maximum number of bytes to read
+    @return number of bytes read.  */
+uint8_t
+usart1_read (void *data, uint8_t size)
+{
+    uint8_t *dst = data;
+    uint8_t count;
+
+    for (count = 0; count < size && usart1_read_ready_p (); count++)
+    {
+        *dst++ = usart1_rx_buffer[usart1_rx_tail & USART1_RX_MASK];
+        usart1_rx_time = usart1_rx_times[usart1_rx_tail & USART1_RX_MASK];
+        usart1_rx_tail++;
+    }
+    return count;
+}
+
+
+/** Return the time that the last character read was received.  This
+    is taken by the receive interrupt handler so it does not depend on
+    how long the character waited in the buffer.  */
+timer_tick_t
+usart1_rx_time_get (void)
+{
+    return usart1_rx_time;
 }
 
 
 /** Write character to USART1.  This blocks until the character can be
-    written into the transmit register.  */
+    written into the transmit buffer.  */
 void
 usart1_putc (char ch)
 {
-    while (!usart1_write_ready_p ())
-        continue;                   
-
-    /* Write a 1 to the TXC1 bit to clear it!  It will be set when the
-       data is shifted out of the transmit shift register.  */
-    UCSR1A |= BIT (TXC1);
-    
-    UDR1 = ch;
+    while (!usart1_write (&ch, 1))
+        continue;
 }
 
 
@@ -83,16 +286,18 @@ usart1_putc (char ch)
 int8_t
 usart1_getc (void)
 {
+    char ch;
+
     /* Wait for something in receive buffer.  */
-    while (!usart1_read_ready_p ())
+    while (!usart1_read (&ch, 1))
         continue;
 
-    return UDR1;
+    return ch;
 }
 
 
-/** Write string to USART1.  This blocks until the string is written.  */
-void 
+/** Write string to USART1.  This blocks until the string is queued.  */
+void
 usart1_puts (const char *str)
 {
     while (*str)
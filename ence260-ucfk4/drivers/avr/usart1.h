@@ -9,15 +9,51 @@
 #define USART1_H
 
 #include "system.h"
+#include "timer.h"
+
+
+/** Size of the receive buffer; this must be a power of 2.  */
+#ifndef USART1_RX_BUFFER_SIZE
+#define USART1_RX_BUFFER_SIZE 16
+#endif
+
+
+/** Size of the transmit buffer; this must be a power of 2.  */
+#ifndef USART1_TX_BUFFER_SIZE
+#define USART1_TX_BUFFER_SIZE 16
+#endif
+
 
 typedef struct usart1_cfg_struct
 {
     uint16_t baud_divisor;
     uint8_t bits;
+    /** Characters received while transmitting, or within this many
+        timer ticks of finishing transmitting, are discarded as echoes.
+        Zero disables echo suppression.  */
+    timer_tick_t echo_guard;
 } usart1_cfg_t;
 
 
 
+/** Link statistics.  The counters wrap at 65536.  */
+typedef struct usart1_stats_struct
+{
+    /** Characters transmitted.  */
+    uint16_t tx_bytes;
+    /** Characters received and buffered.  */
+    uint16_t rx_bytes;
+    /** Characters discarded as echoes of our own transmission.  */
+    uint16_t echo_drops;
+    /** Characters discarded with a framing error (bad stop bit).  */
+    uint16_t framing_errors;
+    /** Characters discarded with a data overrun.  */
+    uint16_t overrun_errors;
+    /** Characters discarded since the receive buffer was full.  */
+    uint16_t rx_drops;
+} usart1_stats_t;
+
+
 #define USART1_BAUD_DIVISOR(BAUD_RATE)  ((F_CPU / 16) / (BAUD_RATE))
 
 
@@ -26,6 +62,21 @@ bool
 usart1_read_ready_p (void);
 
 
+/** Read up to size bytes from USART1 without blocking.
+    @param data pointer to buffer to store data
+    @param size maximum number of bytes to read
+    @return number of bytes read.  */
+uint8_t
+usart1_read (void *data, uint8_t size);
+
+
+/** Return the time that the last character read was received.  This
+    is taken by the receive interrupt handler so it does not depend on
+    how long the character waited in the buffer.  */
+timer_tick_t
+usart1_rx_time_get (void);
+
+
 /** Read character from USART1.  This blocks if nothing is available to
     read.  */
 int8_t
@@ -43,8 +94,16 @@ bool
 usart1_write_finished_p (void);
 
 
+/** Write up to size bytes to USART1 without blocking.
+    @param data pointer to data to write
+    @param size maximum number of bytes to write
+    @return number of bytes queued for transmission.  */
+uint8_t
+usart1_write (const void *data, uint8_t size);
+
+
 /** Write character to USART1.  This blocks until the character can be
-    written into the transmit register.  */
+    written into the transmit buffer.  */
 void
 usart1_putc (char ch);
 
@@ -54,6 +113,19 @@ void
 usart1_puts (const char *str);
 
 
+/** Return pointer to the link statistics.  These are updated by the
+    interrupt handlers.  */
+const usart1_stats_t *
+usart1_stats_get (void);
+
+
+/** Change the baud rate.  This should only be done when the
+    transmitter has finished.
+    @param divisor baud rate divisor, see USART1_BAUD_DIVISOR.  */
+void
+usart1_baud_divisor_set (uint16_t divisor);
+
+
 /** Initialise usart1 and set baud rate.  */
 uint8_t
 usart1_init (const usart1_cfg_t *cfg);
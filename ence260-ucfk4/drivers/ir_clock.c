@@ -0,0 +1,420 @@
+/** @file   ir_clock.c
+    @author agent
+    @date   19 October 2026
+    @brief  Clock synchronisation between two boards over the IR UART.
+
+    @note The 16 bit timer is extended to 32 bits by accumulating the
+    ticks between calls so it must be read at least every 2 s.  All
+    the timestamps are of the start of a message; the time a message
+    is received is found by subtracting the duration of the message
+    from the time its last character was received.  This is taken by
+    the UART receive interrupt handler so it does not depend on how
+    long the application takes to read the message.  The duration
+    depends on the baud rate, which may change if IR_UART_BAUD_ADAPT
+    is enabled.
+*/
+#include "ir_clock.h"
+#include "ir_uart.h"
+#include "crc8.h"
+
+
+#define IR_CLOCK_SOF 0xfc
+
+#define IR_CLOCK_POLL 0x01
+#define IR_CLOCK_REPLY 0x02
+
+/* SOF, type, origin, receive, transmit, and CRC.  */
+#define IR_CLOCK_MSG_SIZE 15
+
+#define IR_CLOCK_POLL_TICKS ((ir_clock_tick_t)(IR_CLOCK_POLL_PERIOD * TIMER_RATE))
+
+#define IR_CLOCK_SKEW_TICKS ((ir_clock_tick_t)(IR_CLOCK_SKEW_PERIOD * TIMER_RATE))
+
+/* The skew is kept as a fraction with this many bits.  */
+#define IR_CLOCK_SKEW_BITS 24
+
+
+typedef struct
+{
+    int32_t offset;
+    uint16_t delay;
+    ir_clock_tick_t when;
+} ir_clock_sample_t;
+
+
+/* Local time extended to 32 bits.  */
+static ir_clock_tick_t local_time;
+static timer_tick_t local_last;
+
+/* Timestamps to send in the next message.  */
+static ir_clock_tick_t peer_transmit;
+static ir_clock_tick_t peer_receive;
+static ir_clock_tick_t last_transmit;
+static bool reply_pending;
+static ir_clock_tick_t poll_time;
+static uint16_t poll_random;
+
+/* Message being received.  */
+static uint8_t rx_msg[IR_CLOCK_MSG_SIZE];
+static uint8_t rx_index;
+static timer_tick_t rx_time;
+
+static ir_clock_sample_t samples[IR_CLOCK_SAMPLES];
+static uint8_t samples_num;
+static uint8_t samples_next;
+
+/* Best estimate of the offset of the other clock and the time it
+   was measured.  */
+static bool synced;
+static ir_clock_sample_t best;
+
+/* The offset at the start of the skew measurement.  */
+static ir_clock_sample_t anchor;
+static bool anchor_valid;
+static int32_t skew;
+
+static ir_clock_tick_t shared_last;
+
+
+static ir_clock_tick_t
+ir_clock_local_get (void)
+{
+    timer_tick_t now;
+
+    now = timer_get ();
+    local_time += (timer_tick_t)(now - local_last);
+    local_last = now;
+    return local_time;
+}
+
+
+/** Return the time to send some characters at the current baud
+    rate.  */
+static timer_tick_t
+ir_clock_chars_ticks (uint8_t chars)
+{
+    uint16_t baud;
+
+#if IR_UART_BAUD_ADAPT
+    baud = ir_uart_baud_rate_get ();
+#else
+    baud = IR_UART_BAUD_RATE;
+#endif
+
+    /* Start bit, 8 data bits, and stop bit.  */
+    return chars * 10 * (uint32_t)TIMER_RATE / baud;
+}
+
+
+static void
+ir_clock_put32 (uint8_t *buffer, ir_clock_tick_t value)
+{
+    uint8_t i;
+
+    for (i = 0; i < 4; i++)
+    {
+        buffer[i] = value;
+        value >>= 8;
+    }
+}
+
+
+static ir_clock_tick_t
+ir_clock_get32 (const uint8_t *buffer)
+{
+    ir_clock_tick_t value = 0;
+    uint8_t i;
+
+    for (i = 4; i-- > 0; )
+        value = (value << 8) | buffer[i];
+    return value;
+}
+
+
+/** Update the skew estimate from a new best offset.  */
+static void
+ir_clock_skew_update (void)
+{
+    int32_t estimate;
+    ir_clock_tick_t period;
+
+    if (!anchor_valid)
+    {
+        anchor = best;
+        anchor_valid = 1;
+        return;
+    }
+
+    period = best.when - anchor.when;
+    if (period < IR_CLOCK_SKEW_TICKS)
+        return;
+
+    estimate = ((int64_t)(best.offset - anchor.offset) << IR_CLOCK_SKEW_BITS)
+        / (int32_t)period;
+
+    /* Smooth the estimate since each offset has some error.  */
+    if (!skew)
+        skew = estimate;
+    else
+        skew += (estimate - skew) / 4;
+
+    anchor = best;
+}
+
+
+/** Add an offset sample and choose the one with the least delay.  */
+static void
+ir_clock_sample_add (int32_t offset, int32_t delay, ir_clock_tick_t when)
+{
+    uint8_t i;
+    ir_clock_sample_t *sample;
+
+    /* The delay can be slightly negative since the receive times are
+       taken at the stop bit.  */
+    if (delay < 0)
+        delay = 0;
+    if (delay > 0xffff)
+        return;
+
+    sample = &samples[samples_next];
+    sample->offset = offset;
+    sample->delay = delay;
+    sample->when = when;
+    samples_next = (samples_next + 1) % IR_CLOCK_SAMPLES;
+    if (samples_num < IR_CLOCK_SAMPLES)
+        samples_num++;
+
+    sample = &samples[0];
+    for (i = 1; i < samples_num; i++)
+    {
+        if (samples[i].delay < sample->delay)
+            sample = &samples[i];
+    }
+
+    /* Only use a sample once.  */
+    if (synced && sample->when == best.when)
+        return;
+
+    best = *sample;
+    synced = 1;
+    ir_clock_skew_update ();
+}
+
+
+/** Process a complete message.  */
+static void
+ir_clock_message_process (ir_clock_tick_t destination)
+{
+    ir_clock_tick_t origin;
+    ir_clock_tick_t receive;
+    ir_clock_tick_t transmit;
+    int32_t offset;
+    int32_t delay;
+
+    if (crc8 (CRC8_INIT, rx_msg, IR_CLOCK_MSG_SIZE - 1)
+        != rx_msg[IR_CLOCK_MSG_SIZE - 1])
+        return;
+
+    origin = ir_clock_get32 (&rx_msg[2]);
+    receive = ir_clock_get32 (&rx_msg[6]);
+    transmit = ir_clock_get32 (&rx_msg[10]);
+
+    /* This is only a valid sample if it answers our last message.  */
+    if (origin == last_transmit && receive)
+    {
+        offset = ((int32_t)(receive - origin)
+                  + (int32_t)(transmit - destination)) / 2;
+        delay = (int32_t)(destination - origin)
+            - (int32_t)(transmit - receive);
+        ir_clock_sample_add (offset, delay, destination);
+    }
+
+    peer_transmit = transmit;
+    peer_receive = destination;
+    if (rx_msg[1] == IR_CLOCK_POLL)
+        reply_pending = 1;
+}
+
+
+/** Feed a received character to the clock protocol.  */
+bool
+ir_clock_receive (uint8_t ch)
+{
+    timer_tick_t when;
+    ir_clock_tick_t destination;
+
+    when = ir_uart_rx_time_get ();
+
+    /* The characters of a message are sent back to back so a gap
+       means the rest was lost.  */
+    if (rx_index && (timer_tick_t)(when - rx_time) > ir_clock_chars_ticks (2))
+        rx_index = 0;
+    rx_time = when;
+
+    if (!rx_index && ch != IR_CLOCK_SOF)
+        return 0;
+
+    rx_msg[rx_index++] = ch;
+    if (rx_index == IR_CLOCK_MSG_SIZE)
+    {
+        rx_index = 0;
+
+        /* Convert the time the last character was received to local
+           time, allowing for how long ago that was.  */
+        destination = ir_clock_local_get ();
+        destination -= (timer_tick_t)(local_last - when);
+        ir_clock_message_process (destination
+                                  - ir_clock_chars_ticks (IR_CLOCK_MSG_SIZE));
+    }
+    return 1;
+}
+
+
+/** Send a message.  */
+static void
+ir_clock_message_send (uint8_t type)
+{
+    uint8_t msg[IR_CLOCK_MSG_SIZE];
+
+    /* The transmitter is idle so the message starts now.  */
+    last_transmit = ir_clock_local_get ();
+
+    msg[0] = IR_CLOCK_SOF;
+    msg[1] = type;
+    ir_clock_put32 (&msg[2], peer_transmit);
+    ir_clock_put32 (&msg[6], peer_receive);
+    ir_clock_put32 (&msg[10], last_transmit);
+    msg[14] = crc8 (CRC8_INIT, msg, IR_CLOCK_MSG_SIZE - 1);
+
+    ir_uart_write (msg, IR_CLOCK_MSG_SIZE);
+}
+
+
+/** Send polls and replies.  */
+void
+ir_clock_update (void)
+{
+    ir_clock_tick_t now;
+
+    now = ir_clock_local_get ();
+
+    /* Do not interrupt a message being sent or received.  */
+    if (!ir_uart_write_finished_p () || rx_index)
+        return;
+
+    if (reply_pending)
+    {
+        reply_pending = 0;
+        ir_clock_message_send (IR_CLOCK_REPLY);
+        return;
+    }
+
+    if ((int32_t)(now - poll_time) < 0)
+        return;
+
+    ir_clock_message_send (IR_CLOCK_POLL);
+
+    /* Jitter the poll period by up to 1/4 so that the polls of the
+       two boards do not keep colliding.  */
+    poll_random = poll_random * 25173 + 13849;
+    poll_time = now + IR_CLOCK_POLL_TICKS
+        - (IR_CLOCK_POLL_TICKS / 4 * (poll_random >> 8) >> 8);
+}
+
+
+/** Return non-zero once the offset of the other clock is known.  */
+bool
+ir_clock_synced_p (void)
+{
+    return synced;
+}
+
+
+/** Return the estimated offset of the other clock in timer ticks.  */
+int32_t
+ir_clock_offset_get (void)
+{
+    return best.offset;
+}
+
+
+/** Return the round-trip delay of the sample the offset was found
+    from in timer ticks.  */
+uint16_t
+ir_clock_delay_get (void)
+{
+    return best.delay;
+}
+
+
+/** Return the estimated skew of the other clock in parts per
+    million.  */
+int16_t
+ir_clock_skew_get (void)
+{
+    return ((int64_t)skew * 1000000) >> IR_CLOCK_SKEW_BITS;
+}
+
+
+/** Return the shared time.  */
+ir_clock_tick_t
+ir_clock_get (void)
+{
+    ir_clock_tick_t now;
+    ir_clock_tick_t shared;
+    int32_t offset;
+
+    now = ir_clock_local_get ();
+
+    offset = best.offset;
+    if (synced)
+        offset += ((int64_t)skew * (int32_t)(now - best.when))
+            >> IR_CLOCK_SKEW_BITS;
+
+    /* The shared time is midway between the two clocks.  */
+    shared = now + offset / 2;
+
+    /* Do not go backwards if the offset estimate is reduced.  */
+    if ((int32_t)(shared - shared_last) < 0)
+        return shared_last;
+    shared_last = shared;
+    return shared;
+}
+
+
+/** Return how far the shared time is past the nearest multiple of a
+    period.  */
+int16_t
+ir_clock_phase_error (timer_tick_t period)
+{
+    timer_tick_t phase;
+
+    phase = ir_clock_get () % period;
+    if (phase >= period / 2)
+        return phase - period;
+    return phase;
+}
+
+
+/** Initialise IR clock synchronisation.  */
+void
+ir_clock_init (void)
+{
+    local_last = timer_get ();
+    local_time = local_last;
+
+    peer_transmit = peer_receive = 0;
+    last_transmit = 0;
+    reply_pending = 0;
+    rx_index = 0;
+    samples_num = samples_next = 0;
+    synced = 0;
+    anchor_valid = 0;
+    skew = 0;
+    best.offset = 0;
+    best.delay = 0;
+
+    poll_random = local_last;
+    poll_time = local_time;
+    shared_last = local_time;
+}
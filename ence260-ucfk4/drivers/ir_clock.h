@@ -0,0 +1,159 @@
+/** @file   ir_clock.h
+    @author agent
+    @date   19 October 2026
+    @brief  Clock synchronisation between two boards over the IR UART.
+
+    @defgroup ir_clock IR clock synchronisation
+
+    This module gives two boards a shared timebase so that they can
+    run their game ticks in step.  Each board has its own timer and
+    the crystals differ slightly, so the timers have both an offset
+    and a skew (a difference in rate) that has to be estimated.
+
+    The boards exchange timestamps in the same way as NTP.  Every
+    IR_CLOCK_POLL_PERIOD seconds each board sends a poll that the
+    other board answers straight away.  A message carries three
+    timestamps: when the message it answers was sent (origin), when
+    that message was received (receive), and when this message is
+    sent (transmit).  With the time the reply is received
+    (destination) the offset of the other clock is
+
+       offset = ((receive - origin) + (transmit - destination)) / 2
+
+    and the round-trip delay is
+
+       delay = (destination - origin) - (transmit - receive).
+
+    The offset is in error by at most half the delay so only the
+    sample with the smallest delay out of the last IR_CLOCK_SAMPLES is
+    used.  The skew is found from the change in offset over at least
+    IR_CLOCK_SKEW_PERIOD seconds.
+
+    The shared time is the mean of the two clocks so neither board is
+    the master; each adds half the offset of the other clock to its
+    own.  The shared time is 32 bits of timer ticks and never goes
+    backwards.
+
+    A message is 15 bytes starting with the byte 0xfc.  The IR UART is
+    shared with the application so the application reads the received
+    characters and passes each to ir_clock_receive, which says whether
+    it belongs to a clock message.
+
+    The pacer can be disciplined against the shared time so that the
+    ticks of both boards line up.  Here's a paced loop that does this:
+
+       @code
+       #include "ir_clock.h"
+       #include "ir_uart.h"
+       #include "pacer.h"
+
+       #define LOOP_RATE 500
+
+       void main (void)
+       {
+           system_init ();
+           ir_uart_init ();
+           ir_clock_init ();
+           pacer_init (LOOP_RATE);
+
+           while (1)
+           {
+               uint8_t ch;
+
+               pacer_wait ();
+               pacer_adjust (-ir_clock_phase_error (TIMER_RATE / LOOP_RATE) / 2);
+
+               while (ir_uart_read (&ch, 1))
+               {
+                   if (!ir_clock_receive (ch))
+                   {
+                       // Process the character.
+                   }
+               }
+               ir_clock_update ();
+           }
+       }
+       @endcode
+*/
+
+#ifndef IR_CLOCK_H
+#define IR_CLOCK_H
+
+#include "system.h"
+#include "timer.h"
+
+
+/** Time between polls (s).  */
+#ifndef IR_CLOCK_POLL_PERIOD
+#define IR_CLOCK_POLL_PERIOD 1.0
+#endif
+
+
+/** Number of samples the best offset is chosen from.  */
+#ifndef IR_CLOCK_SAMPLES
+#define IR_CLOCK_SAMPLES 4
+#endif
+
+
+/** Minimum time over which the skew is measured (s).  */
+#ifndef IR_CLOCK_SKEW_PERIOD
+#define IR_CLOCK_SKEW_PERIOD 8.0
+#endif
+
+
+/** Shared time in timer ticks.  */
+typedef uint32_t ir_clock_tick_t;
+
+
+/** Feed a received character to the clock protocol.  This must be
+    called with each character as it is read since it uses the time
+    that the last character read was received, see
+    ir_uart_rx_time_get.
+    @param ch character read from the IR UART
+    @return non-zero if the character is part of a clock message; if
+    zero the application should process it.  */
+bool ir_clock_receive (uint8_t ch);
+
+
+/** Send polls and replies.  This must be called frequently, and at
+    least once a second, to keep track of the timer.  It does not
+    block.  */
+void ir_clock_update (void);
+
+
+/** Return non-zero once the offset of the other clock is known.  */
+bool ir_clock_synced_p (void);
+
+
+/** Return the estimated offset of the other clock in timer ticks.  */
+int32_t ir_clock_offset_get (void);
+
+
+/** Return the round-trip delay of the sample the offset was found
+    from in timer ticks.  The offset is in error by at most half of
+    this.  */
+uint16_t ir_clock_delay_get (void);
+
+
+/** Return the estimated skew of the other clock in parts per
+    million.  */
+int16_t ir_clock_skew_get (void);
+
+
+/** Return the shared time.  */
+ir_clock_tick_t ir_clock_get (void);
+
+
+/** Return how far the shared time is past the nearest multiple of a
+    period.  The result is negative if the shared time is just before
+    a multiple.
+    @param period period in timer ticks
+    @return phase error in timer ticks.  */
+int16_t ir_clock_phase_error (timer_tick_t period);
+
+
+/** Initialise IR clock synchronisation.  The IR UART must be
+    initialised separately.  */
+void ir_clock_init (void);
+
+#endif
@@ -0,0 +1,102 @@
+/** @file   ir_fec.c
+    @author agent
+    @date   19 October 2026
+    @brief  Forward error correction for the IR drivers.
+
+    @note The codeword is built and checked a bit at a time; this is
+    slower than using lookup tables but saves flash.
+*/
+#include "ir_fec.h"
+
+
+/* Positions 1, 2, 4, and 8 are parity bits.  */
+#define IR_FEC_PARITY_P(POS) (((POS) & ((POS) - 1)) == 0)
+
+
+/** Return the syndrome of a codeword.  */
+static uint8_t
+ir_fec_syndrome (uint16_t code)
+{
+    uint8_t syndrome;
+    uint8_t pos;
+
+    syndrome = 0;
+    for (pos = 1; pos <= IR_FEC_CODE_BITS; pos++)
+    {
+        if (code & 1)
+            syndrome ^= pos;
+        code >>= 1;
+    }
+    return syndrome;
+}
+
+
+/** Encode a byte.
+    @param data byte to encode
+    @return 12 bit codeword.  */
+uint16_t
+ir_fec_encode (uint8_t data)
+{
+    uint16_t code;
+    uint8_t syndrome;
+    uint8_t pos;
+
+    /* Scatter the data bits over the non-parity positions.  */
+    code = 0;
+    for (pos = 1; pos <= IR_FEC_CODE_BITS; pos++)
+    {
+        if (IR_FEC_PARITY_P (pos))
+            continue;
+        if (data & 1)
+            code |= BIT (pos - 1);
+        data >>= 1;
+    }
+
+    /* The syndrome of the data bits gives the parity bits needed to
+       make it zero.  */
+    syndrome = ir_fec_syndrome (code);
+    for (pos = 1; pos <= 8; pos <<= 1)
+    {
+        if (syndrome & pos)
+            code |= BIT (pos - 1);
+    }
+    return code;
+}
+
+
+/** Decode a codeword, correcting a single bit error.
+    @param code 12 bit codeword
+    @param pdata pointer to byte to store decoded data
+    @return status code.  The data is not valid if IR_FEC_ERROR is
+    returned.  */
+ir_fec_ret_t
+ir_fec_decode (uint16_t code, uint8_t *pdata)
+{
+    ir_fec_ret_t ret;
+    uint8_t syndrome;
+    uint8_t data;
+    uint8_t pos;
+
+    ret = IR_FEC_OK;
+    syndrome = ir_fec_syndrome (code);
+    if (syndrome > IR_FEC_CODE_BITS)
+        return IR_FEC_ERROR;
+    if (syndrome)
+    {
+        code ^= BIT (syndrome - 1);
+        ret = IR_FEC_CORRECTED;
+    }
+
+    /* Gather the data bits, MSB first.  */
+    data = 0;
+    for (pos = IR_FEC_CODE_BITS; pos >= 1; pos--)
+    {
+        if (IR_FEC_PARITY_P (pos))
+            continue;
+        data <<= 1;
+        if (code & BIT (pos - 1))
+            data |= 1;
+    }
+    *pdata = data;
+    return ret;
+}
@@ -0,0 +1,61 @@
+/** @file   ir_fec.h
+    @author agent
+    @date   19 October 2026
+    @brief  Forward error correction for the IR drivers.
+
+    @defgroup ir_fec Forward error correction for the IR drivers
+
+    This module encodes a byte as a 12 bit Hamming(12,8) codeword that
+    can be sent over the IR link.  The receiver can correct any single
+    bit error in the codeword and detects many (but not all) multiple
+    bit errors.  The cost is that 50 percent more bits are sent.
+
+    The codeword bits are numbered 1 to 12 and are stored in bits 0 to
+    11 of a uint16_t.  Bits 1, 2, 4, and 8 are parity bits and the
+    eight data bits are in the remaining positions, LSB first.  The
+    syndrome of a received codeword is the exclusive-or of the
+    positions of the set bits.  This is zero for a valid codeword or
+    the position of a single flipped bit.  Syndromes 13 to 15 cannot
+    be produced by a single bit error.
+
+    The codec is used by the @ref IR_serial "IR serial" driver when
+    IR_SERIAL_FEC is defined and by the @ref ir_uart_fec "IR UART FEC"
+    byte stream.
+*/
+
+#ifndef IR_FEC_H
+#define IR_FEC_H
+
+#include "system.h"
+
+
+/** Number of bits in a codeword.  */
+#define IR_FEC_CODE_BITS 12
+
+
+/** Status return codes.  */
+typedef enum ir_fec_ret
+{
+    /** Codeword corrected.  */
+    IR_FEC_CORRECTED = 1,
+    /** Codeword valid.  */
+    IR_FEC_OK = 0,
+    /** Uncorrectable error detected.  */
+    IR_FEC_ERROR = -1
+} ir_fec_ret_t;
+
+
+/** Encode a byte.
+    @param data byte to encode
+    @return 12 bit codeword.  */
+uint16_t ir_fec_encode (uint8_t data);
+
+
+/** Decode a codeword, correcting a single bit error.
+    @param code 12 bit codeword
+    @param pdata pointer to byte to store decoded data
+    @return status code.  The data is not valid if IR_FEC_ERROR is
+    returned.  */
+ir_fec_ret_t ir_fec_decode (uint16_t code, uint8_t *pdata);
+
+#endif
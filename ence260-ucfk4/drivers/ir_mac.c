@@ -0,0 +1,523 @@
+/** @file   ir_mac.c
+    @author agent
+    @date   19 October 2026
+    @brief  Multi-node medium access control over the IR UART.
+
+    @note The transmitter is a state machine driven by ir_mac_update.
+    A queued frame waits in the backoff state until the link has been
+    idle long enough, is written to the UART, and then for a unicast
+    frame waits for the acknowledgement.  Character times are counted
+    with the timer so nothing blocks.
+*/
+#include "ir_mac.h"
+#include "ir_uart.h"
+#include "timer.h"
+#include "crc8.h"
+
+
+#if IR_MAC_PAYLOAD_MAX > 32
+#error IR_MAC_PAYLOAD_MAX too large
+#endif
+
+#if (IR_MAC_CW_MIN & (IR_MAC_CW_MIN - 1)) != 0 \
+    || (IR_MAC_CW_MAX & (IR_MAC_CW_MAX - 1)) != 0
+#error IR_MAC_CW_MIN and IR_MAC_CW_MAX must be powers of 2
+#endif
+
+#if IR_MAC_NODES > IR_MAC_BROADCAST
+#error IR_MAC_NODES too large
+#endif
+
+
+#define IR_MAC_SOF 0x7e
+
+#define IR_MAC_CTRL_ACK 0x80
+#define IR_MAC_SEQ_MASK 0x0f
+
+/* SOF, LEN, CTRL, DST, SRC, and CRC.  */
+#define IR_MAC_OVERHEAD 6
+
+/* Start bit, 8 data bits, and stop bit.  */
+#define IR_MAC_CHAR_TICKS \
+    ((timer_tick_t)(10.0 * TIMER_RATE / IR_UART_BAUD_RATE + 1))
+
+/* A character is only sensed once it has been received so a node
+   that starts transmitting is not heard for a character time.  With
+   a slot of two character times, nodes that pick different backoffs
+   do not collide.  */
+#define IR_MAC_SLOT_TICKS (2 * IR_MAC_CHAR_TICKS)
+
+#define IR_MAC_IFS_TICKS (IR_MAC_IFS_SLOTS * IR_MAC_SLOT_TICKS)
+
+/* The acknowledgement is sent once the receiver next polls after the
+   frame so allow a few character times for this.  */
+#define IR_MAC_ACK_TIMEOUT_TICKS ((IR_MAC_OVERHEAD + 4) * IR_MAC_CHAR_TICKS)
+
+/* Marks a sequence number as unknown.  */
+#define IR_MAC_SEQ_NONE 0xff
+
+
+typedef enum {IR_MAC_STATE_HUNT, IR_MAC_STATE_LEN,
+              IR_MAC_STATE_CTRL, IR_MAC_STATE_DST,
+              IR_MAC_STATE_SRC, IR_MAC_STATE_DATA,
+              IR_MAC_STATE_CRC} ir_mac_parse_state_t;
+
+
+typedef enum {IR_MAC_TX_IDLE, IR_MAC_TX_BACKOFF,
+              IR_MAC_TX_SENDING, IR_MAC_TX_WAIT_ACK} ir_mac_tx_state_t;
+
+
+static uint8_t mac_address;
+static uint16_t mac_random;
+
+/* Time the link was last seen busy, either with a received character
+   or with our own transmission.  */
+static timer_tick_t chan_time;
+
+/* Transmit state.  */
+static ir_mac_tx_state_t tx_state;
+static uint8_t tx_data[IR_MAC_PAYLOAD_MAX];
+static uint8_t tx_size;
+static uint8_t tx_dest;
+static uint8_t tx_seq;
+static uint8_t tx_retries;
+static uint8_t tx_cw;
+static uint8_t tx_backoff;
+static bool tx_counting;
+static timer_tick_t tx_time;
+
+/* Frame being sent.  The UART transmit buffer may be smaller than a
+   frame so the rest is written on later updates.  */
+static uint8_t tx_frame[IR_MAC_PAYLOAD_MAX + IR_MAC_OVERHEAD];
+static uint8_t tx_frame_size;
+static uint8_t tx_frame_sent;
+
+/* Pending acknowledgement.  */
+static bool ack_pending;
+static uint8_t ack_dest;
+static uint8_t ack_seq;
+
+/* Receive state.  Only one frame is held; further frames are
+   discarded (and not acknowledged) until it has been read.  */
+static uint8_t rx_data[IR_MAC_PAYLOAD_MAX];
+static uint8_t rx_size;
+static uint8_t rx_src;
+static bool rx_ready;
+/* Sequence number of the last unicast frame from each node.  */
+static uint8_t rx_seq[IR_MAC_NODES];
+
+/* Frame parser state.  */
+static ir_mac_parse_state_t parse_state;
+static uint8_t parse_buffer[IR_MAC_PAYLOAD_MAX];
+static uint8_t parse_size;
+static uint8_t parse_ctrl;
+static uint8_t parse_dst;
+static uint8_t parse_src;
+static uint8_t parse_index;
+static uint8_t parse_crc;
+
+static ir_mac_stats_t ir_mac_stats;
+
+static const char * const ir_mac_stats_names[] =
+{
+    "tx_frames", "tx_acked", "retries", "failures", "tx_acks",
+    "rx_frames", "crc_errors", "duplicates", "rx_drops", "defers"
+};
+
+
+/** Return a pseudo-random number (16 bit xorshift).  */
+static uint8_t
+ir_mac_random (void)
+{
+    mac_random ^= mac_random << 7;
+    mac_random ^= mac_random >> 9;
+    mac_random ^= mac_random << 8;
+    return mac_random;
+}
+
+
+/** Pick a backoff for the next attempt.  */
+static void
+ir_mac_backoff_start (void)
+{
+    tx_backoff = ir_mac_random () & (tx_cw - 1);
+    tx_counting = 0;
+    tx_state = IR_MAC_TX_BACKOFF;
+}
+
+
+/** Return non-zero if a frame can be queued for sending.  */
+bool
+ir_mac_send_ready_p (void)
+{
+    return tx_state == IR_MAC_TX_IDLE;
+}
+
+
+/** Queue a frame for sending.  */
+bool
+ir_mac_send (uint8_t dest, const void *data, uint8_t size)
+{
+    const uint8_t *src = data;
+    uint8_t i;
+
+    if (!size || size > IR_MAC_PAYLOAD_MAX || !ir_mac_send_ready_p ()
+        || (dest >= IR_MAC_NODES && dest != IR_MAC_BROADCAST)
+        || dest == mac_address)
+        return 0;
+
+    for (i = 0; i < size; i++)
+        tx_data[i] = src[i];
+    tx_size = size;
+    tx_dest = dest;
+    tx_seq = (tx_seq + 1) & IR_MAC_SEQ_MASK;
+    tx_retries = 0;
+    tx_cw = IR_MAC_CW_MIN;
+
+    /* Even the first attempt has a backoff so that nodes that all
+       want to send when the link goes idle do not collide.  */
+    ir_mac_backoff_start ();
+    return 1;
+}
+
+
+/** Read a received frame.  */
+uint8_t
+ir_mac_recv (uint8_t *psrc, void *data, uint8_t size)
+{
+    uint8_t *dst = data;
+    uint8_t i;
+
+    if (!rx_ready)
+        return 0;
+
+    if (size > rx_size)
+        size = rx_size;
+    for (i = 0; i < size; i++)
+        dst[i] = rx_data[i];
+    *psrc = rx_src;
+
+    rx_ready = 0;
+    return rx_size;
+}
+
+
+/** Handle a complete frame with a valid CRC.  */
+static void
+ir_mac_frame_process (void)
+{
+    uint8_t seq;
+    uint8_t i;
+
+    /* Ignore our own frames and those from invalid addresses.  */
+    if (parse_src >= IR_MAC_NODES || parse_src == mac_address)
+        return;
+
+    if (parse_dst != mac_address && parse_dst != IR_MAC_BROADCAST)
+        return;
+
+    seq = parse_ctrl & IR_MAC_SEQ_MASK;
+
+    if (parse_ctrl & IR_MAC_CTRL_ACK)
+    {
+        if (tx_state == IR_MAC_TX_WAIT_ACK && parse_src == tx_dest
+            && seq == tx_seq)
+        {
+            ir_mac_stats.tx_acked++;
+            tx_state = IR_MAC_TX_IDLE;
+        }
+        return;
+    }
+
+    if (!parse_size)
+        return;
+
+    if (parse_dst != IR_MAC_BROADCAST && seq == rx_seq[parse_src])
+    {
+        /* Our acknowledgement was lost so send it again.  */
+        ir_mac_stats.duplicates++;
+    }
+    else if (rx_ready)
+    {
+        /* Let the sender retry once the frame has been read.  */
+        ir_mac_stats.rx_drops++;
+        return;
+    }
+    else
+    {
+        for (i = 0; i < parse_size; i++)
+            rx_data[i] = parse_buffer[i];
+        rx_size = parse_size;
+        rx_src = parse_src;
+        rx_ready = 1;
+        ir_mac_stats.rx_frames++;
+    }
+
+    if (parse_dst != IR_MAC_BROADCAST)
+    {
+        rx_seq[parse_src] = seq;
+        ack_pending = 1;
+        ack_dest = parse_src;
+        ack_seq = seq;
+    }
+}
+
+
+/** Feed a received character to the frame parser.  */
+static void
+ir_mac_parse (uint8_t ch)
+{
+    switch (parse_state)
+    {
+    case IR_MAC_STATE_HUNT:
+        if (ch == IR_MAC_SOF)
+            parse_state = IR_MAC_STATE_LEN;
+        break;
+
+    case IR_MAC_STATE_LEN:
+        if (ch > IR_MAC_PAYLOAD_MAX)
+        {
+            /* This may be the start of a frame if the previous SOF
+               was noise.  */
+            parse_state = ch == IR_MAC_SOF
+                ? IR_MAC_STATE_LEN : IR_MAC_STATE_HUNT;
+            break;
+        }
+        parse_size = ch;
+        parse_crc = crc8_update (CRC8_INIT, ch);
+        parse_state = IR_MAC_STATE_CTRL;
+        break;
+
+    case IR_MAC_STATE_CTRL:
+        parse_ctrl = ch;
+        parse_crc = crc8_update (parse_crc, ch);
+        parse_state = IR_MAC_STATE_DST;
+        break;
+
+    case IR_MAC_STATE_DST:
+        parse_dst = ch;
+        parse_crc = crc8_update (parse_crc, ch);
+        parse_state = IR_MAC_STATE_SRC;
+        break;
+
+    case IR_MAC_STATE_SRC:
+        parse_src = ch;
+        parse_crc = crc8_update (parse_crc, ch);
+        parse_index = 0;
+        parse_state = parse_size
+            ? IR_MAC_STATE_DATA : IR_MAC_STATE_CRC;
+        break;
+
+    case IR_MAC_STATE_DATA:
+        parse_buffer[parse_index++] = ch;
+        parse_crc = crc8_update (parse_crc, ch);
+        if (parse_index == parse_size)
+            parse_state = IR_MAC_STATE_CRC;
+        break;
+
+    case IR_MAC_STATE_CRC:
+        parse_state = IR_MAC_STATE_HUNT;
+        if (ch != parse_crc)
+        {
+            ir_mac_stats.crc_errors++;
+            break;
+        }
+        ir_mac_frame_process ();
+        break;
+    }
+}
+
+
+/** Write as much of the current frame as the UART will take.
+    @return non-zero if the whole frame has been written.  */
+static bool
+ir_mac_frame_flush (void)
+{
+    if (tx_frame_sent == tx_frame_size)
+        return 1;
+
+    tx_frame_sent += ir_uart_write (&tx_frame[tx_frame_sent],
+                                    tx_frame_size - tx_frame_sent);
+    return tx_frame_sent == tx_frame_size;
+}
+
+
+/** Build and start sending a frame.  This should only be called when
+    the previous frame has been written and the transmitter is
+    idle.  */
+static void
+ir_mac_frame_send (uint8_t ctrl, uint8_t dest, const uint8_t *data,
+                   uint8_t size)
+{
+    uint8_t i;
+
+    tx_frame[0] = IR_MAC_SOF;
+    tx_frame[1] = size;
+    tx_frame[2] = ctrl;
+    tx_frame[3] = dest;
+    tx_frame[4] = mac_address;
+    for (i = 0; i < size; i++)
+        tx_frame[5 + i] = data[i];
+    tx_frame[5 + size] = crc8 (CRC8_INIT, &tx_frame[1], size + 4);
+
+    tx_frame_size = size + IR_MAC_OVERHEAD;
+    tx_frame_sent = 0;
+    ir_mac_frame_flush ();
+}
+
+
+/** Return non-zero if the link is busy or has not been idle for the
+    interframe space.  */
+static bool
+ir_mac_busy_p (timer_tick_t now)
+{
+    return (timer_tick_t)(now - chan_time) < IR_MAC_IFS_TICKS;
+}
+
+
+/** Process received characters, send acknowledgements, and send or
+    resend frames.  */
+void
+ir_mac_update (void)
+{
+    timer_tick_t now;
+    uint8_t ch;
+
+    now = timer_get ();
+
+    while (ir_uart_read (&ch, 1))
+    {
+        /* The characters of a frame are sent back to back so a gap
+           means that the rest of the frame was lost, say in a
+           collision.  Without this the next frame would be taken as
+           the rest of this one.  */
+        if ((timer_tick_t)(now - chan_time) > IR_MAC_SLOT_TICKS)
+            parse_state = IR_MAC_STATE_HUNT;
+        chan_time = now;
+        ir_mac_parse (ch);
+    }
+
+    /* Wait for the current frame to be sent; this keeps the link
+       half-duplex and prevents frames being interleaved.  */
+    if (!ir_mac_frame_flush () || !ir_uart_write_finished_p ())
+    {
+        chan_time = now;
+        return;
+    }
+
+    if (tx_state == IR_MAC_TX_SENDING)
+    {
+        if (tx_dest == IR_MAC_BROADCAST)
+        {
+            tx_state = IR_MAC_TX_IDLE;
+        }
+        else
+        {
+            tx_state = IR_MAC_TX_WAIT_ACK;
+            tx_time = now;
+        }
+    }
+
+    /* An acknowledgement is sent without waiting for the link to be
+       idle; the link is ours until then.  */
+    if (ack_pending)
+    {
+        ir_mac_frame_send (IR_MAC_CTRL_ACK | ack_seq, ack_dest, 0, 0);
+        ack_pending = 0;
+        ir_mac_stats.tx_acks++;
+        return;
+    }
+
+    switch (tx_state)
+    {
+    case IR_MAC_TX_WAIT_ACK:
+        if ((timer_tick_t)(now - tx_time) < IR_MAC_ACK_TIMEOUT_TICKS)
+            break;
+
+        if (++tx_retries > IR_MAC_RETRIES)
+        {
+            ir_mac_stats.failures++;
+            tx_state = IR_MAC_TX_IDLE;
+            break;
+        }
+        ir_mac_stats.retries++;
+        if (tx_cw < IR_MAC_CW_MAX)
+            tx_cw <<= 1;
+        ir_mac_backoff_start ();
+        break;
+
+    case IR_MAC_TX_BACKOFF:
+        if (ir_mac_busy_p (now))
+        {
+            /* Freeze the backoff until the link is idle again.  */
+            if (tx_counting)
+                ir_mac_stats.defers++;
+            tx_counting = 0;
+            break;
+        }
+
+        if (!tx_counting)
+        {
+            tx_counting = 1;
+            tx_time = now;
+        }
+        else if ((timer_tick_t)(now - tx_time) >= IR_MAC_SLOT_TICKS)
+        {
+            tx_time += IR_MAC_SLOT_TICKS;
+            if (tx_backoff)
+                tx_backoff--;
+        }
+
+        if (tx_backoff)
+            break;
+
+        ir_mac_frame_send (tx_seq, tx_dest, tx_data, tx_size);
+        ir_mac_stats.tx_frames++;
+        tx_state = IR_MAC_TX_SENDING;
+        chan_time = now;
+        break;
+
+    default:
+        break;
+    }
+}
+
+
+/** Return pointer to the link statistics.  */
+const ir_mac_stats_t *
+ir_mac_stats_get (void)
+{
+    return &ir_mac_stats;
+}
+
+
+/** Initialise IR MAC driver.  */
+void
+ir_mac_init (uint8_t address)
+{
+    uint8_t i;
+
+    ir_uart_init ();
+
+    mac_address = address;
+    tx_state = IR_MAC_TX_IDLE;
+    tx_seq = 0;
+    tx_frame_size = tx_frame_sent = 0;
+    ack_pending = 0;
+    rx_ready = 0;
+    for (i = 0; i < IR_MAC_NODES; i++)
+        rx_seq[i] = IR_MAC_SEQ_NONE;
+    parse_state = IR_MAC_STATE_HUNT;
+
+    /* Each node needs a different sequence of backoffs.  The seed
+       must not be zero.  */
+    mac_random = (address + 1) * 0x9e37 ^ timer_get ();
+    if (!mac_random)
+        mac_random = 1;
+
+    chan_time = timer_get ();
+
+    system_stats_register ("ir_mac", ir_mac_stats_names,
+                           (const uint16_t *)&ir_mac_stats,
+                           ARRAY_SIZE (ir_mac_stats_names));
+}
@@ -0,0 +1,192 @@
+/** @file   ir_mac.h
+    @author agent
+    @date   19 October 2026
+    @brief  Multi-node medium access control over the IR UART.
+
+    @defgroup ir_mac IR medium access control driver
+
+    This module lets more than two boards share the IR link.  Each
+    board has a node address from 0 to IR_MAC_NODES - 1 and a frame is
+    sent either to a single node (unicast) or to every node
+    (IR_MAC_BROADCAST).
+
+    A frame has the format:
+
+      SOF  LEN  CTRL  DST  SRC  DATA[LEN]  CRC
+
+    where SOF is the start of frame marker (0x7e), LEN is the number
+    of data bytes, DST and SRC are the destination and source
+    addresses, and CRC is a CRC-8 of the bytes from LEN to the end of
+    the data.  The CTRL byte is:
+
+      bit 7     acknowledgement flag
+      bits 3-0  sequence number
+
+    Since the IR link is half-duplex a transmitter cannot detect a
+    collision so carrier sense multiple access with collision
+    avoidance is used.  A node only transmits after the link has been
+    idle for IR_MAC_IFS_SLOTS slots followed by a random number of
+    further slots (the backoff).  The backoff count is frozen while
+    another node is transmitting.  The link is sensed by the arrival
+    of characters and a character is only seen once it has been
+    completely received so a slot is two character times.  Thus nodes
+    only collide if they pick the same backoff.
+
+    A unicast frame is acknowledged by the destination straight away,
+    without a backoff.  If the acknowledgement does not arrive the
+    frame is resent after a backoff chosen from a range that doubles
+    with each attempt, up to IR_MAC_RETRIES times.  Duplicates caused
+    by lost acknowledgements are discarded by the receiver.  Broadcast
+    frames are not acknowledged.  A frame longer than the UART transmit
+    buffer is written over several calls to ir_mac_update, so this must
+    be called at least every few character times while sending.
+
+    Here's a simple application that broadcasts a message when the
+    navswitch is pushed and displays the address of the sender of any
+    message received.
+
+       @code
+       #include "ir_mac.h"
+       #include "navswitch.h"
+       #include "pacer.h"
+
+       void main (void)
+       {
+           uint8_t msg[3] = {1, 2, 3};
+
+           system_init ();
+           navswitch_init ();
+           ir_mac_init (MY_ADDRESS);
+           pacer_init (500);
+
+           while (1)
+           {
+               uint8_t buffer[IR_MAC_PAYLOAD_MAX];
+               uint8_t src;
+
+               pacer_wait ();
+               ir_mac_update ();
+               navswitch_update ();
+
+               if (navswitch_push_event_p (NAVSWITCH_PUSH))
+                   ir_mac_send (IR_MAC_BROADCAST, msg, sizeof (msg));
+
+               if (ir_mac_recv (&src, buffer, sizeof (buffer)))
+               {
+                   // Process the message from node src.
+               }
+           }
+       }
+       @endcode
+*/
+
+#ifndef IR_MAC_H
+#define IR_MAC_H
+
+#include "system.h"
+
+
+/** Maximum number of data bytes in a frame.  */
+#ifndef IR_MAC_PAYLOAD_MAX
+#define IR_MAC_PAYLOAD_MAX 8
+#endif
+
+
+/** Number of node addresses.  */
+#ifndef IR_MAC_NODES
+#define IR_MAC_NODES 8
+#endif
+
+
+/** Number of idle slots before the backoff starts.  This needs to
+    be longer than it takes to start sending an acknowledgement.  */
+#ifndef IR_MAC_IFS_SLOTS
+#define IR_MAC_IFS_SLOTS 1
+#endif
+
+
+/** Initial and maximum backoff range in slots; these must be powers
+    of 2.  */
+#ifndef IR_MAC_CW_MIN
+#define IR_MAC_CW_MIN 8
+#endif
+
+#ifndef IR_MAC_CW_MAX
+#define IR_MAC_CW_MAX 64
+#endif
+
+
+/** Maximum number of retransmissions of a unicast frame.  */
+#ifndef IR_MAC_RETRIES
+#define IR_MAC_RETRIES 6
+#endif
+
+
+/** Destination address of a frame for all nodes.  */
+#define IR_MAC_BROADCAST 0xff
+
+
+/** Link statistics.  The counters wrap at 65536.  */
+typedef struct ir_mac_stats_struct
+{
+    /** Data frames sent, including retransmissions.  */
+    uint16_t tx_frames;
+    /** Unicast frames that were acknowledged.  */
+    uint16_t tx_acked;
+    /** Unicast frames retransmitted.  */
+    uint16_t retries;
+    /** Unicast frames given up on after IR_MAC_RETRIES.  */
+    uint16_t failures;
+    /** Acknowledgements sent.  */
+    uint16_t tx_acks;
+    /** Frames delivered to ir_mac_recv.  */
+    uint16_t rx_frames;
+    /** Frames received with an invalid CRC.  */
+    uint16_t crc_errors;
+    /** Duplicate unicast frames discarded.  */
+    uint16_t duplicates;
+    /** Frames discarded since the previous frame had not been read.  */
+    uint16_t rx_drops;
+    /** Times the backoff was frozen since the link was busy.  */
+    uint16_t defers;
+} ir_mac_stats_t;
+
+
+/** Return non-zero if a frame can be queued for sending.  */
+bool ir_mac_send_ready_p (void);
+
+
+/** Queue a frame for sending.
+    @param dest node address or IR_MAC_BROADCAST
+    @param data pointer to data to send
+    @param size number of bytes of data (at most IR_MAC_PAYLOAD_MAX)
+    @return non-zero if the frame was queued or zero if the previous
+    frame is still being sent, the frame is too large, or the address
+    is invalid.  */
+bool ir_mac_send (uint8_t dest, const void *data, uint8_t size);
+
+
+/** Read a received frame.
+    @param psrc pointer to store the address of the sender
+    @param data pointer to buffer to store data
+    @param size size of buffer
+    @return number of bytes in frame or zero if no frame received.
+    If the buffer is too small the frame is truncated.  */
+uint8_t ir_mac_recv (uint8_t *psrc, void *data, uint8_t size);
+
+
+/** Return pointer to the link statistics.  */
+const ir_mac_stats_t *ir_mac_stats_get (void);
+
+
+/** Process received characters, send acknowledgements, and send or
+    resend frames.  This must be called at least once every character
+    time, say 500 times a second.  It does not block.  */
+void ir_mac_update (void);
+
+
+/** Initialise IR MAC driver.  This initialises the IR UART.
+    @param address node address from 0 to IR_MAC_NODES - 1.  */
+void ir_mac_init (uint8_t address);
+
+#endif
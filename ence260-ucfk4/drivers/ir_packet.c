@@ -0,0 +1,574 @@
+/** @file   ir_packet.c
+    @author agent
+    @date   19 October 2026
+    @brief  Reliable packet layer over the IR UART.
+
+    @note This uses go-back-N retransmission with a cumulative
+    acknowledgement piggybacked on every frame.  Sequence numbers are
+    kept as free-running 8-bit counters and only the bottom three bits
+    are sent.  The sender starts each run of sequence numbers with a
+    SYN frame and only sends data when the receiver has answered it,
+    so a board that is reset does not have its packets taken for
+    duplicates.
+*/
+#include "ir_packet.h"
+#include "ir_uart.h"
+#include "timer.h"
+#include "crc8.h"
+
+
+#if IR_PACKET_WINDOW != 2 && IR_PACKET_WINDOW != 4
+#error IR_PACKET_WINDOW must be 2 or 4
+#endif
+
+#if IR_PACKET_PAYLOAD_MAX > 32
+#error IR_PACKET_PAYLOAD_MAX too large
+#endif
+
+
+#define IR_PACKET_SOF 0x7e
+
+#define IR_PACKET_CTRL_DATA 0x80
+#define IR_PACKET_CTRL_SEQ_SHIFT 4
+#define IR_PACKET_CTRL_TYPE_SHIFT 4
+#define IR_PACKET_CTRL_RST 0x08
+#define IR_PACKET_SEQ_MASK 0x07
+
+/* Frame types, in place of the sequence number, when the data flag is
+   clear.  */
+enum {IR_PACKET_TYPE_ACK, IR_PACKET_TYPE_SYN, IR_PACKET_TYPE_START,
+      IR_PACKET_TYPE_SYNACK};
+
+/* SOF, LEN, CTRL, and CRC.  */
+#define IR_PACKET_OVERHEAD 4
+
+#define IR_PACKET_TIMEOUT_TICKS ((timer_tick_t)(IR_PACKET_TIMEOUT * TIMER_RATE))
+
+/* Up to this much is added to the timeout at random so that the two
+   boards do not keep retransmitting over each other.  */
+#define IR_PACKET_JITTER_TICKS (IR_PACKET_TIMEOUT_TICKS / 2)
+
+
+typedef enum {IR_PACKET_STATE_HUNT, IR_PACKET_STATE_LEN,
+              IR_PACKET_STATE_CTRL, IR_PACKET_STATE_DATA,
+              IR_PACKET_STATE_CRC} ir_packet_state_t;
+
+
+/* Transmit window.  Packets with sequence numbers from tx_base up to
+   (but not including) tx_next are unacknowledged; those from tx_send
+   have not been sent since the last timeout.  */
+static uint8_t tx_data[IR_PACKET_WINDOW][IR_PACKET_PAYLOAD_MAX];
+static uint8_t tx_size[IR_PACKET_WINDOW];
+static uint8_t tx_base;
+static uint8_t tx_next;
+static uint8_t tx_send;
+static uint8_t tx_retries;
+/* Non-zero until the receiver answers a SYN frame.  Until then no
+   data is sent and acknowledgements are ignored.  */
+static bool tx_resync;
+/* Non-zero until the first SYN after initialisation is answered.  */
+static bool tx_start;
+static bool tx_syn_sent;
+static uint8_t tx_bad_acks;
+static timer_tick_t tx_time;
+static timer_tick_t tx_timeout;
+static uint16_t seed;
+/* Time each packet was first sent and the number of times it has
+   been sent; the latter is used to time only packets that have not
+   been retransmitted.  */
+static timer_tick_t tx_first[IR_PACKET_WINDOW];
+static uint8_t tx_count[IR_PACKET_WINDOW];
+
+/* Receive state.  Only one packet is held; further data frames are
+   not acknowledged until it has been read.  */
+static uint8_t rx_data[IR_PACKET_PAYLOAD_MAX];
+static uint8_t rx_size;
+static bool rx_ready;
+static uint8_t rx_expected;
+/* Non-zero once a SYN frame has been received.  Until then frames are
+   sent with the RST flag so that the other board sends one.  */
+static bool rx_synced;
+static bool ack_pending;
+static bool synack_pending;
+static uint8_t synack_seq;
+
+/* Frame being sent.  The UART transmit buffer may be smaller than a
+   frame so the rest is written on later updates.  */
+static uint8_t tx_frame[IR_PACKET_PAYLOAD_MAX + IR_PACKET_OVERHEAD];
+static uint8_t tx_frame_size;
+static uint8_t tx_frame_sent;
+
+/* Frame parser state.  */
+static ir_packet_state_t parse_state;
+static uint8_t parse_buffer[IR_PACKET_PAYLOAD_MAX];
+static uint8_t parse_size;
+static uint8_t parse_ctrl;
+static uint8_t parse_index;
+static uint8_t parse_crc;
+
+static ir_packet_stats_t ir_packet_stats;
+
+static const char * const ir_packet_stats_names[] =
+{
+    "tx_packets", "tx_frames", "retransmits", "discards",
+    "rx_packets", "rx_frames", "crc_errors", "duplicates", "resyncs",
+    "rtt_last", "rtt_min", "rtt_max", "rtt_mean"
+};
+
+
+/** Restart the retransmission timer with a random extra time.  */
+static void
+ir_packet_timer_start (void)
+{
+    seed = seed * 25173 + 13849;
+    tx_time = timer_get ();
+    tx_timeout = IR_PACKET_TIMEOUT_TICKS
+        + (seed >> 4) % (IR_PACKET_JITTER_TICKS + 1);
+}
+
+
+/** Start a new run of sequence numbers with a SYN frame.  */
+static void
+ir_packet_resync (void)
+{
+    if (tx_resync)
+        return;
+    ir_packet_stats.resyncs++;
+    tx_resync = 1;
+    tx_syn_sent = 0;
+    tx_send = tx_base;
+}
+
+
+/** Return non-zero if a packet can be queued for sending.  */
+bool
+ir_packet_send_ready_p (void)
+{
+    return (uint8_t)(tx_next - tx_base) < IR_PACKET_WINDOW;
+}
+
+
+/** Queue a packet for sending.  */
+bool
+ir_packet_send (const void *data, uint8_t size)
+{
+    const uint8_t *src = data;
+    uint8_t slot;
+    uint8_t i;
+
+    if (!size || size > IR_PACKET_PAYLOAD_MAX || !ir_packet_send_ready_p ())
+        return 0;
+
+    slot = tx_next & (IR_PACKET_WINDOW - 1);
+    for (i = 0; i < size; i++)
+        tx_data[slot][i] = src[i];
+    tx_size[slot] = size;
+    tx_count[slot] = 0;
+
+    if (tx_next == tx_base)
+    {
+        tx_retries = 0;
+        ir_packet_timer_start ();
+    }
+    tx_next++;
+    ir_packet_stats.tx_packets++;
+    return 1;
+}
+
+
+/** Return non-zero if all queued packets have been acknowledged
+    or discarded.  */
+bool
+ir_packet_send_finished_p (void)
+{
+    return tx_next == tx_base;
+}
+
+
+/** Read a received packet.  */
+uint8_t
+ir_packet_recv (void *data, uint8_t size)
+{
+    uint8_t *dst = data;
+    uint8_t i;
+
+    if (!rx_ready)
+        return 0;
+
+    if (size > rx_size)
+        size = rx_size;
+    for (i = 0; i < size; i++)
+        dst[i] = rx_data[i];
+
+    rx_ready = 0;
+    return rx_size;
+}
+
+
+/** Update the round-trip time statistics when a packet is
+    acknowledged.  */
+static void
+ir_packet_rtt_update (uint8_t seq)
+{
+    uint8_t slot;
+    timer_tick_t rtt;
+
+    /* If the packet was retransmitted the acknowledgement may be for
+       any of the transmissions.  */
+    slot = seq & (IR_PACKET_WINDOW - 1);
+    if (tx_count[slot] != 1)
+        return;
+
+    rtt = timer_get () - tx_first[slot];
+
+    if (!ir_packet_stats.rtt_min)
+    {
+        ir_packet_stats.rtt_min = rtt;
+        ir_packet_stats.rtt_mean = rtt;
+    }
+    if (rtt < ir_packet_stats.rtt_min)
+        ir_packet_stats.rtt_min = rtt;
+    if (rtt > ir_packet_stats.rtt_max)
+        ir_packet_stats.rtt_max = rtt;
+    ir_packet_stats.rtt_last = rtt;
+
+    /* Smooth with a gain of 1/8 like TCP.  */
+    ir_packet_stats.rtt_mean
+        += (int16_t)(rtt - ir_packet_stats.rtt_mean) / 8;
+}
+
+
+/** Handle the acknowledgement field of a valid frame.  */
+static void
+ir_packet_ack_process (uint8_t ack)
+{
+    uint8_t acked;
+    uint8_t outstanding;
+
+    outstanding = tx_next - tx_base;
+    acked = (ack - tx_base) & IR_PACKET_SEQ_MASK;
+
+    if (acked > outstanding)
+    {
+        /* The other end does not agree with our sequence numbers.
+           A corrupted frame can pass the CRC check so wait for a
+           second bad acknowledgement before resynchronising.  */
+        if (++tx_bad_acks >= 2)
+            ir_packet_resync ();
+        return;
+    }
+
+    tx_bad_acks = 0;
+    if (!acked)
+        return;
+
+    ir_packet_rtt_update (tx_base + acked - 1);
+
+    tx_base += acked;
+    tx_retries = 0;
+    ir_packet_timer_start ();
+
+    /* Guard against acknowledgement of packets not yet sent.  */
+    if ((uint8_t)(tx_send - tx_base) > (uint8_t)(tx_next - tx_base))
+        tx_send = tx_base;
+}
+
+
+/** Handle a SYN frame, which gives the sequence number of the next
+    data frame.  */
+static void
+ir_packet_syn_process (uint8_t type, uint8_t seq)
+{
+    uint8_t diff;
+
+    /* If the sender gave up on packets that we received (but whose
+       acknowledgements were lost) keep our place; the sender learns
+       from the acknowledgement that they arrived.  This does not
+       apply if the sender has just been reset.  */
+    diff = rx_expected - seq;
+    if (type == IR_PACKET_TYPE_START || !rx_synced || diff > IR_PACKET_WINDOW)
+        rx_expected = seq;
+    rx_synced = 1;
+
+    synack_seq = seq;
+    synack_pending = 1;
+}
+
+
+/** Handle a SYNACK frame, which answers our SYN frame.  */
+static void
+ir_packet_synack_process (uint8_t seq)
+{
+    if (!tx_resync || !tx_syn_sent || seq != tx_base)
+        return;
+
+    tx_resync = 0;
+    tx_start = 0;
+    tx_bad_acks = 0;
+    tx_retries = 0;
+    tx_send = tx_base;
+    ir_packet_timer_start ();
+}
+
+
+/** Handle a data frame.  */
+static void
+ir_packet_data_process (uint8_t ctrl)
+{
+    uint8_t seq;
+    uint8_t i;
+
+    seq = (ctrl >> IR_PACKET_CTRL_SEQ_SHIFT) & IR_PACKET_SEQ_MASK;
+
+    /* Always acknowledge so that the sender learns what we expect
+       even if this is a duplicate.  If we have not had a SYN frame the
+       acknowledgement has the RST flag set.  */
+    ack_pending = 1;
+    if (!rx_synced)
+        return;
+
+    if (seq != (rx_expected & IR_PACKET_SEQ_MASK))
+    {
+        ir_packet_stats.duplicates++;
+        return;
+    }
+    if (rx_ready)
+        return;
+
+    for (i = 0; i < parse_size; i++)
+        rx_data[i] = parse_buffer[i];
+    rx_size = parse_size;
+    rx_ready = 1;
+    rx_expected++;
+    ir_packet_stats.rx_packets++;
+}
+
+
+/** Feed a received character to the frame parser.  */
+static void
+ir_packet_parse (uint8_t ch)
+{
+    uint8_t type;
+
+    switch (parse_state)
+    {
+    case IR_PACKET_STATE_HUNT:
+        if (ch == IR_PACKET_SOF)
+            parse_state = IR_PACKET_STATE_LEN;
+        break;
+
+    case IR_PACKET_STATE_LEN:
+        if (ch > IR_PACKET_PAYLOAD_MAX)
+        {
+            /* This may be the start of a frame if the previous SOF
+               was noise.  */
+            parse_state = ch == IR_PACKET_SOF
+                ? IR_PACKET_STATE_LEN : IR_PACKET_STATE_HUNT;
+            break;
+        }
+        parse_size = ch;
+        parse_crc = crc8_update (CRC8_INIT, ch);
+        parse_state = IR_PACKET_STATE_CTRL;
+        break;
+
+    case IR_PACKET_STATE_CTRL:
+        parse_ctrl = ch;
+        parse_crc = crc8_update (parse_crc, ch);
+        parse_index = 0;
+        parse_state = parse_size
+            ? IR_PACKET_STATE_DATA : IR_PACKET_STATE_CRC;
+        break;
+
+    case IR_PACKET_STATE_DATA:
+        parse_buffer[parse_index++] = ch;
+        parse_crc = crc8_update (parse_crc, ch);
+        if (parse_index == parse_size)
+            parse_state = IR_PACKET_STATE_CRC;
+        break;
+
+    case IR_PACKET_STATE_CRC:
+        parse_state = IR_PACKET_STATE_HUNT;
+        if (ch != parse_crc)
+        {
+            ir_packet_stats.crc_errors++;
+            break;
+        }
+        ir_packet_stats.rx_frames++;
+
+        /* Boards reset together would otherwise time out together.  */
+        seed += parse_crc + timer_get ();
+
+        type = parse_ctrl >> IR_PACKET_CTRL_TYPE_SHIFT;
+        if (type == IR_PACKET_TYPE_SYNACK && parse_size == 1)
+            ir_packet_synack_process (parse_buffer[0]);
+
+        /* The acknowledgement is meaningless if the other board has not
+           had a SYN frame from us, for example if it has been reset.  */
+        if (parse_ctrl & IR_PACKET_CTRL_RST)
+            ir_packet_resync ();
+        else if (!tx_resync)
+            ir_packet_ack_process (parse_ctrl & IR_PACKET_SEQ_MASK);
+
+        if ((parse_ctrl & IR_PACKET_CTRL_DATA) && parse_size)
+            ir_packet_data_process (parse_ctrl);
+        else if ((type == IR_PACKET_TYPE_SYN || type == IR_PACKET_TYPE_START)
+                 && parse_size == 1)
+            ir_packet_syn_process (type, parse_buffer[0]);
+        break;
+    }
+}
+
+
+/** Write as much of the current frame as the UART will take.
+    @return non-zero if the whole frame has been written.  */
+static bool
+ir_packet_frame_flush (void)
+{
+    if (tx_frame_sent == tx_frame_size)
+        return 1;
+
+    tx_frame_sent += ir_uart_write (&tx_frame[tx_frame_sent],
+                                    tx_frame_size - tx_frame_sent);
+    if (tx_frame_sent != tx_frame_size)
+        return 0;
+
+    ir_packet_stats.tx_frames++;
+    return 1;
+}
+
+
+/** Build and start sending a frame.  This should only be called when
+    the previous frame has been written and the transmitter is
+    idle.  */
+static void
+ir_packet_frame_send (uint8_t ctrl, const uint8_t *data, uint8_t size)
+{
+    uint8_t i;
+
+    ctrl |= rx_synced ? rx_expected & IR_PACKET_SEQ_MASK : IR_PACKET_CTRL_RST;
+
+    tx_frame[0] = IR_PACKET_SOF;
+    tx_frame[1] = size;
+    tx_frame[2] = ctrl;
+    for (i = 0; i < size; i++)
+        tx_frame[3 + i] = data[i];
+    tx_frame[3 + size] = crc8 (CRC8_INIT, &tx_frame[1], size + 2);
+
+    tx_frame_size = size + IR_PACKET_OVERHEAD;
+    tx_frame_sent = 0;
+    ack_pending = 0;
+    ir_packet_frame_flush ();
+}
+
+
+/** Process received characters, send acknowledgements, and retransmit
+    packets.  */
+void
+ir_packet_update (void)
+{
+    uint8_t ch;
+    uint8_t slot;
+    uint8_t type;
+
+    while (ir_uart_read (&ch, 1))
+        ir_packet_parse (ch);
+
+    /* Wait for the current frame to be sent; this keeps the link
+       half-duplex and prevents frames being interleaved.  */
+    if (!ir_packet_frame_flush () || !ir_uart_write_finished_p ())
+        return;
+
+    if (tx_base != tx_next && (tx_send != tx_base || tx_syn_sent)
+        && (timer_tick_t)(timer_get () - tx_time) >= tx_timeout)
+    {
+        if (++tx_retries > IR_PACKET_RETRIES)
+        {
+            /* Give up on the oldest packet.  The receiver may still
+               be expecting it so resynchronise.  */
+            tx_base++;
+            tx_retries = 0;
+            ir_packet_stats.discards++;
+            ir_packet_resync ();
+        }
+        /* Go back N.  */
+        tx_send = tx_base;
+        tx_syn_sent = 0;
+        ir_packet_timer_start ();
+    }
+
+    if (synack_pending)
+    {
+        synack_pending = 0;
+        ir_packet_frame_send (IR_PACKET_TYPE_SYNACK
+                              << IR_PACKET_CTRL_TYPE_SHIFT, &synack_seq, 1);
+    }
+    else if (tx_resync)
+    {
+        if (tx_base != tx_next && !tx_syn_sent)
+        {
+            type = tx_start ? IR_PACKET_TYPE_START : IR_PACKET_TYPE_SYN;
+            ir_packet_frame_send (type << IR_PACKET_CTRL_TYPE_SHIFT,
+                                  &tx_base, 1);
+            tx_syn_sent = 1;
+            ir_packet_timer_start ();
+        }
+        else if (ack_pending)
+            ir_packet_frame_send (0, 0, 0);
+    }
+    else if (tx_send != tx_next)
+    {
+        slot = tx_send & (IR_PACKET_WINDOW - 1);
+        if (tx_count[slot]++)
+            ir_packet_stats.retransmits++;
+        else
+            tx_first[slot] = timer_get ();
+        ir_packet_frame_send (IR_PACKET_CTRL_DATA
+                              | ((tx_send & IR_PACKET_SEQ_MASK)
+                                 << IR_PACKET_CTRL_SEQ_SHIFT),
+                              tx_data[slot], tx_size[slot]);
+        tx_send++;
+        ir_packet_timer_start ();
+    }
+    else if (ack_pending)
+    {
+        ir_packet_frame_send (0, 0, 0);
+    }
+}
+
+
+/** Return pointer to the link statistics.  */
+const ir_packet_stats_t *
+ir_packet_stats_get (void)
+{
+    return &ir_packet_stats;
+}
+
+
+/** Initialise IR packet driver.  */
+void
+ir_packet_init (void)
+{
+    tx_base = tx_next = tx_send = 0;
+    tx_retries = 0;
+    tx_resync = 1;
+    tx_start = 1;
+    tx_syn_sent = 0;
+    tx_bad_acks = 0;
+    seed = timer_get ();
+
+    rx_ready = 0;
+    rx_expected = 0;
+    rx_synced = 0;
+    ack_pending = 0;
+    synack_pending = 0;
+
+    tx_frame_size = tx_frame_sent = 0;
+
+    parse_state = IR_PACKET_STATE_HUNT;
+
+    ir_uart_init ();
+
+    system_stats_register ("ir_packet", ir_packet_stats_names,
+                           (const uint16_t *)&ir_packet_stats,
+                           ARRAY_SIZE (ir_packet_stats_names));
+}
@@ -0,0 +1,198 @@
+/** @file   ir_packet.h
+    @author agent
+    @date   19 October 2026
+    @brief  Reliable packet layer over the IR UART.
+
+    @defgroup ir_packet Reliable IR packet driver
+
+    This module sends and receives short packets over the IR UART.
+    Each packet is framed, checked with a CRC, sequence numbered, and
+    acknowledged.  Lost or corrupted packets are retransmitted a
+    bounded number of times and are delivered in order without
+    duplicates.
+
+    A frame has the format:
+
+      SOF  LEN  CTRL  DATA[LEN]  CRC
+
+    where SOF is the start of frame marker (0x7e), LEN is the number of
+    data bytes, CTRL holds the sequence and acknowledgement numbers, and
+    CRC is a CRC-8 of the LEN, CTRL, and DATA bytes.
+
+    The CTRL byte is:
+
+      bit 7     data flag (clear for a control frame)
+      bits 6-4  sequence number of a data frame or type of control frame
+      bit 3     reset flag; set if bits 2-0 are not valid
+      bits 2-0  cumulative acknowledgement (next sequence number expected)
+
+    The control frames are an acknowledgement only frame, which has no
+    data, and SYN, START, and SYNACK, which have one data byte.  Before
+    sending data, and again if it has to give up on a packet, the
+    sender sends a SYN frame holding the full sequence number of its
+    next data frame; after it has been reset this is a START frame.
+    The receiver takes this as the next sequence number expected and
+    answers with a SYNACK frame holding the same number.  Until it has
+    had a SYN or START frame the receiver accepts no data and sets the
+    reset flag in every frame it sends, which makes the sender send a
+    SYN frame.  Thus neither board loses packets when the other is
+    reset.  The retransmission timeout is lengthened by a random amount,
+    up to a half, each time so that the boards do not keep sending at
+    the same time.
+
+    At 2400 baud each byte takes 4.17 ms so a full frame with
+    IR_PACKET_PAYLOAD_MAX bytes of data takes 50 ms and an
+    acknowledgement frame takes 17 ms.  Thus the payload is kept short
+    and only a small window of unacknowledged packets is allowed.
+
+    A frame is only started when the IR transmitter is idle so the
+    link is used half-duplex.  A frame longer than the UART transmit
+    buffer is written over several calls to ir_packet_update.
+
+    The driver counts the packets and frames sent and received, CRC
+    failures, retransmissions, and so on, and measures the round-trip
+    time from sending a packet to its acknowledgement; see
+    ir_packet_stats_get.  Following Karn's algorithm, only packets
+    acknowledged without being retransmitted are timed.  On the test
+    scaffold the statistics are printed when the program exits.
+
+    Here's a simple application that sends a three byte message when
+    the navswitch is pushed and displays the first byte of any
+    message received.
+
+       @code
+       #include "ir_packet.h"
+       #include "navswitch.h"
+       #include "pacer.h"
+
+       void main (void)
+       {
+           uint8_t msg[3] = {1, 2, 3};
+
+           system_init ();
+           navswitch_init ();
+           ir_packet_init ();
+           pacer_init (500);
+
+           while (1)
+           {
+               uint8_t buffer[IR_PACKET_PAYLOAD_MAX];
+
+               pacer_wait ();
+               ir_packet_update ();
+               navswitch_update ();
+
+               if (navswitch_push_event_p (NAVSWITCH_PUSH))
+                   ir_packet_send (msg, sizeof (msg));
+
+               if (ir_packet_recv (buffer, sizeof (buffer)))
+               {
+                   // Process the received message.
+               }
+           }
+       }
+       @endcode
+*/
+
+#ifndef IR_PACKET_H
+#define IR_PACKET_H
+
+#include "system.h"
+
+
+/** Maximum number of data bytes in a packet.  */
+#ifndef IR_PACKET_PAYLOAD_MAX
+#define IR_PACKET_PAYLOAD_MAX 8
+#endif
+
+
+/** Maximum number of unacknowledged packets; this must be 2 or 4.  */
+#ifndef IR_PACKET_WINDOW
+#define IR_PACKET_WINDOW 2
+#endif
+
+
+/** How long to wait for an acknowledgement before retransmitting (s).
+    This needs to allow for a full frame in each direction.  */
+#ifndef IR_PACKET_TIMEOUT
+#define IR_PACKET_TIMEOUT 0.15
+#endif
+
+
+/** Maximum number of retransmissions before a packet is discarded.  */
+#ifndef IR_PACKET_RETRIES
+#define IR_PACKET_RETRIES 5
+#endif
+
+
+/** Link statistics.  The counters wrap at 65536.  */
+typedef struct ir_packet_stats_struct
+{
+    /** Packets queued by ir_packet_send.  */
+    uint16_t tx_packets;
+    /** Frames sent, including acknowledgement only frames.  */
+    uint16_t tx_frames;
+    /** Data frames sent more than once.  */
+    uint16_t retransmits;
+    /** Packets given up on after IR_PACKET_RETRIES retransmissions.  */
+    uint16_t discards;
+    /** Packets delivered to ir_packet_recv.  */
+    uint16_t rx_packets;
+    /** Frames received with a valid CRC.  */
+    uint16_t rx_frames;
+    /** Frames received with an invalid CRC.  */
+    uint16_t crc_errors;
+    /** Data frames received out of sequence, usually duplicates.  */
+    uint16_t duplicates;
+    /** Times the sequence numbers were resynchronised.  */
+    uint16_t resyncs;
+    /** Last round-trip time in timer ticks.  */
+    uint16_t rtt_last;
+    /** Minimum round-trip time in timer ticks.  */
+    uint16_t rtt_min;
+    /** Maximum round-trip time in timer ticks.  */
+    uint16_t rtt_max;
+    /** Smoothed round-trip time in timer ticks.  */
+    uint16_t rtt_mean;
+} ir_packet_stats_t;
+
+
+/** Return non-zero if a packet can be queued for sending.  */
+bool ir_packet_send_ready_p (void);
+
+
+/** Queue a packet for sending.
+    @param data pointer to data to send
+    @param size number of bytes of data (at most IR_PACKET_PAYLOAD_MAX)
+    @return non-zero if the packet was queued or zero if the window
+    is full or the packet is too large.  */
+bool ir_packet_send (const void *data, uint8_t size);
+
+
+/** Return non-zero if all queued packets have been acknowledged
+    or discarded.  */
+bool ir_packet_send_finished_p (void);
+
+
+/** Read a received packet.
+    @param data pointer to buffer to store data
+    @param size size of buffer
+    @return number of bytes in packet or zero if no packet received.
+    If the buffer is too small the packet is truncated.  */
+uint8_t ir_packet_recv (void *data, uint8_t size);
+
+
+/** Process received characters, send acknowledgements, and retransmit
+    packets.  This must be called frequently, say at least 100 times a
+    second.  It does not block.  */
+void ir_packet_update (void);
+
+
+/** Return pointer to the link statistics.  */
+const ir_packet_stats_t *ir_packet_stats_get (void);
+
+
+/** Initialise IR packet driver.  This initialises the IR UART.  */
+void ir_packet_init (void);
+
+#endif
@@ -0,0 +1,229 @@
+/** @file   ir_rc5_rx.c
+    @author M. P. Hayes, UCECE
+    @date   21 May 2013
+    @brief  Infrared serial receiver driver for Phillips RC5 protocol.
+*/
+
+/* The Phillips RC-5 protocol uses the following format of 14 bits:
+   1 start bit
+   1 field bit (this used to be a second start bit)
+   1 toggle bit
+   5 address bits
+   6 command bits
+
+   Manchester encoding is used for the bits.  The start bit is a `1' bits.
+   `1' bits have the IR modulation on for the second half of the cycle.
+   `0' bits have the IR modulation on for the first half of the cycle.
+
+   Each bit period is 1778 microseconds (64 cycles of 36 kHz modulation)
+   thus a frame is 24.9 ms.
+
+   While a button is pressed, a frame is repeatedly sent.  If the button
+   is repressed, the toggle bit is changed.
+
+   The decoder is driven by the time between edges.  This is either
+   one half bit period (short) or a whole bit period (long).  There is
+   always an edge in the middle of each bit so the decoder tracks
+   whether it is at the middle or at the start of a bit and the
+   polarity of the bit:
+
+   state    short mark     long mark      short space    long space
+   START1                                 MID1, emit 1
+   MID1     START1         MID0, emit 0
+   START0   MID0, emit 0
+   MID0                                   START0         MID1, emit 1
+
+   Any other combination is an error.  The first edge of a frame is
+   the start of the modulation in the middle of the start bit.
+*/
+
+
+#include "ir_rc5_rx.h"
+#include "ir_capture.h"
+#include "timer.h"
+
+#define IR_RC5_BIT_PERIOD_US 1778
+
+#define IR_RC5_RX_BITS 14
+
+#define IR_RC5_RX_HALF_TICKS (IR_RC5_BIT_PERIOD_US * 0.5e-6 * TIMER_RATE)
+
+/* Pulse width thresholds in timer ticks.  */
+#define IR_RC5_RX_SHORT_TICKS_MIN ((timer_tick_t)(0.5 * IR_RC5_RX_HALF_TICKS))
+#define IR_RC5_RX_SHORT_TICKS_MAX ((timer_tick_t)(1.5 * IR_RC5_RX_HALF_TICKS))
+#define IR_RC5_RX_LONG_TICKS_MAX ((timer_tick_t)(2.5 * IR_RC5_RX_HALF_TICKS))
+
+#ifndef IR_RC5_RX_QUEUE_SIZE
+#define IR_RC5_RX_QUEUE_SIZE 4
+#endif
+
+#if (IR_RC5_RX_QUEUE_SIZE & (IR_RC5_RX_QUEUE_SIZE - 1)) != 0
+#error IR_RC5_RX_QUEUE_SIZE must be a power of 2
+#endif
+
+
+typedef enum {IR_RC5_RX_IDLE, IR_RC5_RX_START1, IR_RC5_RX_MID1,
+              IR_RC5_RX_START0, IR_RC5_RX_MID0} ir_rc5_rx_state_t;
+
+
+/* The decoder state is only used by the edge handler.  */
+static ir_rc5_rx_state_t rx_state;
+static timer_tick_t rx_edge_time;
+static uint8_t rx_bits;
+static uint16_t rx_data;
+
+/* Queue of received codes; the head is written by the edge handler
+   and the tail by ir_rc5_rx_read.  */
+static volatile int16_t rx_queue[IR_RC5_RX_QUEUE_SIZE];
+static volatile uint8_t rx_queue_head;
+static volatile uint8_t rx_queue_tail;
+
+
+static void
+ir_rc5_rx_put (int16_t code)
+{
+    /* Drop the code if the queue is full.  */
+    if ((uint8_t)(rx_queue_head - rx_queue_tail) >= IR_RC5_RX_QUEUE_SIZE)
+        return;
+
+    rx_queue[rx_queue_head & (IR_RC5_RX_QUEUE_SIZE - 1)] = code;
+    rx_queue_head++;
+}
+
+
+/** Add a decoded bit to the frame.  */
+static void
+ir_rc5_rx_bit (uint8_t bit)
+{
+    rx_data = (rx_data << 1) | bit;
+    if (++rx_bits == IR_RC5_RX_BITS)
+    {
+        ir_rc5_rx_put (rx_data);
+        rx_state = IR_RC5_RX_IDLE;
+    }
+}
+
+
+/** Decode an edge from the IR receiver.  This is called from the
+    edge capture interrupt.
+    @param state 1 at the start of modulation, 0 at the end
+    @param when time of edge.  */
+static void
+ir_rc5_rx_edge (uint8_t state, timer_tick_t when)
+{
+    timer_tick_t width;
+    bool is_long;
+
+    width = when - rx_edge_time;
+    rx_edge_time = when;
+
+    if (rx_state != IR_RC5_RX_IDLE)
+    {
+        /* The interval that has just finished was a mark if the
+           modulation is now stopping.  */
+        if (width < IR_RC5_RX_SHORT_TICKS_MIN
+            || width >= IR_RC5_RX_LONG_TICKS_MAX)
+            goto error;
+
+        is_long = width >= IR_RC5_RX_SHORT_TICKS_MAX;
+
+        switch (rx_state)
+        {
+        case IR_RC5_RX_START1:
+            if (!state || is_long)
+                goto error;
+            rx_state = IR_RC5_RX_MID1;
+            ir_rc5_rx_bit (1);
+            return;
+
+        case IR_RC5_RX_MID1:
+            if (state)
+                goto error;
+            if (!is_long)
+            {
+                rx_state = IR_RC5_RX_START1;
+                return;
+            }
+            rx_state = IR_RC5_RX_MID0;
+            ir_rc5_rx_bit (0);
+            return;
+
+        case IR_RC5_RX_START0:
+            if (state || is_long)
+                goto error;
+            rx_state = IR_RC5_RX_MID0;
+            ir_rc5_rx_bit (0);
+            return;
+
+        case IR_RC5_RX_MID0:
+            if (!state)
+                goto error;
+            if (!is_long)
+            {
+                rx_state = IR_RC5_RX_START0;
+                return;
+            }
+            rx_state = IR_RC5_RX_MID1;
+            ir_rc5_rx_bit (1);
+            return;
+
+        default:
+            break;
+        }
+
+    error:
+        /* Do not report a glitch that looked like a start bit.  */
+        if (rx_bits > 1)
+            ir_rc5_rx_put (IR_RC5_RX_ERROR);
+        rx_state = IR_RC5_RX_IDLE;
+    }
+
+    /* The start of modulation while idle is the middle of the start
+       bit.  This may be a new frame after an error.  */
+    if (state)
+    {
+        rx_bits = 0;
+        rx_data = 0;
+        rx_state = IR_RC5_RX_MID1;
+        ir_rc5_rx_bit (1);
+    }
+}
+
+
+/** Return non-zero if a code or error is ready to be read.  */
+bool
+ir_rc5_rx_ready_p (void)
+{
+    return rx_queue_head != rx_queue_tail;
+}
+
+
+/** Receive RC5 data packet over IR serial link.
+    @return 14-bits of data or error status code
+    @note This does not block.  The frames are decoded by an interrupt
+    handler and are queued until read.  A valid code always has the
+    start bit (bit 13) set.  */
+int16_t
+ir_rc5_rx_read (void)
+{
+    int16_t code;
+
+    if (!ir_rc5_rx_ready_p ())
+        return IR_RC5_RX_NONE;
+
+    code = rx_queue[rx_queue_tail & (IR_RC5_RX_QUEUE_SIZE - 1)];
+    rx_queue_tail++;
+    return code;
+}
+
+
+/** Initialise IR serial receiver driver.  This initialises the
+    timer.  */
+void
+ir_rc5_rx_init (void)
+{
+    rx_state = IR_RC5_RX_IDLE;
+    rx_queue_head = rx_queue_tail = 0;
+
+    ir_capture_init (ir_rc5_rx_edge);
+}
@@ -0,0 +1,79 @@
+/** @file   ir_rc5_rx.h
+    @author M. P. Hayes, UCECE
+    @date   21 May 2013
+    @brief  Infrared serial receiver driver for Phillips RC5 protocol.
+
+    @defgroup ir_rc5_rx Infrared RC5 receiver driver
+
+    This module decodes the Phillips RC5 remote control protocol.  The
+    edges from the IR receiver are timestamped in an interrupt handler
+    (see @ref ir_capture) and the Manchester encoded bits are decoded
+    as they arrive.  Complete 14 bit codes are queued so
+    ir_rc5_rx_read never blocks and does not need to be called at any
+    particular time.
+
+    Note, this uses the same interrupt as the @ref IR_serial "IR
+    serial" driver so the two cannot be used together.
+
+    Here's a simple application that displays the command number
+    of each code received.
+
+       @code
+       #include "ir_rc5_rx.h"
+       #include "pacer.h"
+
+       void main (void)
+       {
+           system_init ();
+           ir_rc5_rx_init ();
+
+           pacer_init (100);
+
+           while (1)
+           {
+               int16_t code;
+
+               pacer_wait ();
+
+               code = ir_rc5_rx_read ();
+               if (code > 0)
+               {
+                   // Process the command, code & 0x3f.
+               }
+           }
+        }
+       @endcode
+*/
+
+#ifndef IR_RC5_RX_H
+#define IR_RC5_RX_H
+
+#include "system.h"
+
+/** Status return codes.  */
+typedef enum ir_rc5_rx_ret
+{
+    /** No data to read.  */
+    IR_RC5_RX_NONE = 0,
+    /** A frame was started but had an invalid transition.  */
+    IR_RC5_RX_ERROR = -1
+} ir_rc5_rx_ret_t;
+
+
+/** Return non-zero if a code or error is ready to be read.  */
+bool ir_rc5_rx_ready_p (void);
+
+
+/** Receive RC5 data packet over IR serial link.
+    @return 14-bits of data or error status code
+    @note This does not block.  The frames are decoded by an interrupt
+    handler and are queued until read.  A valid code always has the
+    start bit (bit 13) set.  */
+int16_t ir_rc5_rx_read (void);
+
+
+/** Initialise IR serial receiver driver.  This initialises the
+    timer.  */
+void ir_rc5_rx_init (void);
+
+#endif
@@ -0,0 +1,630 @@
+/** @file   ir_remote.c
+    @author agent
+    @date   19 October 2026
+    @brief  Infrared remote control protocol engine.
+
+    @note A protocol is described by a format.  Each part of a code is
+    a number of units of one level followed by a number of units of
+    the other.  Decoding reads the runs of a code a unit at a time so
+    that bi-phase bits, whose runs straddle the bit boundaries, are
+    handled the same way as pulse distance bits.  The space before and
+    after a code is treated as being infinitely long.
+*/
+#include "ir_remote.h"
+#include "ir_capture.h"
+#include "ir_carrier.h"
+
+
+#if IR_REMOTE_DURATIONS > 16
+#error IR_REMOTE_DURATIONS must be at most 16
+#endif
+
+#define IR_REMOTE_GAP_TICKS ((timer_tick_t)(IR_REMOTE_GAP * TIMER_RATE))
+
+/* Format flags.  */
+#define IR_REMOTE_MSB_FIRST 1
+/* A one bit starts with a space.  */
+#define IR_REMOTE_BIPHASE 2
+
+#define IR_REMOTE_MARK 1
+#define IR_REMOTE_SPACE 0
+
+/* Marks the leading or trailing space.  */
+#define IR_REMOTE_UNITS_INFINITE 0xff
+
+
+typedef struct ir_remote_format_struct
+{
+    /* Duration of a unit (us).  */
+    uint16_t unit_us;
+    /* Units of mark and space for the header (zero if none).  */
+    uint8_t header_mark;
+    uint8_t header_space;
+    /* Units of the first and second half of each bit.  The first half
+       of a zero is a mark.  */
+    uint8_t zero_first;
+    uint8_t zero_second;
+    uint8_t one_first;
+    uint8_t one_second;
+    /* Units of mark for the trailer (zero if none).  */
+    uint8_t trailer_mark;
+    uint8_t bits;
+    uint8_t flags;
+} ir_remote_format_t;
+
+
+/* This is indexed by protocol less one.  */
+static const ir_remote_format_t ir_remote_formats[] =
+{
+    /* NEC.  */
+    {563, 16, 8, 1, 1, 1, 3, 1, 32, 0},
+    /* NEC repeat.  */
+    {563, 16, 4, 0, 0, 0, 0, 1, 0, 0},
+    /* RC5.  */
+    {889, 0, 0, 1, 1, 1, 1, 0, 14, IR_REMOTE_MSB_FIRST | IR_REMOTE_BIPHASE},
+};
+
+
+/* State for reading a code a unit at a time.  */
+typedef struct ir_remote_reader_struct
+{
+    const ir_remote_code_t *code;
+    timer_tick_t unit;
+    uint8_t index;
+    uint8_t level;
+    uint8_t units;
+} ir_remote_reader_t;
+
+
+/* State for building a code.  */
+typedef struct ir_remote_writer_struct
+{
+    ir_remote_code_t *code;
+    timer_tick_t unit;
+    uint8_t level;
+    uint8_t units;
+    uint8_t distinct;
+    bool error;
+} ir_remote_writer_t;
+
+
+/* Capture buffer; this is filled by the edge handler.  Once a code is
+   complete the handler ignores edges until it has been read.  */
+static timer_tick_t rx_runs[IR_REMOTE_RUNS_MAX];
+static volatile uint8_t rx_count;
+static volatile bool rx_started;
+static volatile bool rx_complete;
+static volatile timer_tick_t rx_edge_time;
+/* Incremented after every update so that the main loop can detect
+   that it read rx_edge_time while the handler was running.  */
+static volatile uint8_t rx_seq;
+
+static ir_remote_code_t tx_code;
+static volatile bool tx_active;
+static uint8_t tx_index;
+
+
+static void
+ir_remote_run_set (ir_remote_code_t *code, uint8_t index, uint8_t value)
+{
+    uint8_t *p = &code->runs[index >> 1];
+
+    if (index & 1)
+        *p = (*p & 0x0f) | (value << 4);
+    else
+        *p = (*p & 0xf0) | value;
+}
+
+
+/** Return the duration of a run.
+    @param code pointer to code
+    @param index index of run; even runs are marks and odd runs are spaces
+    @return duration in timer ticks.  */
+timer_tick_t
+ir_remote_run_get (const ir_remote_code_t *code, uint8_t index)
+{
+    uint8_t value;
+
+    value = code->runs[index >> 1];
+    if (index & 1)
+        value >>= 4;
+    return code->durations[value & 0x0f];
+}
+
+
+/** Pack a train of run durations into a code.  Durations within 25
+    percent of each other are treated as the same.
+    @param code pointer to code to fill in
+    @param runs array of durations in timer ticks, starting with a mark
+    @param count number of durations
+    @return non-zero if successful or zero if there are too many runs
+    or too many distinct durations.  */
+bool
+ir_remote_pack (ir_remote_code_t *code, const timer_tick_t *runs,
+                uint8_t count)
+{
+    uint32_t sums[IR_REMOTE_DURATIONS];
+    uint8_t totals[IR_REMOTE_DURATIONS];
+    uint8_t distinct;
+    uint8_t i;
+    uint8_t j;
+
+    if (count > IR_REMOTE_RUNS_MAX)
+        return 0;
+
+    /* Each run is put in the first cluster that it is close to; the
+       clusters are then replaced by their means.  */
+    distinct = 0;
+    for (i = 0; i < count; i++)
+    {
+        timer_tick_t run = runs[i];
+
+        for (j = 0; j < distinct; j++)
+        {
+            timer_tick_t ref = code->durations[j];
+            timer_tick_t diff = run > ref ? run - ref : ref - run;
+
+            if (diff <= ref / 4)
+                break;
+        }
+        if (j == distinct)
+        {
+            if (distinct == IR_REMOTE_DURATIONS)
+                return 0;
+            code->durations[j] = run;
+            sums[j] = 0;
+            totals[j] = 0;
+            distinct++;
+        }
+        sums[j] += run;
+        totals[j]++;
+        ir_remote_run_set (code, i, j);
+    }
+
+    for (j = 0; j < distinct; j++)
+        code->durations[j] = (sums[j] + totals[j] / 2) / totals[j];
+
+    code->count = count;
+    return 1;
+}
+
+
+static void
+ir_remote_write_flush (ir_remote_writer_t *writer)
+{
+    ir_remote_code_t *code = writer->code;
+    timer_tick_t duration;
+    uint8_t j;
+
+    /* The leading space is not sent.  */
+    if (!writer->units || (writer->level == IR_REMOTE_SPACE && !code->count))
+        return;
+
+    if (code->count == IR_REMOTE_RUNS_MAX)
+    {
+        writer->error = 1;
+        return;
+    }
+
+    duration = writer->units * writer->unit;
+    for (j = 0; j < writer->distinct; j++)
+    {
+        if (code->durations[j] == duration)
+            break;
+    }
+    if (j == writer->distinct)
+    {
+        if (j == IR_REMOTE_DURATIONS)
+        {
+            writer->error = 1;
+            return;
+        }
+        code->durations[j] = duration;
+        writer->distinct++;
+    }
+    ir_remote_run_set (code, code->count, j);
+    code->count++;
+}
+
+
+static void
+ir_remote_write (ir_remote_writer_t *writer, uint8_t level, uint8_t units)
+{
+    if (!units)
+        return;
+
+    if (level != writer->level)
+    {
+        ir_remote_write_flush (writer);
+        writer->level = level;
+        writer->units = 0;
+    }
+    writer->units += units;
+}
+
+
+/** Encode a value using a known protocol.
+    @param code pointer to code to fill in
+    @param protocol protocol to use
+    @param value data bits, right justified
+    @return non-zero if successful.  */
+bool
+ir_remote_encode (ir_remote_code_t *code, ir_remote_protocol_t protocol,
+                  uint32_t value)
+{
+    const ir_remote_format_t *format;
+    ir_remote_writer_t writer;
+    uint8_t i;
+    bool bit;
+
+    if (protocol == IR_REMOTE_RAW || protocol >= IR_REMOTE_PROTOCOL_NUM)
+        return 0;
+    format = &ir_remote_formats[protocol - 1];
+
+    writer.code = code;
+    writer.unit = ((uint32_t)format->unit_us * TIMER_RATE + 500000) / 1000000;
+    writer.level = IR_REMOTE_SPACE;
+    writer.units = 0;
+    writer.distinct = 0;
+    writer.error = 0;
+    code->count = 0;
+
+    ir_remote_write (&writer, IR_REMOTE_MARK, format->header_mark);
+    ir_remote_write (&writer, IR_REMOTE_SPACE, format->header_space);
+
+    for (i = 0; i < format->bits; i++)
+    {
+        if (format->flags & IR_REMOTE_MSB_FIRST)
+            bit = (value >> (format->bits - 1 - i)) & 1;
+        else
+            bit = (value >> i) & 1;
+
+        if (!bit)
+        {
+            ir_remote_write (&writer, IR_REMOTE_MARK, format->zero_first);
+            ir_remote_write (&writer, IR_REMOTE_SPACE, format->zero_second);
+        }
+        else if (format->flags & IR_REMOTE_BIPHASE)
+        {
+            ir_remote_write (&writer, IR_REMOTE_SPACE, format->one_first);
+            ir_remote_write (&writer, IR_REMOTE_MARK, format->one_second);
+        }
+        else
+        {
+            ir_remote_write (&writer, IR_REMOTE_MARK, format->one_first);
+            ir_remote_write (&writer, IR_REMOTE_SPACE, format->one_second);
+        }
+    }
+
+    ir_remote_write (&writer, IR_REMOTE_MARK, format->trailer_mark);
+
+    /* The trailing space is not sent.  */
+    if (writer.level == IR_REMOTE_MARK)
+        ir_remote_write_flush (&writer);
+
+    return !writer.error;
+}
+
+
+/** Consume units of a level from a code.
+    @return non-zero if successful.  */
+static bool
+ir_remote_read (ir_remote_reader_t *reader, uint8_t level, uint8_t units)
+{
+    const ir_remote_code_t *code = reader->code;
+    timer_tick_t duration;
+    timer_tick_t error;
+    timer_tick_t count;
+
+    if (!units)
+        return 1;
+
+    /* The leading space ends at the first mark.  */
+    if (reader->units == IR_REMOTE_UNITS_INFINITE && reader->level != level
+        && reader->index < code->count)
+        reader->units = 0;
+
+    if (!reader->units)
+    {
+        if (reader->index == code->count)
+        {
+            /* Into the trailing space.  */
+            reader->level = IR_REMOTE_SPACE;
+            reader->units = IR_REMOTE_UNITS_INFINITE;
+        }
+        else
+        {
+            duration = ir_remote_run_get (code, reader->index);
+            count = (duration + reader->unit / 2) / reader->unit;
+            error = duration > count * reader->unit
+                ? duration - count * reader->unit
+                : count * reader->unit - duration;
+
+            /* Allow for the receiver stretching or shrinking the
+               marks by up to about a third of a unit.  */
+            if (!count || count >= IR_REMOTE_UNITS_INFINITE
+                || error > (3 + count) * reader->unit / 8)
+                return 0;
+
+            reader->level = (reader->index & 1)
+                ? IR_REMOTE_SPACE : IR_REMOTE_MARK;
+            reader->units = count;
+            reader->index++;
+        }
+    }
+
+    if (reader->level != level)
+        return 0;
+
+    if (reader->units == IR_REMOTE_UNITS_INFINITE)
+        return 1;
+
+    if (reader->units < units)
+        return 0;
+    reader->units -= units;
+    return 1;
+}
+
+
+/** Read a bit.
+    @return 0 or 1 for the bit or -1 if it does not match.  */
+static int8_t
+ir_remote_read_bit (ir_remote_reader_t *reader,
+                    const ir_remote_format_t *format)
+{
+    ir_remote_reader_t saved;
+    uint8_t one_level;
+    bool one_first;
+    uint8_t i;
+
+    one_level = (format->flags & IR_REMOTE_BIPHASE)
+        ? IR_REMOTE_SPACE : IR_REMOTE_MARK;
+
+    /* For pulse distance coding the two bit values differ only in
+       the length of the space.  Try the longer one first since the
+       shorter would match the start of it.  */
+    one_first = format->one_second >= format->zero_second;
+
+    saved = *reader;
+    for (i = 0; i < 2; i++)
+    {
+        if (one_first)
+        {
+            if (ir_remote_read (reader, one_level, format->one_first)
+                && ir_remote_read (reader, !one_level, format->one_second))
+                return 1;
+        }
+        else
+        {
+            if (ir_remote_read (reader, IR_REMOTE_MARK, format->zero_first)
+                && ir_remote_read (reader, IR_REMOTE_SPACE,
+                                   format->zero_second))
+                return 0;
+        }
+        *reader = saved;
+        one_first = !one_first;
+    }
+    return -1;
+}
+
+
+/** Try to decode a code using a format.
+    @return non-zero if successful.  */
+static bool
+ir_remote_decode_format (const ir_remote_code_t *code,
+                         const ir_remote_format_t *format, uint32_t *pvalue)
+{
+    ir_remote_reader_t reader;
+    uint32_t value;
+    int8_t bit;
+    uint8_t i;
+
+    reader.code = code;
+    reader.unit = ((uint32_t)format->unit_us * TIMER_RATE + 500000) / 1000000;
+    reader.index = 0;
+    reader.level = IR_REMOTE_SPACE;
+    reader.units = IR_REMOTE_UNITS_INFINITE;
+
+    if (!ir_remote_read (&reader, IR_REMOTE_MARK, format->header_mark)
+        || !ir_remote_read (&reader, IR_REMOTE_SPACE, format->header_space))
+        return 0;
+
+    value = 0;
+    for (i = 0; i < format->bits; i++)
+    {
+        bit = ir_remote_read_bit (&reader, format);
+        if (bit < 0)
+            return 0;
+
+        if (format->flags & IR_REMOTE_MSB_FIRST)
+            value = (value << 1) | bit;
+        else if (bit)
+            value |= (uint32_t)1 << i;
+    }
+
+    if (!ir_remote_read (&reader, IR_REMOTE_MARK, format->trailer_mark))
+        return 0;
+
+    /* All the runs must have been used.  */
+    if (reader.index != code->count
+        || (reader.units && reader.level == IR_REMOTE_MARK))
+        return 0;
+
+    *pvalue = value;
+    return 1;
+}
+
+
+/** Decode a code by trying each known protocol.
+    @param code pointer to code
+    @param pvalue pointer to store data bits, right justified
+    @return protocol or IR_REMOTE_RAW if not recognised.  */
+ir_remote_protocol_t
+ir_remote_decode (const ir_remote_code_t *code, uint32_t *pvalue)
+{
+    uint8_t protocol;
+
+    for (protocol = IR_REMOTE_RAW + 1; protocol < IR_REMOTE_PROTOCOL_NUM;
+         protocol++)
+    {
+        if (ir_remote_decode_format (code, &ir_remote_formats[protocol - 1],
+                                     pvalue))
+            return protocol;
+    }
+    return IR_REMOTE_RAW;
+}
+
+
+/** Record an edge from the IR receiver.  This is called from the
+    edge capture interrupt.
+    @param state 1 at the start of modulation, 0 at the end
+    @param when time of edge.  */
+static void
+ir_remote_rx_edge (uint8_t state, timer_tick_t when)
+{
+    timer_tick_t width;
+
+    if (rx_complete)
+        return;
+
+    if (!rx_started)
+    {
+        if (!state)
+            return;
+        rx_started = 1;
+        rx_count = 0;
+    }
+    else
+    {
+        width = when - rx_edge_time;
+
+        /* A new code is starting so the current one has finished;
+           the new one is lost unless the main loop keeps up.  */
+        if (state && width >= IR_REMOTE_GAP_TICKS)
+        {
+            rx_complete = 1;
+            return;
+        }
+
+        if (rx_count == IR_REMOTE_RUNS_MAX)
+        {
+            /* Too long; start again at the next mark.  */
+            rx_started = 0;
+            return;
+        }
+        rx_runs[rx_count++] = width;
+    }
+    rx_edge_time = when;
+    rx_seq++;
+}
+
+
+/** Get a captured code.
+    @param code pointer to code to fill in
+    @return non-zero if a code has been captured.
+    @note This does not block.  It must be called at least once every
+    code, say every 20 ms; otherwise codes are missed.  */
+bool
+ir_remote_receive (ir_remote_code_t *code)
+{
+    timer_tick_t edge_time;
+    uint8_t seq;
+    uint8_t count;
+    bool ok;
+
+    if (!rx_complete)
+    {
+        if (!rx_started)
+            return 0;
+
+        do
+        {
+            seq = rx_seq;
+            edge_time = rx_edge_time;
+            count = rx_count;
+        } while (seq != rx_seq);
+
+        /* Wait until the last mark has been followed by a long
+           enough space.  */
+        if (!(count & 1)
+            || (timer_tick_t)(timer_get () - edge_time) < IR_REMOTE_GAP_TICKS)
+            return 0;
+
+        /* The edge handler stops adding runs once this is set.  */
+        rx_complete = 1;
+    }
+
+    ok = ir_remote_pack (code, rx_runs, rx_count);
+    rx_started = 0;
+    rx_complete = 0;
+    return ok;
+}
+
+
+/** Send the next run.  This is called from the timer alarm interrupt
+    at the end of each run.
+    @param when time the previous run finished.  */
+static void
+ir_remote_tx_alarm (timer_tick_t when)
+{
+    if (tx_index == tx_code.count)
+    {
+        ir_carrier_set (0);
+        tx_active = 0;
+        rx_started = 0;
+        ir_capture_enable (1);
+        return;
+    }
+
+    ir_carrier_set (!(tx_index & 1));
+    timer_alarm_set (when + ir_remote_run_get (&tx_code, tx_index),
+                     ir_remote_tx_alarm);
+    tx_index++;
+}
+
+
+/** Return non-zero if a code can be transmitted.  */
+bool
+ir_remote_transmit_ready_p (void)
+{
+    /* Reading the timer is not needed on the AVR but it lets the test
+       scaffold, which has no interrupts, run the alarm.  */
+    timer_get ();
+
+    return !tx_active;
+}
+
+
+/** Transmit a code.  This does not block.  The receiver is disabled
+    while the code is sent.
+    @param code pointer to code; this is copied
+    @return non-zero if successful or zero if still transmitting the
+    previous code.  */
+bool
+ir_remote_transmit (const ir_remote_code_t *code)
+{
+    if (!ir_remote_transmit_ready_p ())
+        return 0;
+
+    tx_code = *code;
+    tx_index = 0;
+    tx_active = 1;
+
+    /* Ignore our own transmission.  */
+    ir_capture_enable (0);
+    ir_remote_tx_alarm (timer_get ());
+    return 1;
+}
+
+
+/** Initialise IR remote driver.  This initialises the timer.  */
+void
+ir_remote_init (void)
+{
+    rx_started = 0;
+    rx_complete = 0;
+    tx_active = 0;
+
+    ir_carrier_init ();
+    ir_capture_init (ir_remote_rx_edge);
+}
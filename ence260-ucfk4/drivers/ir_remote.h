@@ -0,0 +1,185 @@
+/** @file   ir_remote.h
+    @author agent
+    @date   19 October 2026
+    @brief  Infrared remote control protocol engine.
+
+    @defgroup ir_remote Infrared remote control protocol engine
+
+    This module captures, decodes, encodes, and transmits the codes
+    sent by infrared remote controls.  It can be used to make a
+    learning remote control.
+
+    A code is stored as a train of runs, alternately with the IR
+    modulation on (a mark) and off (a space), starting and finishing
+    with a mark.  To keep this compact, the durations are clustered
+    into at most IR_REMOTE_DURATIONS distinct values and each run is
+    stored as a 4 bit index into a table of durations.  A 32 bit NEC
+    code then takes 34 bytes instead of 134.  Since the format is the
+    same for every protocol, a code can be captured from any remote
+    control, stored (say in EEPROM), and sent back.
+
+    Known protocols are described by a table rather than by code.  A
+    protocol has a time unit and the header, bits, and trailer are
+    each made of a number of units of mark and space.  Both pulse
+    distance coding (NEC) and bi-phase coding (RC5) are supported.
+    The known protocols are:
+
+      IR_REMOTE_NEC         32 bits (address, ~address, command, ~command)
+      IR_REMOTE_NEC_REPEAT  sent while an NEC button is held
+      IR_REMOTE_RC5         14 bits (start, field, toggle, 5 address, 6 command)
+
+    The receiver timestamps the edges from the IR receiver in an
+    interrupt handler (see @ref ir_capture).  A code is complete when
+    no edges are seen for IR_REMOTE_GAP seconds.  The transmitter
+    gates the timer 0 carrier (see @ref ir_carrier) from a timer alarm
+    interrupt so neither blocks.  The carrier is IR_MODULATION_FREQ
+    (36 kHz); NEC receivers expect 38 kHz but are usually tolerant.
+
+    Note, this uses the same interrupts as the @ref IR_serial "IR
+    serial" driver so the two cannot be used together.
+
+    Here's a simple application that sends back each NEC code
+    received with the next command number.
+
+       @code
+       #include "ir_remote.h"
+       #include "pacer.h"
+
+       void main (void)
+       {
+           ir_remote_code_t code;
+           uint32_t value;
+
+           system_init ();
+           ir_remote_init ();
+
+           pacer_init (100);
+
+           while (1)
+           {
+               pacer_wait ();
+
+               if (ir_remote_receive (&code)
+                   && ir_remote_decode (&code, &value) == IR_REMOTE_NEC)
+               {
+                   // Bits 16 to 23 are the command and bits 24 to 31
+                   // are its complement.
+                   value += 0x00010000;
+                   value -= 0x01000000;
+                   ir_remote_encode (&code, IR_REMOTE_NEC, value);
+                   ir_remote_transmit (&code);
+               }
+           }
+        }
+       @endcode
+*/
+
+#ifndef IR_REMOTE_H
+#define IR_REMOTE_H
+
+#include "system.h"
+#include "timer.h"
+
+
+/** Maximum number of runs in a code.  */
+#ifndef IR_REMOTE_RUNS_MAX
+#define IR_REMOTE_RUNS_MAX 80
+#endif
+
+
+/** Maximum number of distinct durations in a code; at most 16.  */
+#ifndef IR_REMOTE_DURATIONS
+#define IR_REMOTE_DURATIONS 8
+#endif
+
+
+/** Space (s) that marks the end of a code.  */
+#ifndef IR_REMOTE_GAP
+#define IR_REMOTE_GAP 0.008
+#endif
+
+
+/** Protocols.  */
+typedef enum ir_remote_protocol
+{
+    /** The code does not match a known protocol.  */
+    IR_REMOTE_RAW,
+    IR_REMOTE_NEC,
+    IR_REMOTE_NEC_REPEAT,
+    IR_REMOTE_RC5,
+    IR_REMOTE_PROTOCOL_NUM
+} ir_remote_protocol_t;
+
+
+/** Run-length encoded code.  */
+typedef struct ir_remote_code_struct
+{
+    /** Number of runs.  */
+    uint8_t count;
+    /** Table of durations in timer ticks.  */
+    timer_tick_t durations[IR_REMOTE_DURATIONS];
+    /** Duration table indices, two runs per byte, first run in the
+        low nibble.  */
+    uint8_t runs[(IR_REMOTE_RUNS_MAX + 1) / 2];
+} ir_remote_code_t;
+
+
+/** Pack a train of run durations into a code.  Durations within 25
+    percent of each other are treated as the same.
+    @param code pointer to code to fill in
+    @param runs array of durations in timer ticks, starting with a mark
+    @param count number of durations
+    @return non-zero if successful or zero if there are too many runs
+    or too many distinct durations.  */
+bool ir_remote_pack (ir_remote_code_t *code, const timer_tick_t *runs,
+                     uint8_t count);
+
+
+/** Return the duration of a run.
+    @param code pointer to code
+    @param index index of run; even runs are marks and odd runs are spaces
+    @return duration in timer ticks.  */
+timer_tick_t ir_remote_run_get (const ir_remote_code_t *code, uint8_t index);
+
+
+/** Encode a value using a known protocol.
+    @param code pointer to code to fill in
+    @param protocol protocol to use
+    @param value data bits, right justified
+    @return non-zero if successful.  */
+bool ir_remote_encode (ir_remote_code_t *code, ir_remote_protocol_t protocol,
+                       uint32_t value);
+
+
+/** Decode a code by trying each known protocol.
+    @param code pointer to code
+    @param pvalue pointer to store data bits, right justified
+    @return protocol or IR_REMOTE_RAW if not recognised.  */
+ir_remote_protocol_t ir_remote_decode (const ir_remote_code_t *code,
+                                       uint32_t *pvalue);
+
+
+/** Get a captured code.
+    @param code pointer to code to fill in
+    @return non-zero if a code has been captured.
+    @note This does not block.  It must be called at least once every
+    code, say every 20 ms; otherwise codes are missed.  */
+bool ir_remote_receive (ir_remote_code_t *code);
+
+
+/** Return non-zero if a code can be transmitted.  */
+bool ir_remote_transmit_ready_p (void);
+
+
+/** Transmit a code.  This does not block.  The receiver is disabled
+    while the code is sent.
+    @param code pointer to code; this is copied
+    @return non-zero if successful or zero if still transmitting the
+    previous code.  */
+bool ir_remote_transmit (const ir_remote_code_t *code);
+
+
+/** Initialise IR remote driver.  This initialises the timer.  */
+void ir_remote_init (void);
+
+#endif
@@ -4,144 +4,338 @@
     @brief  Infrared serial driver.
 */
 
-/* This should probably be compiled with optimisation enabled
-   otherwise some of the timing may be dodgy. 
-   For documentation of the protocol see ir_serial.h  */
+/* For documentation of the protocol see ir_serial.h  */
 
 
 #include "ir_serial.h"
-#include "delay.h"
+#include "ir_capture.h"
+#include "ir_carrier.h"
+#include "timer.h"
+#ifdef IR_SERIAL_FEC
+#include "ir_fec.h"
+#endif
 
 #define IR_SERIAL_DIT_PERIOD 0.6e-3
-#define IR_SERIAL_MODULATIONS_PER_DIT ((int)(IR_SERIAL_DIT_PERIOD * IR_MODULATION_FREQ))
-#define IR_SERIAL_MODULATIONS_PER_START (IR_SERIAL_MODULATIONS_PER_DIT * 4)
-#define IR_SERIAL_MODULATIONS_PER_ONE   (IR_SERIAL_MODULATIONS_PER_DIT * 2)
-#define IR_SERIAL_MODULATIONS_PER_ZERO  (IR_SERIAL_MODULATIONS_PER_DIT)
-#define IR_SERIAL_MODULATIONS_PER_BREAK  (IR_SERIAL_MODULATIONS_PER_DIT)
-
-#define IR_SERIAL_DELAY_US 10
-#define IR_SERIAL_DIT_COUNT (1e6 * IR_SERIAL_DIT_PERIOD / IR_SERIAL_DELAY_US)
-#define IR_SERIAL_START_COUNT_MAX ((int)(4.5 * IR_SERIAL_DIT_COUNT))
-#define IR_SERIAL_ONE_COUNT_MAX ((int)(2.5 * IR_SERIAL_DIT_COUNT))
-#define IR_SERIAL_ZERO_COUNT_MAX ((int)(1.25 * IR_SERIAL_DIT_COUNT))
-#define IR_SERIAL_BREAK_COUNT_MAX ((int)(1.5 * IR_SERIAL_DIT_COUNT))
-
-
-/** Transmit a start code.  */
-static inline void ir_serial_tx_start (void)
-{
-    ir_tx_set (1, IR_SERIAL_MODULATIONS_PER_START);
-    ir_tx_set (0, IR_SERIAL_MODULATIONS_PER_BREAK);
-}
+#define IR_SERIAL_DIT_TICKS (IR_SERIAL_DIT_PERIOD * TIMER_RATE)
+
+/* Symbol durations in timer ticks.  */
+#define IR_SERIAL_TICKS(DITS) ((timer_tick_t)((DITS) * IR_SERIAL_DIT_TICKS + 0.5))
+#define IR_SERIAL_START_TICKS IR_SERIAL_TICKS (4)
+#define IR_SERIAL_ONE_TICKS IR_SERIAL_TICKS (2)
+#define IR_SERIAL_ZERO_TICKS IR_SERIAL_TICKS (1)
+#define IR_SERIAL_BREAK_TICKS IR_SERIAL_TICKS (1)
+/* The break after the last bit is followed by the stop code.  */
+#define IR_SERIAL_STOP_TICKS IR_SERIAL_TICKS (2)
+
+/* Pulse width thresholds in timer ticks.  */
+#define IR_SERIAL_START_TICKS_MIN ((timer_tick_t)(3 * IR_SERIAL_DIT_TICKS))
+#define IR_SERIAL_START_TICKS_MAX ((timer_tick_t)(4.5 * IR_SERIAL_DIT_TICKS))
+#define IR_SERIAL_ONE_TICKS_MAX ((timer_tick_t)(2.5 * IR_SERIAL_DIT_TICKS))
+#define IR_SERIAL_ZERO_TICKS_MAX ((timer_tick_t)(1.25 * IR_SERIAL_DIT_TICKS))
+#define IR_SERIAL_BREAK_TICKS_MAX ((timer_tick_t)(1.5 * IR_SERIAL_DIT_TICKS))
+
+#ifndef IR_SERIAL_TX_QUEUE_SIZE
+#define IR_SERIAL_TX_QUEUE_SIZE 8
+#endif
+
+#if (IR_SERIAL_TX_QUEUE_SIZE & (IR_SERIAL_TX_QUEUE_SIZE - 1)) != 0
+#error IR_SERIAL_TX_QUEUE_SIZE must be a power of 2
+#endif
+
+/* Number of bits in a frame.  With FEC each byte is sent as a
+   Hamming codeword.  */
+#ifdef IR_SERIAL_FEC
+#define IR_SERIAL_BITS IR_FEC_CODE_BITS
+#else
+#define IR_SERIAL_BITS 8
+#endif
+
+/* A frame is sent as a start code, the data bits each made of a
+   pulse and a break, and a stop code.  These are the steps.  */
+#define IR_SERIAL_TX_STEP_LAST (2 * IR_SERIAL_BITS + 1)
+
+#ifndef IR_SERIAL_RX_QUEUE_SIZE
+#define IR_SERIAL_RX_QUEUE_SIZE 8
+#endif
+
+#if (IR_SERIAL_RX_QUEUE_SIZE & (IR_SERIAL_RX_QUEUE_SIZE - 1)) != 0
+#error IR_SERIAL_RX_QUEUE_SIZE must be a power of 2
+#endif
+
 
+typedef enum {IR_SERIAL_RX_IDLE, IR_SERIAL_RX_DATA} ir_serial_rx_state_t;
 
-/** Transmit a data bit.  */
-static inline void ir_serial_tx_bit (uint8_t state)
+
+typedef struct
 {
-    ir_tx_set (1, state ? IR_SERIAL_MODULATIONS_PER_ONE 
-               : IR_SERIAL_MODULATIONS_PER_ZERO);
-    ir_tx_set (0, IR_SERIAL_MODULATIONS_PER_BREAK);
-}
+    int8_t ret;
+    uint8_t data;
+} ir_serial_rx_entry_t;
+
+
+/* The decoder state is only used by the edge handler.  */
+static ir_serial_rx_state_t rx_state;
+static timer_tick_t rx_edge_time;
+static uint8_t rx_bits;
+static uint16_t rx_data;
+static bool rx_data_err;
+
+/* Queue of bytes to send; the head is written by ir_serial_transmit
+   and the tail by the alarm handler.  */
+static volatile uint8_t tx_queue[IR_SERIAL_TX_QUEUE_SIZE];
+static volatile uint8_t tx_queue_head;
+static volatile uint8_t tx_queue_tail;
+static volatile bool tx_active;
+static uint8_t tx_step;
+static uint16_t tx_data;
 
+/* Queue of received frames; the head is written by the edge handler
+   and the tail by ir_serial_receive.  */
+static volatile ir_serial_rx_entry_t rx_queue[IR_SERIAL_RX_QUEUE_SIZE];
+static volatile uint8_t rx_queue_head;
+static volatile uint8_t rx_queue_tail;
 
-/** Transmit a stop code.  */
-static inline void ir_serial_tx_stop (void)
+static ir_serial_stats_t ir_serial_stats;
+
+static const char * const ir_serial_stats_names[] =
 {
-    ir_tx_set (0, IR_SERIAL_MODULATIONS_PER_BREAK);
-}
+    "tx_frames", "rx_frames", "start_errors", "data_errors",
+    "break_errors", "corrected", "rx_drops"
+};
 
 
-/** Transmit 8 bits of data over IR serial link.
-    @param data byte to transmit
-    @note No error checking is performed.  This function blocks until 
-    the frame is transmitted.  */
-void ir_serial_transmit (uint8_t data)
+static void
+ir_serial_rx_put (ir_serial_ret_t ret, uint8_t data)
 {
-    int i;
+    uint8_t index;
 
-    /* Send start code.  */
-    ir_serial_tx_start ();
-    
-    /* Eight data bits LSB first.  */
-    for (i = 0; i < 8; i++)
+    switch (ret)
     {
-        ir_serial_tx_bit (data & 1);
-        data >>= 1;
+    case IR_SERIAL_OK:
+        ir_serial_stats.rx_frames++;
+        break;
+    case IR_SERIAL_START_ERR:
+        ir_serial_stats.start_errors++;
+        break;
+    case IR_SERIAL_DATA_ERR:
+        ir_serial_stats.data_errors++;
+        break;
+    case IR_SERIAL_BREAK_ERR:
+        ir_serial_stats.break_errors++;
+        break;
+    default:
+        break;
     }
 
-    /* Send stop code.  */
-    ir_serial_tx_stop ();
+    /* Drop the frame if the queue is full.  */
+    if ((uint8_t)(rx_queue_head - rx_queue_tail) >= IR_SERIAL_RX_QUEUE_SIZE)
+    {
+        ir_serial_stats.rx_drops++;
+        return;
+    }
+
+    index = rx_queue_head & (IR_SERIAL_RX_QUEUE_SIZE - 1);
+    rx_queue[index].ret = ret;
+    rx_queue[index].data = data;
+    rx_queue_head++;
 }
 
 
-/** Receive 8 bits of data over IR serial link.  
-    @param pdata pointer to byte to store received data
-    @return status code
-    @note No error checking is performed.  If there is no activity on the
-    IR serial link, this function returns immediately.  Otherwise, this
-    function blocks until the entire frame is received.  */
-ir_serial_ret_t ir_serial_receive (uint8_t *pdata)
+/** Queue a complete frame.  */
+static void
+ir_serial_rx_frame (void)
 {
-    int i;
-    int count;
+#ifdef IR_SERIAL_FEC
     uint8_t data;
-    bool data_err;
+    ir_fec_ret_t ret;
 
-    /* Check for start code; if not present return.  */
-    if (!ir_rx_get ())
-        return IR_SERIAL_NONE;
-
-    /* Wait for end of start code or timeout.  */
-    for (count = 0; ir_rx_get (); count++)
+    /* An over-long pulse is most likely a single corrupted bit; the
+       codeword may still be able to correct it.  */
+    ret = ir_fec_decode (rx_data, &data);
+    if (ret == IR_FEC_ERROR)
     {
-        if (count >= IR_SERIAL_START_COUNT_MAX)
-            return IR_SERIAL_START_ERR;
-
-        DELAY_US (IR_SERIAL_DELAY_US);
+        ir_serial_rx_put (IR_SERIAL_DATA_ERR, 0);
+        return;
     }
+    if (ret == IR_FEC_CORRECTED)
+        ir_serial_stats.corrected++;
+    ir_serial_rx_put (IR_SERIAL_OK, data);
+#else
+    ir_serial_rx_put (rx_data_err ? IR_SERIAL_DATA_ERR : IR_SERIAL_OK,
+                      rx_data);
+#endif
+}
 
-    /* We may have received a rogue short pulse but we may have been
-       called closed to the falling transition.  */
 
-    data_err = 0;
-    data = 0;
+/** Decode an edge from the IR receiver.  This is called from the
+    edge capture interrupt.
+    @param state 1 at the start of a pulse, 0 at the end
+    @param when time of edge.  */
+static void
+ir_serial_rx_edge (uint8_t state, timer_tick_t when)
+{
+    timer_tick_t width;
 
-    /* Eight data bits LSB first.  */
-    for (i = 0; i < 8; i++)
-    {
-        data >>= 1;
+    width = when - rx_edge_time;
+    rx_edge_time = when;
 
-        /* Wait for IR modulation to start or timeout (indicating
-           detection of a false start code).  */
-        for (count = 0; !ir_rx_get (); count++)
+    if (state)
+    {
+        /* A pulse is starting; check the preceding gap if we are
+           part way through a frame.  */
+        if (rx_state == IR_SERIAL_RX_DATA && width > IR_SERIAL_BREAK_TICKS_MAX)
         {
-            if (count >= IR_SERIAL_BREAK_COUNT_MAX)
-                return IR_SERIAL_BREAK_ERR;
+            ir_serial_rx_put (IR_SERIAL_BREAK_ERR, 0);
+            rx_state = IR_SERIAL_RX_IDLE;
+        }
+        return;
+    }
 
-            DELAY_US (IR_SERIAL_DELAY_US);
+    /* A pulse has finished; its width determines the symbol.  */
+    if (rx_state == IR_SERIAL_RX_IDLE)
+    {
+        if (width > IR_SERIAL_START_TICKS_MAX)
+            ir_serial_rx_put (IR_SERIAL_START_ERR, 0);
+        else if (width >= IR_SERIAL_START_TICKS_MIN)
+        {
+            rx_state = IR_SERIAL_RX_DATA;
+            rx_bits = 0;
+            rx_data = 0;
+            rx_data_err = 0;
         }
+        /* Otherwise ignore a short pulse; it is most likely noise or
+           the tail of a frame that we missed the start of.  */
+        return;
+    }
+
+    /* Data bits LSB first.  */
+    rx_data >>= 1;
+    if (width >= IR_SERIAL_ONE_TICKS_MAX)
+        rx_data_err = 1;
+    if (width >= IR_SERIAL_ZERO_TICKS_MAX)
+        rx_data |= BIT (IR_SERIAL_BITS - 1);
 
-        /* If there is another transmission in this slot we will get
-           too small a value for dit_count.  This is likely to trigger
-           a bit error.  */
-        for (count = 0; count < IR_SERIAL_ONE_COUNT_MAX
-                 && ir_rx_get (); count++)
+    if (++rx_bits == IR_SERIAL_BITS)
+    {
+        ir_serial_rx_frame ();
+        rx_state = IR_SERIAL_RX_IDLE;
+    }
+}
+
+
+/** Send the next symbol of the frame.  This is called from the timer
+    alarm interrupt at the end of each symbol.
+    @param when time the previous symbol finished.  */
+static void
+ir_serial_tx_alarm (timer_tick_t when)
+{
+    timer_tick_t duration;
+
+    if (tx_step > IR_SERIAL_TX_STEP_LAST)
+    {
+        if (tx_queue_head == tx_queue_tail)
         {
-            DELAY_US (IR_SERIAL_DELAY_US);
+            /* All done; listen again.  Any frame that was being
+               received will have been corrupted.  */
+            tx_active = 0;
+            rx_state = IR_SERIAL_RX_IDLE;
+            ir_capture_enable (1);
+            return;
         }
+        tx_data = tx_queue[tx_queue_tail & (IR_SERIAL_TX_QUEUE_SIZE - 1)];
+#ifdef IR_SERIAL_FEC
+        tx_data = ir_fec_encode (tx_data);
+#endif
+        tx_queue_tail++;
+        tx_step = 0;
+        ir_serial_stats.tx_frames++;
+    }
+
+    if (tx_step == 0)
+    {
+        ir_carrier_set (1);
+        duration = IR_SERIAL_START_TICKS;
+    }
+    else if (tx_step & 1)
+    {
+        ir_carrier_set (0);
+        duration = tx_step == IR_SERIAL_TX_STEP_LAST
+            ? IR_SERIAL_STOP_TICKS : IR_SERIAL_BREAK_TICKS;
+    }
+    else
+    {
+        /* Data bits LSB first.  */
+        ir_carrier_set (1);
+        duration = (tx_data & 1) ? IR_SERIAL_ONE_TICKS : IR_SERIAL_ZERO_TICKS;
+        tx_data >>= 1;
+    }
+    tx_step++;
+
+    timer_alarm_set (when + duration, ir_serial_tx_alarm);
+}
+
+
+/** Return non-zero if a byte can be queued without blocking.  */
+bool ir_serial_transmit_ready_p (void)
+{
+    return (uint8_t)(tx_queue_head - tx_queue_tail) < IR_SERIAL_TX_QUEUE_SIZE;
+}
+
 
-        if (count >= IR_SERIAL_ONE_COUNT_MAX)
-            data_err = 1;
-            
-        if (count >= IR_SERIAL_ZERO_COUNT_MAX)
-            data |= 0x80;
+/** Queue 8 bits of data to transmit over IR serial link.
+    @param data byte to transmit
+    @note No error checking is performed.  This only blocks if the
+    transmit queue is full.  */
+void ir_serial_transmit (uint8_t data)
+{
+    /* Reading the timer is not needed on the AVR but it lets the test
+       scaffold, which has no interrupts, run the alarm.  */
+    while (!ir_serial_transmit_ready_p ())
+        timer_get ();
+
+    tx_queue[tx_queue_head & (IR_SERIAL_TX_QUEUE_SIZE - 1)] = data;
+    tx_queue_head++;
+
+    /* If the transmitter has gone idle it needs restarting; otherwise
+       the alarm handler will pick up the byte.  */
+    if (!tx_active)
+    {
+        tx_active = 1;
+        /* Ignore our own transmission.  */
+        ir_capture_enable (0);
+        tx_step = IR_SERIAL_TX_STEP_LAST + 1;
+        ir_serial_tx_alarm (timer_get ());
     }
+}
 
-    /* Perhaps should check for stop code.  If not found, there is
-       likely to have been interference from another transmitter.  */
 
-    *pdata = data;
-    return data_err ? IR_SERIAL_DATA_ERR : IR_SERIAL_OK;
+/** Receive 8 bits of data over IR serial link.  
+    @param pdata pointer to byte to store received data
+    @return status code
+    @note This does not block.  The frames are decoded by an interrupt
+    handler as the edges from the IR receiver arrive and are queued
+    until read.  */
+ir_serial_ret_t ir_serial_receive (uint8_t *pdata)
+{
+    uint8_t index;
+    ir_serial_ret_t ret;
+
+    if (rx_queue_head == rx_queue_tail)
+        return IR_SERIAL_NONE;
+
+    index = rx_queue_tail & (IR_SERIAL_RX_QUEUE_SIZE - 1);
+    ret = rx_queue[index].ret;
+    *pdata = rx_queue[index].data;
+    rx_queue_tail++;
+    return ret;
+}
+
+
+/** Return pointer to the link statistics.  These are updated by the
+    interrupt handlers.  */
+const ir_serial_stats_t *ir_serial_stats_get (void)
+{
+    return &ir_serial_stats;
 }
 
 
@@ -149,4 +343,15 @@ ir_serial_ret_t ir_serial_receive (uint8_t *pdata)
 void ir_serial_init (void)
 {
     ir_init ();
+
+    rx_state = IR_SERIAL_RX_IDLE;
+    rx_queue_head = rx_queue_tail = 0;
+    tx_queue_head = tx_queue_tail = 0;
+    tx_active = 0;
+    ir_carrier_init ();
+    ir_capture_init (ir_serial_rx_edge);
+
+    system_stats_register ("ir_serial", ir_serial_stats_names,
+                           (const uint16_t *)&ir_serial_stats,
+                           ARRAY_SIZE (ir_serial_stats_names));
 }
@@ -25,6 +25,28 @@
     detection or correction is performed apart from checking of
     invalid codes.
 
+    If IR_SERIAL_FEC is defined (for example, with -DIR_SERIAL_FEC in
+    CFLAGS) each byte is sent as a 12 bit Hamming codeword (see @ref
+    ir_fec) instead of 8 data bits.  A single misread bit in a frame
+    is then corrected and most other errors are reported as
+    IR_SERIAL_DATA_ERR.  A message takes between 30 and 42 dits.  Both
+    ends must be built with the same setting.
+
+    The transmitter is driven by a timer alarm interrupt that gates
+    the carrier on and off at the end of each code (see @ref
+    ir_carrier).  Bytes are queued so ir_serial_transmit returns
+    immediately unless the queue is full.
+
+    The receiver timestamps the edges from the IR receiver in an
+    interrupt handler (see @ref ir_capture) and decodes the codes as
+    they arrive.  Received bytes are queued so ir_serial_receive
+    never blocks; it only needs to be called often enough to stop the
+    queue overflowing.
+
+    The driver counts the frames sent and received and the errors
+    detected; see ir_serial_stats_get.  On the test scaffold these are
+    printed when the program exits.
+
     Here's a simple application that transmits a data byte of value 7.
 
        @code
@@ -95,22 +117,51 @@ typedef enum ir_serial_ret
 } ir_serial_ret_t;
 
 
-/** Transmit 8 bits of data over IR serial link.
+/** Link statistics.  The counters wrap at 65536.  */
+typedef struct ir_serial_stats_struct
+{
+    /** Frames transmitted.  */
+    uint16_t tx_frames;
+    /** Valid frames received.  */
+    uint16_t rx_frames;
+    /** Frames received with an invalid start code.  */
+    uint16_t start_errors;
+    /** Frames received with an invalid data code.  */
+    uint16_t data_errors;
+    /** Frames received with an invalid break code.  */
+    uint16_t break_errors;
+    /** Frames with a single bit error corrected (IR_SERIAL_FEC only).  */
+    uint16_t corrected;
+    /** Frames discarded since the receive queue was full.  */
+    uint16_t rx_drops;
+} ir_serial_stats_t;
+
+
+/** Return non-zero if a byte can be queued without blocking.  */
+bool ir_serial_transmit_ready_p (void);
+
+
+/** Queue 8 bits of data to transmit over IR serial link.
     @param data byte to transmit
-    @note No error checking is performed.  This function blocks until 
-    the frame is transmitted.  */
+    @note No error checking is performed.  This only blocks if the
+    transmit queue is full.  */
 void ir_serial_transmit (uint8_t data);
 
 
 /** Receive 8 bits of data over IR serial link.  
     @param pdata pointer to byte to store received data
     @return status code
-    @note No error checking is performed.  If there is no activity on the
-    IR serial link, this function returns immediately.  Otherwise, this
-    function blocks until the entire frame is received.  */
+    @note This does not block.  The frames are decoded by an interrupt
+    handler as the edges from the IR receiver arrive and are queued
+    until read.  */
 ir_serial_ret_t ir_serial_receive (uint8_t *pdata);
 
 
+/** Return pointer to the link statistics.  These are updated by the
+    interrupt handlers.  */
+const ir_serial_stats_t *ir_serial_stats_get (void);
+
+
 /** Initialise IR serial driver.  */
 void ir_serial_init (void);
 
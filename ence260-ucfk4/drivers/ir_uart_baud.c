@@ -0,0 +1,586 @@
+/** @file   ir_uart_baud.c
+    @author agent
+    @date   19 October 2026
+    @brief  Adaptive baud rate for the IR UART.
+
+    @note The negotiation is driven by the IR UART functions that the
+    application calls, so the timeouts are checked whenever it reads
+    or writes.  The timer wraps every two seconds so the longer
+    periods are counted in half second windows.
+*/
+#include "ir_uart_baud.h"
+#include "ir_uart.h"
+#include "timer.h"
+
+#if IR_UART_BAUD_ADAPT
+
+#define IR_UART_BAUD_FRAME_SIZE 8
+
+#define IR_UART_BAUD_TESTS 4
+
+#define IR_UART_BAUD_RATES_NUM 3
+
+/* Room for a frame's worth of held characters to be passed on while
+   the application has not read the last lot.  */
+#define IR_UART_BAUD_RELEASE_SIZE (2 * IR_UART_BAUD_FRAME_SIZE)
+
+/* Character time at the slowest rate, which is used for all the
+   timeouts to keep them simple.  */
+#define IR_UART_BAUD_CHAR_TICKS \
+    ((timer_tick_t)(10.0 * TIMER_RATE / IR_UART_BAUD_RATE + 1))
+
+#define IR_UART_BAUD_FRAME_TICKS \
+    (IR_UART_BAUD_FRAME_SIZE * IR_UART_BAUD_CHAR_TICKS)
+
+/* Held characters are passed on if the next does not follow within
+   this time.  */
+#define IR_UART_BAUD_HOLD_TICKS (3 * IR_UART_BAUD_CHAR_TICKS)
+
+/* Each board may take this long to notice a frame and answer, so
+   allow for both when waiting for an answer.  */
+#define IR_UART_BAUD_POLL_TICKS \
+    ((timer_tick_t)(2 * IR_UART_BAUD_POLL_PERIOD * TIMER_RATE))
+
+/* Time to wait for an ACK.  */
+#define IR_UART_BAUD_REPLY_TICKS \
+    (3 * IR_UART_BAUD_FRAME_TICKS + IR_UART_BAUD_POLL_TICKS)
+
+/* Time for the responder to wait for the test frames.  */
+#define IR_UART_BAUD_TESTS_TICKS \
+    (8 * IR_UART_BAUD_FRAME_TICKS + IR_UART_BAUD_POLL_TICKS)
+
+/* Time for the initiator to wait for the answering test frames.  */
+#define IR_UART_BAUD_TESTOK_TICKS \
+    (12 * IR_UART_BAUD_FRAME_TICKS + IR_UART_BAUD_POLL_TICKS)
+
+#define IR_UART_BAUD_WINDOW_TICKS ((timer_tick_t)(TIMER_RATE / 2))
+
+#define IR_UART_BAUD_PROBE_WINDOWS (IR_UART_BAUD_PROBE_PERIOD * 2)
+
+/* Wait longer before trying again after a failure.  */
+#define IR_UART_BAUD_FAIL_WINDOWS (IR_UART_BAUD_PROBE_WINDOWS * 8)
+
+
+enum {IR_UART_BAUD_REQ = 1, IR_UART_BAUD_ACK, IR_UART_BAUD_TEST,
+      IR_UART_BAUD_TESTOK, IR_UART_BAUD_RESET};
+
+
+typedef enum
+{
+    /* Running at rates[rate_index].  */
+    IR_UART_BAUD_STATE_IDLE,
+    /* Sent REQ; waiting for ACK.  */
+    IR_UART_BAUD_STATE_REQUESTED,
+    /* Got ACK; switch rate when our characters have gone.  */
+    IR_UART_BAUD_STATE_SWITCH,
+    /* Sending ACK; switch rate when it has gone.  */
+    IR_UART_BAUD_STATE_ACKED,
+    /* Waiting for TEST frames at the new rate.  */
+    IR_UART_BAUD_STATE_TESTS,
+    /* Sent TEST frames; waiting for TESTOK frames.  */
+    IR_UART_BAUD_STATE_TESTOK
+} ir_uart_baud_state_t;
+
+
+static const uint16_t rates[IR_UART_BAUD_RATES_NUM] =
+{
+    IR_UART_BAUD_RATE,
+    (IR_UART_BAUD_RATE + IR_UART_BAUD_MAX) / 2,
+    IR_UART_BAUD_MAX
+};
+
+static const uint8_t pattern[IR_UART_BAUD_FRAME_SIZE] =
+{
+    0xc5, 0x3a, 0, 0, 0x00, 0xff, 0x55, 0x0f
+};
+
+static ir_uart_baud_state_t state;
+static uint8_t rate_index;
+static uint8_t new_index;
+static timer_tick_t deadline;
+static uint8_t tests;
+static timer_tick_t test_time;
+
+static timer_tick_t window_start;
+static uint16_t windows_left;
+static uint16_t errors_last;
+static uint16_t seed;
+/* Random number sent with our REQ.  */
+static uint8_t req_id;
+
+/* Received characters that may be part of a control frame.  */
+static uint8_t hold[IR_UART_BAUD_FRAME_SIZE];
+static timer_tick_t hold_times[IR_UART_BAUD_FRAME_SIZE];
+static uint8_t hold_len;
+static timer_tick_t hold_time;
+
+/* Received characters for the application.  */
+static uint8_t release[IR_UART_BAUD_RELEASE_SIZE];
+static timer_tick_t release_times[IR_UART_BAUD_RELEASE_SIZE];
+static uint8_t release_pos;
+static uint8_t release_len;
+
+/* Time that the last character read by the application was
+   received.  */
+static timer_tick_t rx_time;
+
+/* Control frames being sent.  */
+static uint8_t tx_frame[IR_UART_BAUD_FRAME_SIZE];
+static uint8_t tx_pos;
+static uint8_t tx_count;
+
+static ir_uart_baud_stats_t stats;
+
+static const char * const stats_names[] =
+{
+    "probes", "upgrades", "failures", "fallbacks"
+};
+
+
+static bool
+ir_uart_baud_expired_p (timer_tick_t now, timer_tick_t when)
+{
+    return (int16_t)(now - when) >= 0;
+}
+
+
+static uint8_t
+ir_uart_baud_random (void)
+{
+    seed = seed * 25173 + 13849;
+    return seed >> 8;
+}
+
+
+/** Return a small random number of windows to wait so that the two
+    boards do not keep probing at the same time.  */
+static uint8_t
+ir_uart_baud_windows_random (void)
+{
+    return ir_uart_baud_random () & 3;
+}
+
+
+/** Queue count copies of a control frame.  */
+static void
+ir_uart_baud_frame_send (uint8_t type, uint8_t rate, uint8_t count)
+{
+    uint8_t i;
+
+    for (i = 0; i < IR_UART_BAUD_FRAME_SIZE; i++)
+        tx_frame[i] = pattern[i];
+    tx_frame[2] = type;
+    tx_frame[3] = rate;
+    if (type == IR_UART_BAUD_REQ)
+        tx_frame[4] = req_id;
+    tx_pos = 0;
+    tx_count = count;
+}
+
+
+/** Send as much of the queued control frames as will fit.  */
+static void
+ir_uart_baud_frame_flush (void)
+{
+    while (tx_count)
+    {
+        tx_pos += ir_uart_raw_write (tx_frame + tx_pos,
+                                     IR_UART_BAUD_FRAME_SIZE - tx_pos);
+        if (tx_pos < IR_UART_BAUD_FRAME_SIZE)
+            return;
+        tx_pos = 0;
+        tx_count--;
+    }
+}
+
+
+static void
+ir_uart_baud_rate_use (uint8_t index)
+{
+    ir_uart_raw_rate_set (rates[index]);
+}
+
+
+/** Give up on a step up and return to the old rate.  The boards
+    wait a random extra time so they do not ask again at once.  */
+static void
+ir_uart_baud_abandon (uint8_t windows)
+{
+    if (state == IR_UART_BAUD_STATE_TESTS
+        || state == IR_UART_BAUD_STATE_TESTOK)
+    {
+        ir_uart_baud_rate_use (rate_index);
+        stats.failures++;
+    }
+    /* The test frames at a rate that does not work are not errors at
+       the old rate.  */
+    errors_last = ir_uart_raw_errors_get ();
+    state = IR_UART_BAUD_STATE_IDLE;
+    windows_left = windows + ir_uart_baud_windows_random ();
+}
+
+
+/** Switch to the new rate and send the test frames.  */
+static void
+ir_uart_baud_tests_send (timer_tick_t now)
+{
+    ir_uart_baud_rate_use (new_index);
+    ir_uart_baud_frame_send (IR_UART_BAUD_TEST, new_index,
+                             IR_UART_BAUD_TESTS);
+    tests = 0;
+    deadline = now + IR_UART_BAUD_TESTOK_TICKS;
+    state = IR_UART_BAUD_STATE_TESTOK;
+}
+
+
+static void
+ir_uart_baud_frame_process (uint8_t type, uint8_t rate, uint8_t id,
+                            timer_tick_t now)
+{
+    switch (type)
+    {
+    case IR_UART_BAUD_REQ:
+        if (state == IR_UART_BAUD_STATE_REQUESTED)
+        {
+            /* Both boards asked at once.  The lower id goes ahead and
+               the other board answers it.  */
+            if (id == req_id)
+            {
+                ir_uart_baud_abandon (1);
+                break;
+            }
+            if (id > req_id)
+                break;
+            state = IR_UART_BAUD_STATE_IDLE;
+        }
+        if (state == IR_UART_BAUD_STATE_IDLE
+            && rate == rate_index + 1 && rate < IR_UART_BAUD_RATES_NUM)
+        {
+            new_index = rate;
+            ir_uart_baud_frame_send (IR_UART_BAUD_ACK, rate, 1);
+            state = IR_UART_BAUD_STATE_ACKED;
+        }
+        break;
+
+    case IR_UART_BAUD_ACK:
+        if (state == IR_UART_BAUD_STATE_REQUESTED && rate == new_index)
+        {
+            /* The other board switches when its ACK has gone, which
+               is about when the last character arrives here, but any
+               characters the application wrote meanwhile must go at
+               the old rate first.  */
+            if (ir_uart_raw_write_finished_p ())
+                ir_uart_baud_tests_send (now);
+            else
+                state = IR_UART_BAUD_STATE_SWITCH;
+        }
+        break;
+
+    case IR_UART_BAUD_TEST:
+        if (state == IR_UART_BAUD_STATE_TESTS && rate == new_index)
+        {
+            tests++;
+            test_time = now;
+        }
+        break;
+
+    case IR_UART_BAUD_TESTOK:
+        if (state == IR_UART_BAUD_STATE_TESTOK && rate == new_index
+            && ++tests >= IR_UART_BAUD_TESTS_MIN)
+        {
+            rate_index = new_index;
+            stats.upgrades++;
+            state = IR_UART_BAUD_STATE_IDLE;
+            windows_left = IR_UART_BAUD_PROBE_WINDOWS + ir_uart_baud_windows_random ();
+        }
+        break;
+
+    default:
+        /* A RESET is only decoded at the slowest rate, where there is
+           nothing to do; at a faster rate it appears as errors.  */
+        break;
+    }
+}
+
+
+/** Pass the held characters on to the application.  */
+static void
+ir_uart_baud_release (void)
+{
+    uint8_t i;
+
+    for (i = 0; i < hold_len; i++)
+    {
+        release[release_len] = hold[i];
+        release_times[release_len++] = hold_times[i];
+    }
+    hold_len = 0;
+}
+
+
+/** Check a received character against the control frame pattern.
+    The character was received at when.  */
+static void
+ir_uart_baud_rx (uint8_t ch, timer_tick_t when, timer_tick_t now)
+{
+    bool match;
+
+    /* Stir in what only this board sees.  */
+    seed += ch + when;
+
+    if (hold_len == 2)
+        match = ch >= IR_UART_BAUD_REQ && ch <= IR_UART_BAUD_RESET;
+    else if (hold_len == 3)
+        match = ch < IR_UART_BAUD_RATES_NUM;
+    else if (hold_len == 4 && hold[2] == IR_UART_BAUD_REQ)
+        match = 1;
+    else
+        match = ch == pattern[hold_len];
+
+    if (!match)
+    {
+        ir_uart_baud_release ();
+
+        /* This may start a frame.  */
+        if (ch != pattern[0])
+        {
+            release[release_len] = ch;
+            release_times[release_len++] = when;
+            return;
+        }
+    }
+
+    hold[hold_len] = ch;
+    hold_times[hold_len++] = when;
+    hold_time = now;
+    if (hold_len == IR_UART_BAUD_FRAME_SIZE)
+    {
+        hold_len = 0;
+        ir_uart_baud_frame_process (hold[2], hold[3], hold[4], now);
+    }
+}
+
+
+/** Check the error rate every window and probe when due.  */
+static void
+ir_uart_baud_window (void)
+{
+    uint16_t errors;
+    uint16_t delta;
+
+    errors = ir_uart_raw_errors_get ();
+    delta = errors - errors_last;
+    errors_last = errors;
+
+    /* Errors are expected while switching.  */
+    if (state != IR_UART_BAUD_STATE_IDLE)
+        return;
+
+    if (delta >= IR_UART_BAUD_ERRORS_MAX)
+    {
+        if (rate_index)
+        {
+            rate_index = 0;
+            ir_uart_baud_rate_use (0);
+            stats.fallbacks++;
+            windows_left = IR_UART_BAUD_FAIL_WINDOWS;
+        }
+        else if (!tx_count)
+        {
+            /* The other board may still be at a faster rate.  */
+            ir_uart_baud_frame_send (IR_UART_BAUD_RESET, 0, 1);
+        }
+        return;
+    }
+
+    if (windows_left)
+        windows_left--;
+}
+
+
+/** Run the negotiation.  */
+void
+ir_uart_baud_update (void)
+{
+    timer_tick_t now;
+    uint8_t ch;
+    uint8_t i;
+
+    now = timer_get ();
+
+    if (release_pos)
+    {
+        for (i = release_pos; i < release_len; i++)
+        {
+            release[i - release_pos] = release[i];
+            release_times[i - release_pos] = release_times[i];
+        }
+        release_len -= release_pos;
+        release_pos = 0;
+    }
+
+    /* Keep looking for control frames while the application is not
+       reading, for example when it is waiting to write, as long as
+       the characters passed on will fit.  */
+    while (release_len <= IR_UART_BAUD_RELEASE_SIZE - IR_UART_BAUD_FRAME_SIZE
+           && ir_uart_raw_read (&ch, 1))
+        ir_uart_baud_rx (ch, ir_uart_raw_rx_time_get (), now);
+
+    if (hold_len && release_len + hold_len <= IR_UART_BAUD_RELEASE_SIZE
+        && (timer_tick_t)(now - hold_time) > IR_UART_BAUD_HOLD_TICKS)
+        ir_uart_baud_release ();
+
+    ir_uart_baud_frame_flush ();
+
+    if ((timer_tick_t)(now - window_start) >= IR_UART_BAUD_WINDOW_TICKS)
+    {
+        window_start = now;
+        ir_uart_baud_window ();
+    }
+
+    switch (state)
+    {
+    case IR_UART_BAUD_STATE_IDLE:
+        if (!windows_left && rate_index + 1 < IR_UART_BAUD_RATES_NUM
+            && !hold_len && !tx_count && ir_uart_raw_write_finished_p ())
+        {
+            new_index = rate_index + 1;
+            req_id = ir_uart_baud_random ();
+            ir_uart_baud_frame_send (IR_UART_BAUD_REQ, new_index, 1);
+            ir_uart_baud_frame_flush ();
+            stats.probes++;
+            deadline = now + IR_UART_BAUD_REPLY_TICKS;
+            state = IR_UART_BAUD_STATE_REQUESTED;
+        }
+        break;
+
+    case IR_UART_BAUD_STATE_REQUESTED:
+        /* The other board may not be listening or may not negotiate.  */
+        if (ir_uart_baud_expired_p (now, deadline))
+            ir_uart_baud_abandon (IR_UART_BAUD_FAIL_WINDOWS);
+        break;
+
+    case IR_UART_BAUD_STATE_SWITCH:
+        if (ir_uart_raw_write_finished_p ())
+            ir_uart_baud_tests_send (now);
+        break;
+
+    case IR_UART_BAUD_STATE_ACKED:
+        if (!tx_count && ir_uart_raw_write_finished_p ())
+        {
+            ir_uart_baud_rate_use (new_index);
+            tests = 0;
+            deadline = now + IR_UART_BAUD_TESTS_TICKS;
+            state = IR_UART_BAUD_STATE_TESTS;
+        }
+        break;
+
+    case IR_UART_BAUD_STATE_TESTS:
+        /* Answer once the test frames have stopped arriving so that
+           the answers are not taken for echoes.  */
+        if (tests >= IR_UART_BAUD_TESTS_MIN
+            && (tests == IR_UART_BAUD_TESTS
+                || (timer_tick_t)(now - test_time) > IR_UART_BAUD_FRAME_TICKS))
+        {
+            ir_uart_baud_frame_send (IR_UART_BAUD_TESTOK, new_index,
+                                     IR_UART_BAUD_TESTS);
+            ir_uart_baud_frame_flush ();
+            rate_index = new_index;
+            stats.upgrades++;
+            state = IR_UART_BAUD_STATE_IDLE;
+            windows_left = IR_UART_BAUD_PROBE_WINDOWS + ir_uart_baud_windows_random ();
+        }
+        else if (ir_uart_baud_expired_p (now, deadline))
+            ir_uart_baud_abandon (IR_UART_BAUD_FAIL_WINDOWS);
+        break;
+
+    case IR_UART_BAUD_STATE_TESTOK:
+        if (ir_uart_baud_expired_p (now, deadline))
+            ir_uart_baud_abandon (IR_UART_BAUD_FAIL_WINDOWS);
+        break;
+    }
+}
+
+
+/** Return non-zero if there is a character for the application.  */
+bool
+ir_uart_baud_read_ready_p (void)
+{
+    if (release_pos == release_len)
+        ir_uart_baud_update ();
+    return release_pos < release_len;
+}
+
+
+/** Read up to size characters for the application.  */
+uint8_t
+ir_uart_baud_read (void *data, uint8_t size)
+{
+    uint8_t *dst = data;
+    uint8_t count;
+
+    for (count = 0; count < size && ir_uart_baud_read_ready_p (); count++)
+    {
+        rx_time = release_times[release_pos];
+        *dst++ = release[release_pos++];
+    }
+    return count;
+}
+
+
+/** Return the time that the last character read was received.  */
+timer_tick_t
+ir_uart_baud_rx_time_get (void)
+{
+    return rx_time;
+}
+
+
+/** Return non-zero if the application may write.  Writing may
+    continue while waiting for an ACK since it is sent at the old
+    rate.  */
+bool
+ir_uart_baud_write_ready_p (void)
+{
+    ir_uart_baud_update ();
+    return (state == IR_UART_BAUD_STATE_IDLE
+            || state == IR_UART_BAUD_STATE_REQUESTED) && !tx_count;
+}
+
+
+/** Return the current baud rate.  */
+uint16_t
+ir_uart_baud_rate_get (void)
+{
+    return rates[rate_index];
+}
+
+
+/** Return pointer to the rate negotiation statistics.  */
+const ir_uart_baud_stats_t *
+ir_uart_baud_stats_get (void)
+{
+    return &stats;
+}
+
+
+/** Initialise rate negotiation.  */
+void
+ir_uart_baud_init (void)
+{
+    state = IR_UART_BAUD_STATE_IDLE;
+    rate_index = 0;
+    hold_len = 0;
+    release_pos = release_len = 0;
+    tx_count = 0;
+
+    window_start = timer_get ();
+    seed = ir_uart_raw_seed_get () + window_start;
+    windows_left = IR_UART_BAUD_PROBE_WINDOWS + ir_uart_baud_windows_random ();
+    errors_last = ir_uart_raw_errors_get ();
+
+    system_stats_register ("ir_uart_baud", stats_names,
+                           (const uint16_t *)&stats, ARRAY_SIZE (stats_names));
+}
+
+#endif
@@ -0,0 +1,198 @@
+/** @file   ir_uart_baud.h
+    @author agent
+    @date   19 October 2026
+    @brief  Adaptive baud rate for the IR UART.
+
+    @defgroup ir_uart_baud IR UART adaptive baud rate
+
+    The IR UART starts at IR_UART_BAUD_RATE (2400 baud) but the IR
+    receiver can manage up to 4000 bps on a good link.  When this
+    module is enabled, by compiling with IR_UART_BAUD_ADAPT defined to
+    1, the @ref IR_uart "IR uart" driver negotiates the fastest rate
+    that works with the other board without any change to the
+    application.  Both boards must be built with it enabled.
+    ir_uart_demo1 is built this way; to enable it for another
+    application add -DIR_UART_BAUD_ADAPT=1 to CFLAGS in its Makefile
+    and Makefile.test.
+
+    The rates tried are IR_UART_BAUD_RATE, IR_UART_BAUD_MAX, and the
+    rate midway between.  Every IR_UART_BAUD_PROBE_PERIOD seconds, if
+    a faster rate has not failed recently, a board asks the other to
+    step up a rate:
+
+      REQ (old rate)  ->
+                      <-  ACK (old rate)
+      both switch to the new rate
+      TEST x 4        ->
+                      <-  TESTOK x 4
+
+    If both boards ask at once, the one that sent the lower random id
+    goes ahead and the other answers it; if the ids are the same both
+    try again after a random time.  Each board seeds its random
+    numbers with ir_uart_raw_seed_get so that boards reset together
+    do not make the same choices.
+
+    Each side needs IR_UART_BAUD_TESTS_MIN of the four test frames to
+    arrive intact, otherwise both return to the old rate when they
+    time out.  If more than IR_UART_BAUD_ERRORS_MAX framing or overrun
+    errors occur in half a second the board falls back to
+    IR_UART_BAUD_RATE; a board that is already at that rate sends a
+    RESET frame so that the errors make the other board fall back as
+    well.
+
+    A control frame is eight characters:
+
+      0xc5 0x3a TYPE RATE ID 0xff 0x55 0x0f
+
+    where RATE is the index of the rate and ID is the random id for a
+    REQ and 0x00 otherwise.  The received characters are
+    checked against this pattern and held back until they either
+    complete a frame, which is removed, or fail to match, when they
+    are passed on.  Thus application data is not escaped and only
+    characters that look like the start of a frame are delayed, by at
+    most a few character times.  Characters written by the
+    application are held back from when the ACK is sent or received
+    until the rate change is over.
+*/
+
+#ifndef IR_UART_BAUD_H
+#define IR_UART_BAUD_H
+
+#include "system.h"
+#include "timer.h"
+
+
+/** Non-zero to negotiate the baud rate.  */
+#ifndef IR_UART_BAUD_ADAPT
+#define IR_UART_BAUD_ADAPT 0
+#endif
+
+
+/** Fastest rate to try; the IR receiver manages 4000 bps.  */
+#ifndef IR_UART_BAUD_MAX
+#define IR_UART_BAUD_MAX 4000
+#endif
+
+
+/** Time between attempts to step up the rate (s).  */
+#ifndef IR_UART_BAUD_PROBE_PERIOD
+#define IR_UART_BAUD_PROBE_PERIOD 5
+#endif
+
+
+/** Longest time between calls to the IR UART functions (s).  The
+    negotiation only runs when the application calls them so this is
+    allowed for when waiting for the other board to answer.  It must
+    be less than 0.25 s.  */
+#ifndef IR_UART_BAUD_POLL_PERIOD
+#define IR_UART_BAUD_POLL_PERIOD 0.1
+#endif
+
+
+/** Errors in half a second that cause a fall back.  */
+#ifndef IR_UART_BAUD_ERRORS_MAX
+#define IR_UART_BAUD_ERRORS_MAX 4
+#endif
+
+
+/** Test frames out of four that must arrive intact.  */
+#ifndef IR_UART_BAUD_TESTS_MIN
+#define IR_UART_BAUD_TESTS_MIN 3
+#endif
+
+
+/** Rate negotiation statistics.  The counters wrap at 65536.  */
+typedef struct ir_uart_baud_stats_struct
+{
+    /** Requests to step up sent.  */
+    uint16_t probes;
+    /** Steps up to a faster rate.  */
+    uint16_t upgrades;
+    /** Steps up abandoned since the test frames did not arrive.  */
+    uint16_t failures;
+    /** Falls back to IR_UART_BAUD_RATE due to errors.  */
+    uint16_t fallbacks;
+} ir_uart_baud_stats_t;
+
+
+/** Return the current baud rate.  */
+uint16_t
+ir_uart_baud_rate_get (void);
+
+
+/** Return pointer to the rate negotiation statistics.  */
+const ir_uart_baud_stats_t *
+ir_uart_baud_stats_get (void);
+
+
+/** The following are used by the IR UART driver.  */
+
+/** Return non-zero if there is a character for the application.  */
+bool
+ir_uart_baud_read_ready_p (void);
+
+
+/** Read up to size characters for the application.  */
+uint8_t
+ir_uart_baud_read (void *data, uint8_t size);
+
+
+/** Return the time that the last character read was received.  */
+timer_tick_t
+ir_uart_baud_rx_time_get (void);
+
+
+/** Return non-zero if the application may write; this is zero while
+    the rate is being changed.  */
+bool
+ir_uart_baud_write_ready_p (void);
+
+
+/** Run the negotiation.  This is called by the IR UART functions so
+    it runs as long as the application uses the IR UART.  */
+void
+ir_uart_baud_update (void);
+
+
+/** Initialise rate negotiation at IR_UART_BAUD_RATE.  */
+void
+ir_uart_baud_init (void);
+
+
+/** These are provided by the IR UART driver for each platform.  */
+
+/** Read characters without negotiation.  */
+uint8_t
+ir_uart_raw_read (void *data, uint8_t size);
+
+
+/** Return the time that the last character read was received.  */
+timer_tick_t
+ir_uart_raw_rx_time_get (void);
+
+
+/** Write characters without negotiation.  */
+uint8_t
+ir_uart_raw_write (const void *data, uint8_t size);
+
+
+/** Return non-zero if the transmitter has finished.  */
+bool
+ir_uart_raw_write_finished_p (void);
+
+
+/** Change the baud rate.  */
+void
+ir_uart_raw_rate_set (uint16_t baud);
+
+
+/** Return the number of framing and overrun errors.  */
+uint16_t
+ir_uart_raw_errors_get (void);
+
+
+/** Return a number that should differ between boards.  */
+uint16_t
+ir_uart_raw_seed_get (void);
+
+#endif
@@ -0,0 +1,197 @@
+/** @file   ir_uart_fec.c
+    @author agent
+    @date   19 October 2026
+    @brief  Error correcting byte stream over the IR UART.
+
+    @note The second character of a codeword may not fit in the IR
+    UART transmit buffer.  It is held here and is sent whenever one of
+    the functions is next called.
+*/
+#include "ir_uart_fec.h"
+#include "ir_uart.h"
+#include "ir_fec.h"
+
+
+#define IR_UART_FEC_HALF_BITS 6
+#define IR_UART_FEC_HALF_MASK 0x3f
+#define IR_UART_FEC_MARK_SHIFT 6
+#define IR_UART_FEC_MARK_FIRST 0x00
+#define IR_UART_FEC_MARK_SECOND 0x03
+
+#define IR_UART_FEC_COUNT(COUNT) \
+    do { if ((COUNT) != UINT16_MAX) (COUNT)++; } while (0)
+
+
+static uint8_t tx_pending[2];
+static uint8_t tx_pending_index;
+static uint8_t tx_pending_size;
+
+static bool rx_half;
+static uint8_t rx_first;
+
+static ir_uart_fec_stats_t stats;
+
+static const char * const stats_names[] =
+{
+    "corrected", "failed", "unpaired"
+};
+
+
+/** Try to send the rest of the current codeword.
+    @return non-zero if it has all been passed to the IR UART.  */
+static bool
+ir_uart_fec_flush (void)
+{
+    while (tx_pending_index < tx_pending_size
+           && ir_uart_write (&tx_pending[tx_pending_index], 1))
+        tx_pending_index++;
+
+    return tx_pending_index == tx_pending_size;
+}
+
+
+/** Return non-zero if a byte can be written without blocking.  */
+bool
+ir_uart_fec_write_ready_p (void)
+{
+    return ir_uart_fec_flush () && ir_uart_write_ready_p ();
+}
+
+
+/** Return non-zero if all written bytes have been sent.  */
+bool
+ir_uart_fec_write_finished_p (void)
+{
+    return ir_uart_fec_flush () && ir_uart_write_finished_p ();
+}
+
+
+/** Write up to size bytes without blocking.
+    @param data pointer to data to write
+    @param size maximum number of bytes to write
+    @return number of bytes queued for transmission.  */
+uint8_t
+ir_uart_fec_write (const void *data, uint8_t size)
+{
+    const uint8_t *src = data;
+    uint16_t code;
+    uint8_t count;
+
+    for (count = 0; count < size && ir_uart_fec_write_ready_p (); count++)
+    {
+        code = ir_fec_encode (*src++);
+
+        tx_pending[0] = (IR_UART_FEC_MARK_FIRST << IR_UART_FEC_MARK_SHIFT)
+            | (code & IR_UART_FEC_HALF_MASK);
+        tx_pending[1] = (IR_UART_FEC_MARK_SECOND << IR_UART_FEC_MARK_SHIFT)
+            | (code >> IR_UART_FEC_HALF_BITS);
+        tx_pending_index = 0;
+        tx_pending_size = 2;
+        ir_uart_fec_flush ();
+    }
+    return count;
+}
+
+
+/** Process a received character.
+    @return non-zero if a byte has been decoded.  */
+static bool
+ir_uart_fec_rx (uint8_t ch, uint8_t *pdata)
+{
+    uint8_t mark;
+    bool second;
+    uint16_t code;
+
+    mark = ch >> IR_UART_FEC_MARK_SHIFT;
+    if (mark == IR_UART_FEC_MARK_FIRST)
+        second = 0;
+    else if (mark == IR_UART_FEC_MARK_SECOND)
+        second = 1;
+    else
+        second = rx_half;
+
+    if (!second)
+    {
+        if (rx_half)
+            IR_UART_FEC_COUNT (stats.unpaired);
+        rx_first = ch & IR_UART_FEC_HALF_MASK;
+        rx_half = 1;
+        return 0;
+    }
+
+    if (!rx_half)
+    {
+        IR_UART_FEC_COUNT (stats.unpaired);
+        return 0;
+    }
+    rx_half = 0;
+
+    code = ((uint16_t)(ch & IR_UART_FEC_HALF_MASK) << IR_UART_FEC_HALF_BITS)
+        | rx_first;
+
+    switch (ir_fec_decode (code, pdata))
+    {
+    case IR_FEC_CORRECTED:
+        IR_UART_FEC_COUNT (stats.corrected);
+        return 1;
+
+    case IR_FEC_OK:
+        return 1;
+
+    default:
+        IR_UART_FEC_COUNT (stats.failed);
+        return 0;
+    }
+}
+
+
+/** Read up to size bytes without blocking.  Corrupted bytes that
+    cannot be corrected are discarded.
+    @param data pointer to buffer to store data
+    @param size maximum number of bytes to read
+    @return number of bytes read.  */
+uint8_t
+ir_uart_fec_read (void *data, uint8_t size)
+{
+    uint8_t *dst = data;
+    uint8_t count;
+    uint8_t ch;
+
+    ir_uart_fec_flush ();
+
+    count = 0;
+    while (count < size && ir_uart_read (&ch, 1))
+    {
+        if (ir_uart_fec_rx (ch, dst))
+        {
+            dst++;
+            count++;
+        }
+    }
+    return count;
+}
+
+
+/** Return pointer to the error counts.  These saturate rather than
+    wrap.  */
+const ir_uart_fec_stats_t *
+ir_uart_fec_stats_get (void)
+{
+    return &stats;
+}
+
+
+/** Initialise the error correcting byte stream.  This initialises
+    the IR UART.  */
+void
+ir_uart_fec_init (void)
+{
+    tx_pending_index = tx_pending_size = 0;
+    rx_half = 0;
+    stats.corrected = stats.failed = stats.unpaired = 0;
+
+    ir_uart_init ();
+
+    system_stats_register ("ir_uart_fec", stats_names,
+                           (const uint16_t *)&stats, ARRAY_SIZE (stats_names));
+}
@@ -25,6 +25,19 @@ static const pio_t ledmat_cols[] =
 };
 
 
+/** Function to call while the display is blanked.  */
+static void (*ledmat_blank_hook) (void);
+
+
+/** Set function to call while the display is blanked at the start of
+    each refresh cycle.
+    @param hook function to call or NULL for none.  */
+void ledmat_blank_hook_set (void (*hook) (void))
+{
+    ledmat_blank_hook = hook;
+}
+
+
 /** Initialise PIO pins to drive LED matrix.  */
 void ledmat_init (void)
 {
@@ -58,6 +71,16 @@ void ledmat_display_column (uint8_t pattern, uint8_t col)
     /* Disable previous column to prevent ghosting while rows modified.  */
     pio_output_high (ledmat_cols[col_prev]);
 
+    if (col == 0 && ledmat_blank_hook)
+    {
+        /* All the columns are now off; turn off the rows too so that
+           the hook can use the column pins.  */
+        for (row = 0; row < LEDMAT_ROWS_NUM; row++)
+            pio_output_high (ledmat_rows[row]);
+
+        ledmat_blank_hook ();
+    }
+
     /* Activate desired rows based on desired pattern.  */
     for (row = 0; row < LEDMAT_ROWS_NUM; row++)
     {
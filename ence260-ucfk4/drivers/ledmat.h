@@ -6,6 +6,12 @@
     @defgroup ledmat LED matrix driver
        
     This module implements a simple hardware abstraction of a LED matrix.
+
+    The columns are driven one at a time.  Before column 0 is driven,
+    all the columns and rows are turned off and the function set by
+    ledmat_blank_hook_set, if any, is called.  This allows the
+    navswitch, which shares the column pins, to be read once each
+    refresh cycle without disturbing the display; see navswitch_scan.
 */
 #ifndef LEDMAT_H
 #define LEDMAT_H
@@ -16,6 +22,12 @@
 void ledmat_init (void);
 
 
+/** Set function to call while the display is blanked at the start of
+    each refresh cycle.
+    @param hook function to call or NULL for none.  */
+void ledmat_blank_hook_set (void (*hook) (void));
+
+
 /** Display pattern on specified column.
     @param pattern bit pattern to display for selected column
     @param col selected column.  */
@@ -2,8 +2,8 @@
     @author M.P. Hayes
     @date   28 Aug 2008
     @brief Navswitch driver.
-    @note This polls the 5-way navigation switch
-          but does not do debouncing.
+    @note This polls the 5-way navigation switch and debounces
+          each switch with an integrator.
 */
 
 #include "system.h"
@@ -22,8 +22,14 @@ typedef struct
 /** Navswitch state structure.  */
 typedef struct
 {
+    /* State seen by the application at the last two calls of
+       navswitch_update.  */
     bool current;
     bool previous;
+    /* Debounce integrator, 0 to navswitch_debounce_polls.  */
+    uint8_t integrator;
+    /* Number of polls the switch has been down, saturating.  */
+    uint16_t held;
 } navswitch_state_t;
 
 
@@ -39,8 +45,59 @@ static const navswitch_cfg_t navswitch_cfg[] =
 
 #define NAVSWITCH_NUM ARRAY_SIZE (navswitch_cfg)
 
+
+#ifdef DEBUG
+/* PIO groups are not supported when DEBUG is defined so each switch
+   is a group of its own and is accessed a pin at a time.  */
+#define NAVSWITCH_SAME_GROUP_P(GROUP, PIO) 0
+#define navswitch_group_config_save(GROUP) pio_config_get (GROUP)
+#define navswitch_group_config_restore(GROUP, CONFIG) \
+    pio_config_set (GROUP, CONFIG)
+#define navswitch_group_input_get(GROUP) pio_input_get (GROUP)
+#define navswitch_bitmask_get(PIO) 1
+#else
+#define NAVSWITCH_SAME_GROUP_P(GROUP, PIO) PIO_SAME_PORT_P (GROUP, PIO)
+#define navswitch_group_config_save(GROUP) pio_group_config_save (GROUP)
+#define navswitch_group_config_restore(GROUP, CONFIG) \
+    pio_group_config_restore (GROUP, CONFIG)
+#define navswitch_group_input_get(GROUP) pio_group_input_get (GROUP)
+#define navswitch_bitmask_get(PIO) pio_bitmask_get (PIO)
+#endif
+
 static navswitch_state_t navswitch_state[NAVSWITCH_NUM];
 
+/* The switch PIOs grouped by port and the group of each switch.  */
+static pio_t navswitch_groups[NAVSWITCH_NUM];
+static uint8_t navswitch_groups_num;
+static uint8_t navswitch_group[NAVSWITCH_NUM];
+
+/* Bitmask of the debounced switches that are down.  */
+static uint8_t navswitch_down;
+
+/* Non-zero if the switches are sampled by navswitch_scan.  */
+static bool navswitch_scanned;
+
+static uint8_t navswitch_repeat_mask;
+
+#define NAVSWITCH_POLLS(RATE, MS) \
+    ((uint16_t)(((uint32_t)(RATE) * (MS) + 500) / 1000))
+
+/* Debounce and hold times in polls.  */
+static uint8_t navswitch_debounce_polls
+    = NAVSWITCH_POLLS (NAVSWITCH_POLL_RATE, NAVSWITCH_DEBOUNCE_MS)
+    ? NAVSWITCH_POLLS (NAVSWITCH_POLL_RATE, NAVSWITCH_DEBOUNCE_MS) : 1;
+static uint16_t navswitch_long_push_polls
+    = NAVSWITCH_POLLS (NAVSWITCH_POLL_RATE, NAVSWITCH_LONG_PUSH_MS);
+static uint16_t navswitch_repeat_delay_polls
+    = NAVSWITCH_POLLS (NAVSWITCH_POLL_RATE, NAVSWITCH_REPEAT_DELAY_MS);
+static uint16_t navswitch_repeat_period_polls
+    = NAVSWITCH_POLLS (NAVSWITCH_POLL_RATE, NAVSWITCH_REPEAT_PERIOD_MS);
+
+static navswitch_event_t navswitch_queue[NAVSWITCH_EVENT_QUEUE_SIZE];
+static uint8_t navswitch_queue_head;
+static uint8_t navswitch_queue_tail;
+static uint16_t navswitch_queue_overruns;
+
 
 /** Return true if navswitch state changed from up to down since 
     last call to navswitch_update
@@ -86,11 +143,168 @@ navswitch_up_p (uint8_t navswitch)
 }
 
 
-/** Poll all the navswitches and update their state.  */
+/** Add an event to the queue; if the queue is full the event is
+    discarded so that the application sees the oldest events.  */
+static void
+navswitch_event_put (uint8_t type, uint8_t navswitch)
+{
+    navswitch_event_t *event;
+
+    if ((uint8_t)(navswitch_queue_head - navswitch_queue_tail)
+        >= NAVSWITCH_EVENT_QUEUE_SIZE)
+    {
+        navswitch_queue_overruns++;
+        return;
+    }
+
+    event = &navswitch_queue[navswitch_queue_head
+                             & (NAVSWITCH_EVENT_QUEUE_SIZE - 1)];
+    event->type = type;
+    event->navswitch = navswitch;
+    event->down = navswitch_down;
+    navswitch_queue_head++;
+}
+
+
+/** Get the oldest queued event.
+    @param  event pointer to structure to fill in
+    @return 1 if there was an event otherwise 0  */
+bool
+navswitch_event_get (navswitch_event_t *event)
+{
+    if (navswitch_queue_head == navswitch_queue_tail)
+        return 0;
+
+    *event = navswitch_queue[navswitch_queue_tail
+                             & (NAVSWITCH_EVENT_QUEUE_SIZE - 1)];
+    navswitch_queue_tail++;
+    return 1;
+}
+
+
+/** Return the number of events discarded since the queue was full.  */
+uint16_t
+navswitch_event_overruns_get (void)
+{
+    return navswitch_queue_overruns;
+}
+
+
+/** Select the navswitches that generate repeat events when held down.
+    @param  mask bitmask indexed by navswitch  */
 void
-navswitch_update (void)
+navswitch_repeat_set (uint8_t mask)
+{
+    navswitch_repeat_mask = mask;
+}
+
+
+/** Set the rate that navswitch_update is called at.
+    @param  rate poll rate (Hz)  */
+void
+navswitch_poll_rate_set (uint16_t rate)
+{
+    uint16_t debounce_polls;
+
+    /* The integrator is 8 bits and a switch must be down for at least
+       one poll.  */
+    debounce_polls = NAVSWITCH_POLLS (rate, NAVSWITCH_DEBOUNCE_MS);
+    if (!debounce_polls)
+        debounce_polls = 1;
+    if (debounce_polls > 255)
+        debounce_polls = 255;
+    navswitch_debounce_polls = debounce_polls;
+
+    navswitch_long_push_polls
+        = NAVSWITCH_POLLS (rate, NAVSWITCH_LONG_PUSH_MS);
+    navswitch_repeat_delay_polls
+        = NAVSWITCH_POLLS (rate, NAVSWITCH_REPEAT_DELAY_MS);
+    navswitch_repeat_period_polls
+        = NAVSWITCH_POLLS (rate, NAVSWITCH_REPEAT_PERIOD_MS);
+    if (!navswitch_repeat_period_polls)
+        navswitch_repeat_period_polls = 1;
+}
+
+
+/** Group the switch PIOs by port so that each port is accessed once.  */
+static void
+navswitch_groups_init (void)
+{
+    uint8_t i;
+    uint8_t g;
+
+    navswitch_groups_num = 0;
+    for (i = 0; i < NAVSWITCH_NUM; i++)
+    {
+        for (g = 0; g < navswitch_groups_num; g++)
+        {
+            if (NAVSWITCH_SAME_GROUP_P (navswitch_groups[g],
+                                        navswitch_cfg[i].pio))
+                break;
+        }
+        if (g == navswitch_groups_num)
+        {
+            navswitch_groups[g] = 0;
+            navswitch_groups_num++;
+        }
+        navswitch_groups[g] |= navswitch_cfg[i].pio;
+        navswitch_group[i] = g;
+    }
+}
+
+
+/** Debounce a sample of a switch and generate its events.  */
+static void
+navswitch_debounce (uint8_t i, bool down)
+{
+    navswitch_state_t *state = &navswitch_state[i];
+    bool current = (navswitch_down & BIT (i)) != 0;
+
+    if (down)
+    {
+        if (state->integrator < navswitch_debounce_polls)
+            state->integrator++;
+    }
+    else if (state->integrator)
+        state->integrator--;
+
+    if (state->integrator >= navswitch_debounce_polls && !current)
+    {
+        state->held = 0;
+        navswitch_down |= BIT (i);
+        navswitch_event_put (NAVSWITCH_EVENT_PUSH, i);
+        if (navswitch_down != BIT (i))
+            navswitch_event_put (NAVSWITCH_EVENT_CHORD, i);
+    }
+    else if (state->integrator == 0 && current)
+    {
+        navswitch_down &= ~BIT (i);
+        navswitch_event_put (NAVSWITCH_EVENT_RELEASE, i);
+    }
+    else if (current && state->held < 0xffff)
+    {
+        state->held++;
+
+        if (state->held == navswitch_long_push_polls)
+            navswitch_event_put (NAVSWITCH_EVENT_LONG_PUSH, i);
+
+        if ((navswitch_repeat_mask & BIT (i))
+            && state->held >= navswitch_repeat_delay_polls
+            && (state->held - navswitch_repeat_delay_polls)
+            % navswitch_repeat_period_polls == 0)
+            navswitch_event_put (NAVSWITCH_EVENT_REPEAT, i);
+    }
+}
+
+
+/** Read the switches, borrowing the PIOs from the LED matrix.  */
+static void
+navswitch_sample (void)
 {
+    uint16_t config[NAVSWITCH_NUM];
+    uint8_t input[NAVSWITCH_NUM];
     uint8_t i;
+    uint8_t g;
 
     /* The switch is a 5-way navigation switch with push.  The common
        connection is connected to ground.  The 5 switch outputs share
@@ -106,33 +320,100 @@ navswitch_update (void)
        display.  This can be avoided by driving all the LED matrix
        rows low while we read the switches.  */
 
+    /* The switches are read all at once with one PIO group per port
+       rather than one at a time, so there is a single delay.  */
+
+    for (g = 0; g < navswitch_groups_num; g++)
+    {
+        config[g] = navswitch_group_config_save (navswitch_groups[g]);
+
+        /* Momentarily force PIO pins high to charge gate capacitance
+           of MOSFETs otherwise will always read logic low and think
+           the switches are pushed.  Alternatively, we need to wait 10
+           us or more so that the gate capacitance of the MOSFETs
+           charge via the internal pullup resistors.  */
+        pio_config_set (navswitch_groups[g], PIO_OUTPUT_HIGH);
+    }
+
+    /* Switch PIOs to inputs to read switches.  */
+    for (g = 0; g < navswitch_groups_num; g++)
+        pio_config_set (navswitch_groups[g], PIO_PULLUP);
+
+    /* Wait long enough for MOSFET gate capacitance to discharge
+       through 2.2 kohm resistor when switch is pushed (connected to
+       ground).  */
+    DELAY_US (2.5); 
+
+    for (g = 0; g < navswitch_groups_num; g++)
+        input[g] = navswitch_group_input_get (navswitch_groups[g]);
+
+    /* Restore PIO state.  */
+    for (g = 0; g < navswitch_groups_num; g++)
+        navswitch_group_config_restore (navswitch_groups[g], config[g]);
+
     for (i = 0; i < NAVSWITCH_NUM; i++)
     {
-        pio_config_t config;
+        navswitch_debounce (i, (input[navswitch_group[i]]
+                                & navswitch_bitmask_get (navswitch_cfg[i].pio))
+                            == 0);
+    }
+}
 
-        navswitch_state[i].previous = navswitch_state[i].current;
-    
-        config = pio_config_get (navswitch_cfg[i].pio);
 
-        /* Momentarily force PIO pin high to charge gate capacitance of
-           MOSFET otherwise will always read logic low and think the
-           switch is pushed.  Alternatively, we need to wait 10 us or
-           more so that the gate capacitance of the MOSFET charges via
-           the internal pullup resistor.  */
-        pio_config_set (navswitch_cfg[i].pio, PIO_OUTPUT_HIGH);
+/** Read the switches while the LED matrix is blanked.  */
+void
+navswitch_scan (void)
+{
+    uint8_t input[NAVSWITCH_NUM];
+    uint8_t i;
+    uint8_t g;
+
+    /* The columns are all high outputs when the display is blanked,
+       so the MOSFET gates are already charged and it is only
+       necessary to switch to inputs with pullups to read the
+       switches.  Since the rows are off there is no ghosting.  */
+    navswitch_scanned = 1;
 
-        /* Switch PIO to an input to read switch.  */
-        pio_config_set (navswitch_cfg[i].pio, PIO_PULLUP);
+    if (!navswitch_groups_num)
+        navswitch_groups_init ();
 
-        /* Wait long enough for MOSFET gate capacitance to discharge
-           through 2.2 kohm resistor when switch is pushed (connected
-           to ground).  */
-        DELAY_US (2.5); 
+    for (g = 0; g < navswitch_groups_num; g++)
+        pio_config_set (navswitch_groups[g], PIO_PULLUP);
+
+    DELAY_US (2.5);
+
+    for (g = 0; g < navswitch_groups_num; g++)
+    {
+        input[g] = navswitch_group_input_get (navswitch_groups[g]);
+        pio_config_set (navswitch_groups[g], PIO_OUTPUT_HIGH);
+    }
+
+    for (i = 0; i < NAVSWITCH_NUM; i++)
+    {
+        navswitch_debounce (i, (input[navswitch_group[i]]
+                                & navswitch_bitmask_get (navswitch_cfg[i].pio))
+                            == 0);
+    }
+}
 
-        navswitch_state[i].current = pio_input_get (navswitch_cfg[i].pio) == 0;
 
-        /* Restore PIO state.  */
-        pio_config_set (navswitch_cfg[i].pio, config);
+/** Poll all the navswitches and update their state.  */
+void
+navswitch_update (void)
+{
+    uint8_t i;
+
+    if (!navswitch_scanned)
+    {
+        if (!navswitch_groups_num)
+            navswitch_groups_init ();
+        navswitch_sample ();
+    }
+
+    for (i = 0; i < NAVSWITCH_NUM; i++)
+    {
+        navswitch_state[i].previous = navswitch_state[i].current;
+        navswitch_state[i].current = (navswitch_down & BIT (i)) != 0;
     }
 }
 
@@ -140,5 +421,7 @@ navswitch_update (void)
 /** Initialise navswitch driver.  */
 void navswitch_init (void)
 {
-    /* Nothing to do since we configure PIOs when polling the switch.  */
+    /* The PIOs are configured when polling the switch.  */
+    navswitch_groups_init ();
+    navswitch_poll_rate_set (NAVSWITCH_POLL_RATE);
 }
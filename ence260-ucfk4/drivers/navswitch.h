@@ -1,12 +1,17 @@
 /**  @file   navswitch.h
      @author M. P. Hayes, UCECE
      @date   15 Feb 2003
-     @brief  Navswitch polling (no debouncing).
+     @brief  Navswitch polling with debouncing and events.
 
      @defgroup navswitch Navswitch driver
        
-     This module implements a simple navswitch driver.  Note, no
-     debouncing is performed.
+     This module implements a navswitch driver.  Each switch is
+     debounced with an integrator that counts up each poll that the
+     switch is down and down each poll that it is up; the switch is
+     only considered pushed when the count reaches the number of polls
+     in NAVSWITCH_DEBOUNCE_MS, or one if that is less, and released
+     when it returns to zero.  A push shorter than this is ignored;
+     with the defaults a bounce lasting a single poll is filtered out.
 
      Here's an example application where the navswitches are polled at 50 Hz:
 
@@ -33,6 +38,46 @@
         }
     }
     @endcode
+
+    The push and release events are only seen for one call of
+    navswitch_update, so a push can be missed if the application does
+    not check after every call.  Alternatively, the driver puts each
+    event in a queue so that navswitch_update can be called from a
+    fast task while the application reads the events at its leisure:
+
+    @code
+    navswitch_event_t event;
+
+    while (navswitch_event_get (&event))
+    {
+        if (event.type == NAVSWITCH_EVENT_PUSH
+            && event.navswitch == NAVSWITCH_EAST)
+            // Do something
+    }
+    @endcode
+
+    As well as push and release events, there is a long push event when
+    a switch has been held down for NAVSWITCH_LONG_PUSH_MS, repeat
+    events while a switch selected with navswitch_repeat_set is held
+    down, and a chord event when a switch is pushed while others are
+    down.  The timing, including the debounce, assumes that navswitch_update is called at
+    NAVSWITCH_POLL_RATE unless navswitch_poll_rate_set says otherwise.
+
+    The navswitch shares its pins with the LED matrix columns so
+    navswitch_update has to borrow them, which can cause ghosting.
+    Instead, the switches can be read by the LED matrix driver while
+    the display is blanked at the start of each refresh cycle:
+
+    @code
+    display_init ();
+    navswitch_init ();
+    ledmat_blank_hook_set (navswitch_scan);
+    // display_update is called at DISPLAY_TASK_RATE.
+    navswitch_poll_rate_set (DISPLAY_TASK_RATE / LEDMAT_COLS_NUM);
+    @endcode
+
+    navswitch_update then only updates the state seen by the
+    navswitch_push_event_p family of functions.
 */
 
 
@@ -46,10 +91,81 @@ enum {NAVSWITCH_NORTH, NAVSWITCH_EAST, NAVSWITCH_SOUTH, NAVSWITCH_WEST,
       NAVSWITCH_PUSH};
 
 
+/** Time a switch must be down to be pushed (ms).  */
+#ifndef NAVSWITCH_DEBOUNCE_MS
+#define NAVSWITCH_DEBOUNCE_MS 20
+#endif
+
+
+/** Rate that navswitch_update is assumed to be called at (Hz).  */
+#ifndef NAVSWITCH_POLL_RATE
+#define NAVSWITCH_POLL_RATE 100
+#endif
+
+
+/** Time a switch is held down for a long push event (ms).  */
+#ifndef NAVSWITCH_LONG_PUSH_MS
+#define NAVSWITCH_LONG_PUSH_MS 1000
+#endif
+
+
+/** Time a switch is held down before it repeats (ms).  */
+#ifndef NAVSWITCH_REPEAT_DELAY_MS
+#define NAVSWITCH_REPEAT_DELAY_MS 500
+#endif
+
+
+/** Time between repeats (ms).  */
+#ifndef NAVSWITCH_REPEAT_PERIOD_MS
+#define NAVSWITCH_REPEAT_PERIOD_MS 100
+#endif
+
+
+/** Number of events that can be queued; this must be a power of 2.  */
+#ifndef NAVSWITCH_EVENT_QUEUE_SIZE
+#define NAVSWITCH_EVENT_QUEUE_SIZE 8
+#endif
+
+
+typedef enum
+{
+    /** Switch pushed.  */
+    NAVSWITCH_EVENT_PUSH,
+    /** Switch released.  */
+    NAVSWITCH_EVENT_RELEASE,
+    /** Switch held down for NAVSWITCH_LONG_PUSH_MS.  */
+    NAVSWITCH_EVENT_LONG_PUSH,
+    /** Switch still held down; see navswitch_repeat_set.  */
+    NAVSWITCH_EVENT_REPEAT,
+    /** Switch pushed while others are down; this follows the push
+        event.  */
+    NAVSWITCH_EVENT_CHORD
+} navswitch_event_type_t;
+
+
+typedef struct
+{
+    /** Type of event, see navswitch_event_type_t.  */
+    uint8_t type;
+    /** Index of the navswitch.  */
+    uint8_t navswitch;
+    /** Bitmask, indexed by navswitch, of the switches that are down.
+        This is most useful for a chord event.  */
+    uint8_t down;
+} navswitch_event_t;
+
+
 /** Poll all the navswitches and update their state.  */
 void navswitch_update (void);
 
 
+/** Read the navswitches while the LED matrix is blanked, with all the
+    columns high outputs and all the rows off.  This is for use with
+    ledmat_blank_hook_set; once it is called, navswitch_update no
+    longer reads the switches itself.  */
+void navswitch_scan (void);
+
+
 /** Return true if navswitch state changed from up to down since 
     last call to navswitch_update
     @param  navswitch index of navswitch to select
@@ -76,6 +192,28 @@ bool navswitch_down_p (uint8_t navswitch);
 bool navswitch_up_p (uint8_t navswitch);
 
 
+/** Get the oldest queued event.
+    @param  event pointer to structure to fill in
+    @return 1 if there was an event otherwise 0  */
+bool navswitch_event_get (navswitch_event_t *event);
+
+
+/** Return the number of events discarded since the queue was full.  */
+uint16_t navswitch_event_overruns_get (void);
+
+
+/** Select the navswitches that generate repeat events when held down.
+    @param  mask bitmask indexed by navswitch, for example
+    BIT (NAVSWITCH_EAST) | BIT (NAVSWITCH_WEST)  */
+void navswitch_repeat_set (uint8_t mask);
+
+
+/** Set the rate that navswitch_update is called at.  This is only
+    needed for the debounce, long push, and repeat times.
+    @param  rate poll rate (Hz)  */
+void navswitch_poll_rate_set (uint16_t rate);
+
+
 /** Initialise navswitch driver.  */
 void navswitch_init (void);
 #endif
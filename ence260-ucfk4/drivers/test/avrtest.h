@@ -1,3 +1,33 @@
+/** @file   avrtest.h
+    @author agent
+    @date   19 October 2026
+    @brief  Model of the AVR special function registers for the test
+            scaffold.
+
+    @note The registers used by the drivers are kept in the structure
+    SFR.  The PORT, DDR, and PIN registers of each port must be in the
+    same order and equally spaced since the pio module finds them from
+    the address of PORTB.  16 bit registers, such as TCNT1, are single
+    fields.
+
+    Drivers access the registers with AVRTEST_READ and AVRTEST_WRITE
+    (or the register names directly).  If the scaffold is compiled with
+    AVRTEST_TRACE defined to 1, for example, with
+
+    make -f Makefile.test CC="gcc -DAVRTEST_TRACE=1"
+
+    each access through these macros is counted for each register and
+    the non-zero counts are printed to stderr at exit.  The number of
+    accesses is a rough proxy for the cost on the AVR.  If the
+    environment variable UCFK4_SFR_TRACE names a file, each access is
+    also written to the file as a line
+
+    tick R|W register value
+
+    where tick counts the scaffold updates.  The scaffold's own
+    accesses, such as to drive the inputs or to read the LED states
+    for the display, are not counted.
+*/
 #ifndef AVRTEST_H
 #define AVRTEST_H
 
@@ -14,6 +44,38 @@ typedef struct SFR
     uint8_t PORTD;
     uint8_t DDRD;
     uint8_t PIND;
+
+    /* Timer/counter 0.  */
+    uint8_t TCCR0A;
+    uint8_t TCCR0B;
+    uint8_t TCNT0;
+    uint8_t OCR0A;
+    uint8_t OCR0B;
+    uint8_t TIMSK0;
+    uint8_t TIFR0;
+
+    /* Timer/counter 1.  */
+    uint8_t TCCR1A;
+    uint8_t TCCR1B;
+    uint8_t TCCR1C;
+    uint16_t TCNT1;
+    uint16_t OCR1A;
+    uint16_t OCR1B;
+    uint16_t ICR1;
+    uint8_t TIMSK1;
+    uint8_t TIFR1;
+
+    /* USART1.  */
+    uint8_t UCSR1A;
+    uint8_t UCSR1B;
+    uint8_t UCSR1C;
+    uint16_t UBRR1;
+    uint8_t UDR1;
+
+    /* EEPROM.  */
+    uint8_t EECR;
+    uint8_t EEDR;
+    uint16_t EEAR;
 } SFR_t;
 
 
@@ -25,9 +87,87 @@ typedef struct SFR
 #define DDRD SFR.DDRD
 #define PINB SFR.PINB
 #define PINC SFR.PINC
-#define PIND SFR.PINC
+#define PIND SFR.PIND
+
+#define TCCR0A SFR.TCCR0A
+#define TCCR0B SFR.TCCR0B
+#define TCNT0 SFR.TCNT0
+#define OCR0A SFR.OCR0A
+#define OCR0B SFR.OCR0B
+#define TIMSK0 SFR.TIMSK0
+#define TIFR0 SFR.TIFR0
+
+#define TCCR1A SFR.TCCR1A
+#define TCCR1B SFR.TCCR1B
+#define TCCR1C SFR.TCCR1C
+#define TCNT1 SFR.TCNT1
+#define OCR1A SFR.OCR1A
+#define OCR1B SFR.OCR1B
+#define ICR1 SFR.ICR1
+#define TIMSK1 SFR.TIMSK1
+#define TIFR1 SFR.TIFR1
+
+#define UCSR1A SFR.UCSR1A
+#define UCSR1B SFR.UCSR1B
+#define UCSR1C SFR.UCSR1C
+#define UBRR1 SFR.UBRR1
+#define UDR1 SFR.UDR1
+
+#define EECR SFR.EECR
+#define EEDR SFR.EEDR
+#define EEAR SFR.EEAR
+
+/* Bits of UCSR1A.  */
+#define RXC1 7
+#define TXC1 6
+#define UDRE1 5
+#define FE1 4
+#define DOR1 3
+
+/* Bits of EECR.  */
+#define EERIE 3
+#define EEMPE 2
+#define EEPE 1
+#define EERE 0
 
 extern SFR_t SFR;
 
 
+#ifndef AVRTEST_TRACE
+#define AVRTEST_TRACE 0
+#endif
+
+
+/** Total number of register accesses.  */
+typedef struct avrtest_accesses_struct
+{
+    uint32_t reads;
+    uint32_t writes;
+} avrtest_accesses_t;
+
+
+#if AVRTEST_TRACE
+#define AVRTEST_READ(REG) \
+    ((__typeof__ (REG)) avrtest_read (&(REG), sizeof (REG)))
+#define AVRTEST_WRITE(REG, VALUE) \
+    avrtest_write (&(REG), sizeof (REG), (VALUE))
+#else
+#define AVRTEST_READ(REG) (REG)
+#define AVRTEST_WRITE(REG, VALUE) ((REG) = (VALUE))
+#endif
+
+
+/** Read a register, counting the access.  Use AVRTEST_READ.  */
+uint16_t avrtest_read (const volatile void *reg, uint8_t size);
+
+
+/** Write a register, counting the access.  Use AVRTEST_WRITE.  */
+void avrtest_write (volatile void *reg, uint8_t size, uint16_t value);
+
+
+/** Return the total number of register accesses so far.  The
+    difference before and after a driver call gives its cost.  This
+    is zero unless compiled with AVRTEST_TRACE.  */
+avrtest_accesses_t avrtest_accesses_get (void);
+
 #endif
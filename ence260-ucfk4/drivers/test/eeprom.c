@@ -5,6 +5,7 @@
 */
 #include "system.h"
 #include "eeprom.h"
+#include "avrtest.h"
 #include <stdio.h>
 #include <string.h>
 
@@ -13,6 +14,28 @@
 #define EEPROM_FILENAME "ucfk_eeprom.dat"
 
 
+/* Access the EEPROM registers for a byte as the AVR driver does so
+   that the accesses can be counted, see avrtest.h.  */
+static void
+eeprom_sfr_access (eeprom_addr_t addr, uint8_t data, bool write)
+{
+    (void) AVRTEST_READ (EECR);
+    AVRTEST_WRITE (EEAR, addr);
+    if (write)
+    {
+        AVRTEST_WRITE (EEDR, data);
+        AVRTEST_WRITE (EECR, BIT (EEMPE));
+        AVRTEST_WRITE (EECR, BIT (EEMPE) | BIT (EEPE));
+    }
+    else
+    {
+        AVRTEST_WRITE (EECR, BIT (EERE));
+        EEDR = data;
+        (void) AVRTEST_READ (EEDR);
+    }
+}
+
+
 static void
 eeprom_file_write (void *buffer, eeprom_size_t size)
 {
@@ -59,7 +82,10 @@ eeprom_read (eeprom_addr_t addr, void *buffer, eeprom_size_t size)
     eeprom_file_read (eeprom, EEPROM_SIZE);
 
     for (i = 0; i < size && addr < EEPROM_SIZE; i++)
+    {
+        eeprom_sfr_access (addr, eeprom[addr], 0);
         data[i] = eeprom[addr++];
+    }
 
     return i;
 
@@ -77,7 +103,10 @@ eeprom_write (eeprom_addr_t addr, const void *buffer, eeprom_size_t size)
     eeprom_file_read (eeprom, EEPROM_SIZE);
 
     for (i = 0; i < size && addr < EEPROM_SIZE; i++)
+    {
+        eeprom_sfr_access (addr, data[i], 1);
         eeprom[addr++] = data[i];
+    }
 
     eeprom_file_write (eeprom, EEPROM_SIZE);
 
@@ -0,0 +1,35 @@
+/** @file   ir_capture.c
+    @author agent
+    @date   19 October 2026
+    @brief  IR receiver edge capture for the test scaffold.
+*/
+#include "system.h"
+#include "ir_capture.h"
+
+
+static ir_capture_handler_t ir_capture_handler;
+static bool ir_capture_enabled;
+
+
+void
+ir_capture_edge (uint8_t state, timer_tick_t when)
+{
+    if (ir_capture_enabled && ir_capture_handler)
+        ir_capture_handler (state, when);
+}
+
+
+void
+ir_capture_enable (bool enable)
+{
+    ir_capture_enabled = enable;
+}
+
+
+void
+ir_capture_init (ir_capture_handler_t handler)
+{
+    ir_capture_handler = handler;
+    timer_init ();
+    ir_capture_enable (1);
+}
@@ -0,0 +1,32 @@
+/** @file   ir_capture.h
+    @author agent
+    @date   19 October 2026
+    @brief  IR receiver edge capture for the test scaffold.
+
+    There is no IR receiver in the test scaffold so edges are injected
+    with ir_capture_edge, for example, to replay a recorded trace.
+*/
+
+#ifndef IR_CAPTURE_H
+#define IR_CAPTURE_H
+
+#include "system.h"
+#include "timer.h"
+
+
+/* Handler called for each edge.  */
+typedef void (*ir_capture_handler_t) (uint8_t state, timer_tick_t when);
+
+
+/* Simulate an edge; this calls the handler if capture is enabled.  */
+void ir_capture_edge (uint8_t state, timer_tick_t when);
+
+
+/* Enable or disable the edge capture.  */
+void ir_capture_enable (bool enable);
+
+
+/* Initialise IR receiver edge capture.  */
+void ir_capture_init (ir_capture_handler_t handler);
+
+#endif
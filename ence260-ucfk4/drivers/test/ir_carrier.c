@@ -0,0 +1,31 @@
+/** @file   ir_carrier.c
+    @author agent
+    @date   19 October 2026
+    @brief  IR transmitter carrier gating for the test scaffold.
+*/
+#include "system.h"
+#include "ir_carrier.h"
+
+
+static bool ir_carrier_state;
+
+
+void
+ir_carrier_set (bool state)
+{
+    ir_carrier_state = state;
+}
+
+
+bool
+ir_carrier_get (void)
+{
+    return ir_carrier_state;
+}
+
+
+void
+ir_carrier_init (void)
+{
+    ir_carrier_set (0);
+}
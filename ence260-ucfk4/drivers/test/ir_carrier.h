@@ -0,0 +1,24 @@
+/** @file   ir_carrier.h
+    @author agent
+    @date   19 October 2026
+    @brief  IR transmitter carrier gating for the test scaffold.
+*/
+
+#ifndef IR_CARRIER_H
+#define IR_CARRIER_H
+
+#include "system.h"
+
+
+/* Turn the carrier on or off.  */
+void ir_carrier_set (bool state);
+
+
+/* Return the carrier state.  */
+bool ir_carrier_get (void);
+
+
+/* Initialise carrier.  The carrier is off.  */
+void ir_carrier_init (void);
+
+#endif
@@ -1,17 +1,540 @@
 /** @file   ir_uart.c
     @author M. P. Hayes, UCECE
     @date   1 Aug 2011
-    @brief  This is just a stub that does nothing.
+    @brief  Simulated IR UART for the test scaffold.
+
+    @note This connects test scaffold processes on the same computer
+    through an IR medium modelled with UNIX datagram sockets.  Each
+    process binds the first free node address for the link and every
+    transmitted character is sent to all the other nodes.  The
+    characters are paced at the baud rate and are delayed, lost,
+    corrupted, or echoed as configured by the environment variables:
+
+    UCFK4_IR_LINK     name of link (default ucfk4)
+    UCFK4_IR_BAUD     baud rate (default IR_UART_BAUD_RATE)
+    UCFK4_IR_LATENCY  extra delay in seconds (default 0)
+    UCFK4_IR_LOSS     probability of a character being lost (default 0)
+    UCFK4_IR_FLIP     probability of each bit being flipped (default 0)
+    UCFK4_IR_ECHO     probability of receiving our own character (default 0)
+    UCFK4_IR_COLLIDE  non-zero to model collisions (default 0)
+    UCFK4_IR_SEED     random number seed (default process id)
+    UCFK4_IR_BAUD_MAX fastest rate the receiver can manage
+                      (default larger of UCFK4_IR_BAUD and IR_UART_BAUD_MAX)
+
+    A character is received as a framing error if it was sent at a
+    different baud rate to the one the receiver is using or at a rate
+    faster than UCFK4_IR_BAUD_MAX.  This allows the adaptive baud rate
+    of ir_uart_baud to be tested.
+
+    Echoes of our own characters that arrive while this node is
+    transmitting, or within the echo guard time after, are discarded
+    as the AVR driver does, so only late echoes get through.  When
+    collisions are modelled, characters from different nodes that
+    overlap in time are both discarded as framing errors and
+    characters from other nodes that arrive while this node is
+    transmitting are discarded as echoes.  Otherwise every character
+    is received as if each pair of nodes had its own link.
+
+    The USART1 registers are accessed as the interrupt handlers of the
+    AVR driver would so that their accesses can be counted, see
+    avrtest.h.
 */
 #include "system.h"
 #include "ir_uart.h"
+#include "avrtest.h"
+#include "timer.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+
+/* Maximum number of processes sharing a link.  */
+#define IR_UART_SIM_NODES 8
+
+/* Number of characters in flight to this node.  */
+#define IR_UART_SIM_QUEUE_SIZE 256
+
+/* Size of transmit buffer; this matches the AVR driver.  */
+#define IR_UART_SIM_TX_BUFFER_SIZE 16
+
+/* Start bit, 8 data bits, and stop bit.  */
+#define IR_UART_SIM_FRAME_BITS 10
+
+/* Time (us) after transmitting that echoes are ignored; this matches
+   IR_UART_ECHO_GUARD_TICKS in the AVR driver.  */
+#define IR_UART_SIM_ECHO_GUARD_US 500
+
+/* Number of attempts, 100 us apart, to send a character to a node
+   whose socket queue is full.  */
+#define IR_UART_SIM_SEND_TRIES 100
+
+
+/* This is what is sent over the socket for each character.  */
+typedef struct
+{
+    /* Time (us) that the character is received.  */
+    uint64_t when;
+    /* Baud rate that the character is sent at.  */
+    uint32_t baud;
+    uint8_t node;
+    uint8_t ch;
+    /* Non-zero if overlapped by a character from another node.  */
+    uint8_t collided;
+} ir_uart_sim_msg_t;
+
+
+typedef struct
+{
+    int fd;
+    int node;
+    char link[32];
+    double baud;
+    double baud_max;
+    double latency;
+    double loss;
+    double flip;
+    double echo;
+    bool collide;
+    unsigned int seed;
+    /* Time (us) that the transmitter started and finishes sending.  */
+    uint64_t tx_start;
+    uint64_t tx_busy;
+    ir_uart_sim_msg_t queue[IR_UART_SIM_QUEUE_SIZE];
+    unsigned int queue_head;
+    unsigned int queue_tail;
+    /* Time (us) that the last character read was received.  */
+    uint64_t rx_when;
+} ir_uart_sim_t;
+
+
+static ir_uart_sim_t sim = {.fd = -1};
+
+static ir_uart_stats_t ir_uart_stats;
+
+static const char * const ir_uart_stats_names[] =
+{
+    "tx_bytes", "rx_bytes", "echo_drops", "framing_errors",
+    "overrun_errors", "rx_drops"
+};
+
+
+static uint64_t
+ir_uart_sim_now (void)
+{
+    return system_time_us ();
+}
+
+
+static double
+ir_uart_sim_param (const char *name, double def)
+{
+    const char *str;
+
+    str = system_getenv (name);
+    if (!str || !*str)
+        return def;
+    return atof (str);
+}
+
+
+static bool
+ir_uart_sim_chance (double probability)
+{
+    if (probability <= 0)
+        return 0;
+    return rand_r (&sim.seed) < probability * ((double)RAND_MAX + 1);
+}
+
+
+static socklen_t
+ir_uart_sim_addr (struct sockaddr_un *addr, int node)
+{
+    int len;
+
+    /* Use the Linux abstract namespace so that nothing needs to be
+       cleaned up when a process dies.  */
+    memset (addr, 0, sizeof (*addr));
+    addr->sun_family = AF_UNIX;
+    len = snprintf (addr->sun_path + 1, sizeof (addr->sun_path) - 1,
+                    "ucfk4-ir-%s-%d", sim.link, node);
+    return offsetof (struct sockaddr_un, sun_path) + 1 + len;
+}
+
+
+/* Return the duration (us) of a character.  */
+static double
+ir_uart_sim_frame_us (void)
+{
+    return IR_UART_SIM_FRAME_BITS * 1e6 / sim.baud;
+}
+
+
+/* Return non-zero if two characters overlap in time.  */
+static bool
+ir_uart_sim_overlap_p (uint64_t when1, uint64_t when2)
+{
+    uint64_t diff;
+
+    diff = when1 > when2 ? when1 - when2 : when2 - when1;
+    return diff < ir_uart_sim_frame_us ();
+}
+
+
+static void
+ir_uart_sim_enqueue (ir_uart_sim_msg_t *msg)
+{
+    unsigned int i;
+
+    if (sim.queue_head - sim.queue_tail >= IR_UART_SIM_QUEUE_SIZE)
+    {
+        ir_uart_stats.rx_drops++;
+        return;
+    }
+
+    /* A character that overlaps one from another node will still be
+       in the queue since the sender sends each character as it
+       starts.  */
+    if (sim.collide)
+    {
+        for (i = sim.queue_tail; i != sim.queue_head; i++)
+        {
+            ir_uart_sim_msg_t *other;
+
+            other = &sim.queue[i % IR_UART_SIM_QUEUE_SIZE];
+            if (other->node != msg->node
+                && ir_uart_sim_overlap_p (other->when, msg->when))
+                other->collided = msg->collided = 1;
+        }
+    }
+
+    sim.queue[sim.queue_head % IR_UART_SIM_QUEUE_SIZE] = *msg;
+    sim.queue_head++;
+}
+
+
+/* Pass a character through the channel.  */
+static void
+ir_uart_sim_receive (ir_uart_sim_msg_t *msg)
+{
+    int bit;
+
+    if (ir_uart_sim_chance (sim.loss))
+        return;
+
+    for (bit = 0; bit < 8; bit++)
+    {
+        if (ir_uart_sim_chance (sim.flip))
+            msg->ch ^= BIT (bit);
+    }
+    ir_uart_sim_enqueue (msg);
+}
+
+
+/* Collect characters sent by the other nodes.  */
+static void
+ir_uart_sim_poll (void)
+{
+    ir_uart_sim_msg_t msg;
+
+    if (sim.fd < 0)
+        return;
+
+    while (recv (sim.fd, &msg, sizeof (msg), 0) == sizeof (msg))
+        ir_uart_sim_receive (&msg);
+}
+
+
+/* Send character to all the other nodes.  */
+static void
+ir_uart_sim_send (uint8_t ch)
+{
+    ir_uart_sim_msg_t msg;
+    struct sockaddr_un addr;
+    socklen_t addrlen;
+    uint64_t now;
+    int node;
+    int tries;
+
+    now = ir_uart_sim_now ();
+    if (sim.tx_busy < now)
+        sim.tx_busy = sim.tx_start = now;
+    sim.tx_busy += ir_uart_sim_frame_us ();
+
+    ir_uart_stats.tx_bytes++;
+    AVRTEST_WRITE (UDR1, ch);
+
+    msg.when = sim.tx_busy + sim.latency * 1e6;
+    msg.baud = sim.baud;
+    msg.node = sim.node;
+    msg.ch = ch;
+    msg.collided = 0;
+
+    /* The echo is subject to the same impairments; copy the message
+       since they modify it.  */
+    if (ir_uart_sim_chance (sim.echo))
+    {
+        ir_uart_sim_msg_t echo = msg;
+
+        ir_uart_sim_receive (&echo);
+    }
+
+    if (sim.fd < 0)
+        return;
+
+    for (node = 0; node < IR_UART_SIM_NODES; node++)
+    {
+        if (node == sim.node)
+            continue;
+
+        /* This fails if no process is using the node address.  */
+        addrlen = ir_uart_sim_addr (&addr, node);
+        for (tries = 0; tries < IR_UART_SIM_SEND_TRIES; tries++)
+        {
+            if (sendto (sim.fd, &msg, sizeof (msg), MSG_DONTWAIT,
+                        (struct sockaddr *)&addr, addrlen) >= 0
+                || errno != EAGAIN)
+                break;
+
+            /* The socket queue of the other node is full since it
+               only holds a few datagrams.  Drain our own queue in
+               case the other node is also waiting for us.  */
+            ir_uart_sim_poll ();
+            system_sleep_us (100);
+        }
+    }
+}
+
+
+/* Return non-zero if a received character has to be discarded.  */
+static bool
+ir_uart_sim_discard_p (const ir_uart_sim_msg_t *msg)
+{
+    if (msg->baud != (uint32_t)sim.baud || msg->baud > sim.baud_max)
+    {
+        ir_uart_stats.framing_errors++;
+        return 1;
+    }
+
+    /* The AVR driver ignores the receiver while transmitting and for
+       a short while after.  */
+    if (msg->node == sim.node
+        && msg->when >= sim.tx_start
+        && msg->when <= sim.tx_busy + IR_UART_SIM_ECHO_GUARD_US)
+    {
+        ir_uart_stats.echo_drops++;
+        return 1;
+    }
+
+    if (!sim.collide)
+        return 0;
+
+    if (msg->collided)
+    {
+        ir_uart_stats.framing_errors++;
+        return 1;
+    }
+
+    /* A character from another node that overlaps our own
+       transmission is swamped by the echo.  */
+    if (msg->node != sim.node
+        && msg->when > sim.tx_start
+        && msg->when < sim.tx_busy + ir_uart_sim_frame_us ())
+    {
+        ir_uart_stats.echo_drops++;
+        return 1;
+    }
+    return 0;
+}
+
+
+/* Return non-zero if there is a character ready to be read.  */
+static bool
+ir_uart_sim_read_ready_p (void)
+{
+    uint64_t now;
+    ir_uart_sim_msg_t *msg;
+
+    ir_uart_sim_poll ();
+
+    now = ir_uart_sim_now ();
+    while (sim.queue_head != sim.queue_tail)
+    {
+        msg = &sim.queue[sim.queue_tail % IR_UART_SIM_QUEUE_SIZE];
+        if (msg->when > now)
+            return 0;
+        if (!ir_uart_sim_discard_p (msg))
+            return 1;
+        sim.queue_tail++;
+    }
+    return 0;
+}
+
+
+/* Read up to size characters without blocking.  */
+static uint8_t
+ir_uart_sim_read (void *data, uint8_t size)
+{
+    uint8_t *dst = data;
+    uint8_t count;
+
+    for (count = 0; count < size && ir_uart_sim_read_ready_p (); count++)
+    {
+        UDR1 = sim.queue[sim.queue_tail % IR_UART_SIM_QUEUE_SIZE].ch;
+        (void) AVRTEST_READ (UCSR1A);
+        *dst++ = AVRTEST_READ (UDR1);
+        sim.rx_when = sim.queue[sim.queue_tail % IR_UART_SIM_QUEUE_SIZE].when;
+        sim.queue_tail++;
+        ir_uart_stats.rx_bytes++;
+    }
+    return count;
+}
+
+
+/* Return the time that the last character read was received.  */
+static timer_tick_t
+ir_uart_sim_rx_time_get (void)
+{
+    timer_tick_t now;
+    uint64_t age;
+
+    /* The timer is read first since it can advance the virtual
+       clock.  */
+    now = timer_get ();
+    age = ir_uart_sim_now () - sim.rx_when;
+    return now - (timer_tick_t)(age * TIMER_RATE / 1000000);
+}
+
+
+/* Return non-zero if a character can be written without blocking.  */
+static bool
+ir_uart_sim_write_ready_p (void)
+{
+    uint64_t now;
+
+    now = ir_uart_sim_now ();
+    return sim.tx_busy < now + IR_UART_SIM_TX_BUFFER_SIZE
+        * IR_UART_SIM_FRAME_BITS * 1e6 / sim.baud;
+}
+
+
+/* Return non-zero if transmitter finished.  */
+static bool
+ir_uart_sim_write_finished_p (void)
+{
+    return sim.tx_busy <= ir_uart_sim_now ();
+}
+
+
+/* Write up to size characters without blocking.  */
+static uint8_t
+ir_uart_sim_write (const void *data, uint8_t size)
+{
+    const uint8_t *src = data;
+    uint8_t count;
+
+    for (count = 0; count < size && ir_uart_sim_write_ready_p (); count++)
+        ir_uart_sim_send (*src++);
+    return count;
+}
+
+
+#if IR_UART_BAUD_ADAPT
+/* These are for the rate negotiation, which sits between the
+   application and the simulated link.  */
+
+uint8_t
+ir_uart_raw_read (void *data, uint8_t size)
+{
+    return ir_uart_sim_read (data, size);
+}
+
+
+timer_tick_t
+ir_uart_raw_rx_time_get (void)
+{
+    return ir_uart_sim_rx_time_get ();
+}
+
+
+uint8_t
+ir_uart_raw_write (const void *data, uint8_t size)
+{
+    return ir_uart_sim_write (data, size);
+}
+
+
+bool
+ir_uart_raw_write_finished_p (void)
+{
+    return ir_uart_sim_write_finished_p ();
+}
+
+
+void
+ir_uart_raw_rate_set (uint16_t baud)
+{
+    sim.baud = baud;
+    AVRTEST_WRITE (UBRR1, F_CPU / 16 / baud - 1);
+}
+
+
+uint16_t
+ir_uart_raw_errors_get (void)
+{
+    return ir_uart_stats.framing_errors + ir_uart_stats.overrun_errors;
+}
+
+
+uint16_t
+ir_uart_raw_seed_get (void)
+{
+    /* The boards in a simulation share the seed and run in step so
+       only the node address tells them apart.  */
+    return sim.seed + sim.node * 40503u;
+}
+#endif
 
 
 /* Return non-zero if there is a character ready to be read.  */
 bool
 ir_uart_read_ready_p (void)
 {
-    return 0;
+#if IR_UART_BAUD_ADAPT
+    return ir_uart_baud_read_ready_p ();
+#else
+    return ir_uart_sim_read_ready_p ();
+#endif
+}
+
+
+/* Read up to size bytes from IR_UART without blocking.  */
+uint8_t
+ir_uart_read (void *data, uint8_t size)
+{
+#if IR_UART_BAUD_ADAPT
+    return ir_uart_baud_read (data, size);
+#else
+    return ir_uart_sim_read (data, size);
+#endif
+}
+
+
+/* Return the time that the last character read was received.  */
+timer_tick_t
+ir_uart_rx_time_get (void)
+{
+#if IR_UART_BAUD_ADAPT
+    return ir_uart_baud_rx_time_get ();
+#else
+    return ir_uart_sim_rx_time_get ();
+#endif
 }
 
 
@@ -20,7 +543,12 @@ ir_uart_read_ready_p (void)
 int8_t
 ir_uart_getc (void)
 {
-    return 0;
+    char ch;
+
+    while (!ir_uart_read (&ch, 1))
+        system_sleep_us (100);
+
+    return ch;
 }
 
 
@@ -28,7 +556,11 @@ ir_uart_getc (void)
 bool
 ir_uart_write_ready_p (void)
 {
-    return 0;
+#if IR_UART_BAUD_ADAPT
+    if (!ir_uart_baud_write_ready_p ())
+        return 0;
+#endif
+    return ir_uart_sim_write_ready_p ();
 }
 
 
@@ -36,23 +568,58 @@ ir_uart_write_ready_p (void)
 bool
 ir_uart_write_finished_p (void)
 {
-    return 1;
+#if IR_UART_BAUD_ADAPT
+    ir_uart_baud_update ();
+#endif
+    return ir_uart_sim_write_finished_p ();
+}
+
+
+/* Write up to size bytes to IR_UART without blocking.  */
+uint8_t
+ir_uart_write (const void *data, uint8_t size)
+{
+#if IR_UART_BAUD_ADAPT
+    if (!ir_uart_baud_write_ready_p ())
+        return 0;
+#endif
+    return ir_uart_sim_write (data, size);
+}
+
+
+/* Write character to IR_UART without checking for echo.  */
+void
+ir_uart_putc_nocheck (char ch)
+{
+    while (!ir_uart_write (&ch, 1))
+        system_sleep_us (100);
 }
 
 
 /* Write character to IR_UART.  This returns zero if
    the character could not be written.  */
 int8_t
-ir_uart_putc (__unused__ char ch)
+ir_uart_putc (char ch)
 {
-    return 0;
+    ir_uart_putc_nocheck (ch);
+    return 1;
 }
 
 
 /* Write string to IR_UART.  */
 void
-ir_uart_puts (__unused__ const char *str)
+ir_uart_puts (const char *str)
+{
+    while (*str)
+        ir_uart_putc (*str++);
+}
+
+
+/** Return pointer to the link statistics.  */
+const ir_uart_stats_t *
+ir_uart_stats_get (void)
 {
+    return &ir_uart_stats;
 }
 
 
@@ -60,5 +627,67 @@ ir_uart_puts (__unused__ const char *str)
 uint8_t
 ir_uart_init (void)
 {
+    struct sockaddr_un addr;
+    socklen_t addrlen;
+    const char *link;
+    int node;
+
+    if (sim.fd >= 0)
+        return 1;
+
+    link = system_getenv ("UCFK4_IR_LINK");
+    snprintf (sim.link, sizeof (sim.link), "%s",
+              link && *link ? link : "ucfk4");
+
+    sim.baud = ir_uart_sim_param ("UCFK4_IR_BAUD", IR_UART_BAUD_RATE);
+    if (sim.baud <= 0)
+        sim.baud = IR_UART_BAUD_RATE;
+    /* Do not break links configured to run faster than the IR
+       receiver can manage.  */
+    sim.baud_max = ir_uart_sim_param ("UCFK4_IR_BAUD_MAX",
+                                      sim.baud > IR_UART_BAUD_MAX
+                                      ? sim.baud : IR_UART_BAUD_MAX);
+    sim.latency = ir_uart_sim_param ("UCFK4_IR_LATENCY", 0);
+    sim.loss = ir_uart_sim_param ("UCFK4_IR_LOSS", 0);
+    sim.flip = ir_uart_sim_param ("UCFK4_IR_FLIP", 0);
+    sim.echo = ir_uart_sim_param ("UCFK4_IR_ECHO", 0);
+    sim.collide = ir_uart_sim_param ("UCFK4_IR_COLLIDE", 0) != 0;
+    sim.seed = ir_uart_sim_param ("UCFK4_IR_SEED", getpid ());
+
+    sim.tx_start = sim.tx_busy = 0;
+    sim.queue_head = sim.queue_tail = 0;
+
+    /* Enable the receiver, transmitter, and their interrupts for 8
+       bit characters.  */
+    AVRTEST_WRITE (UBRR1, F_CPU / 16 / sim.baud - 1);
+    AVRTEST_WRITE (UCSR1B, 0xd8);
+    AVRTEST_WRITE (UCSR1C, 0x06);
+
+    system_stats_register ("ir_uart", ir_uart_stats_names,
+                           (const uint16_t *)&ir_uart_stats,
+                           ARRAY_SIZE (ir_uart_stats_names));
+
+    sim.fd = socket (AF_UNIX, SOCK_DGRAM, 0);
+    if (sim.fd < 0)
+        return 0;
+    fcntl (sim.fd, F_SETFL, O_NONBLOCK);
+
+    /* Grab the first free node address.  */
+    for (node = 0; node < IR_UART_SIM_NODES; node++)
+    {
+        addrlen = ir_uart_sim_addr (&addr, node);
+        if (bind (sim.fd, (struct sockaddr *)&addr, addrlen) == 0)
+        {
+            sim.node = node;
+#if IR_UART_BAUD_ADAPT
+            ir_uart_baud_init ();
+#endif
+            return 1;
+        }
+    }
+
+    fprintf (stderr, "ir_uart: no free node on link %s\n", sim.link);
+    close (sim.fd);
+    sim.fd = -1;
     return 0;
 }
@@ -1,17 +1,22 @@
 /** @file  ir_uart.h
     @author Michael Hayes
     @date   10 December 2004
+    @brief  Simulated IR UART; see ir_uart.c for how to configure the link.
 */
 
 #ifndef IR_UART_H
 #define IR_UART_H
 
 #include "system.h"
+#include "timer.h"
 
 #ifndef IR_UART_BAUD_RATE
 #define IR_UART_BAUD_RATE 2400
 #endif
 
+/* This is the starting rate if IR_UART_BAUD_ADAPT is enabled.  */
+#include "ir_uart_baud.h"
+
 
 /* Return non-zero if there is a character ready to be read.  */
 bool
@@ -24,6 +29,16 @@ int8_t
 ir_uart_getc (void);
 
 
+/* Read up to size bytes from IR_UART without blocking.  */
+uint8_t
+ir_uart_read (void *data, uint8_t size);
+
+
+/* Return the time that the last character read was received.  */
+timer_tick_t
+ir_uart_rx_time_get (void);
+
+
 /* Return non-zero if a character can be written without blocking.  */
 bool
 ir_uart_write_ready_p (void);
@@ -34,6 +49,16 @@ bool
 ir_uart_write_finished_p (void);
 
 
+/* Write up to size bytes to IR_UART without blocking.  */
+uint8_t
+ir_uart_write (const void *data, uint8_t size);
+
+
+/* Write character to IR_UART without checking for echo.  */
+void
+ir_uart_putc_nocheck (char ch);
+
+
 /* Write character to IR_UART.  This returns zero if
    the character could not be written.  */
 int8_t
@@ -45,6 +70,24 @@ void
 ir_uart_puts (const char *str);
 
 
+/** Link statistics.  These match the AVR driver although the
+    simulated link does not produce framing or overrun errors.  */
+typedef struct ir_uart_stats_struct
+{
+    uint16_t tx_bytes;
+    uint16_t rx_bytes;
+    uint16_t echo_drops;
+    uint16_t framing_errors;
+    uint16_t overrun_errors;
+    uint16_t rx_drops;
+} ir_uart_stats_t;
+
+
+/** Return pointer to the link statistics.  */
+const ir_uart_stats_t *
+ir_uart_stats_get (void);
+
+
 /* Initialise ir_uart and set baud rate.  */
 uint8_t
 ir_uart_init (void);
@@ -18,23 +18,23 @@ bool pio_config_set (pio_t pio, pio_config_t config)
     switch (config)
     {
     case PIO_OUTPUT_LOW:
-        PIO_DATA_ (pio) &= ~PIO_BITMASK_ (pio);
-        PIO_DDR_ (pio) |= PIO_BITMASK_ (pio);
+        PIO_CLEAR_ (PIO_DATA_ (pio), PIO_BITMASK_ (pio));
+        PIO_SET_ (PIO_DDR_ (pio), PIO_BITMASK_ (pio));
         return 1;
 
     case PIO_OUTPUT_HIGH:
-        PIO_DATA_ (pio) |= PIO_BITMASK_ (pio);
-        PIO_DDR_ (pio) |= PIO_BITMASK_ (pio);
+        PIO_SET_ (PIO_DATA_ (pio), PIO_BITMASK_ (pio));
+        PIO_SET_ (PIO_DDR_ (pio), PIO_BITMASK_ (pio));
         return 1;
 
     case PIO_INPUT:
-        PIO_DDR_ (pio) &= ~PIO_BITMASK_ (pio);
-        PIO_DATA_ (pio) &= ~PIO_BITMASK_ (pio);
+        PIO_CLEAR_ (PIO_DDR_ (pio), PIO_BITMASK_ (pio));
+        PIO_CLEAR_ (PIO_DATA_ (pio), PIO_BITMASK_ (pio));
         return 1;
 
     case PIO_PULLUP:
-        PIO_DDR_ (pio) &= ~PIO_BITMASK_ (pio);
-        PIO_DATA_ (pio) |= PIO_BITMASK_ (pio); 
+        PIO_CLEAR_ (PIO_DDR_ (pio), PIO_BITMASK_ (pio));
+        PIO_SET_ (PIO_DATA_ (pio), PIO_BITMASK_ (pio)); 
         return 1;
 
     default:
@@ -51,8 +51,8 @@ pio_config_t pio_config_get (pio_t pio)
     bool ddr;
     bool port;
 
-    ddr = PIO_DDR_ (pio) & PIO_BITMASK_ (pio);
-    port = PIO_DATA_ (pio) & PIO_BITMASK_ (pio);
+    ddr = AVRTEST_READ (PIO_DDR_ (pio)) & PIO_BITMASK_ (pio);
+    port = AVRTEST_READ (PIO_DATA_ (pio)) & PIO_BITMASK_ (pio);
     
     if (ddr)
     {
@@ -74,7 +74,7 @@ pio_config_t pio_config_get (pio_t pio)
     @param pio  */
 void pio_output_high (pio_t pio)
 {
-    PIO_DATA_ (pio) |= PIO_BITMASK_ (pio);
+    PIO_SET_ (PIO_DATA_ (pio), PIO_BITMASK_ (pio));
 }
 
 
@@ -82,7 +82,7 @@ void pio_output_high (pio_t pio)
     @param pio  */
 void pio_output_low (pio_t pio)
 {
-    PIO_DATA_ (pio) &= ~PIO_BITMASK_ (pio);
+    PIO_CLEAR_ (PIO_DATA_ (pio), PIO_BITMASK_ (pio));
 }
 
 
@@ -90,7 +90,7 @@ void pio_output_low (pio_t pio)
     @param pio  */
 void pio_output_toggle (pio_t pio)
 {
-    PIO_DATA_ (pio) ^= PIO_BITMASK_ (pio);
+    PIO_TOGGLE_ (PIO_DATA_ (pio), PIO_BITMASK_ (pio));
 }
 
 
@@ -99,7 +99,7 @@ void pio_output_toggle (pio_t pio)
     @return input state of pio  */
 bool pio_input_get (pio_t pio)
 {
-    return (PIO_PIN_ (pio) & PIO_BITMASK_ (pio)) != 0;
+    return (AVRTEST_READ (PIO_PIN_ (pio)) & PIO_BITMASK_ (pio)) != 0;
 }
 
 
@@ -108,7 +108,7 @@ bool pio_input_get (pio_t pio)
     @return output state of pio  */
 bool pio_output_get (pio_t pio)
 {
-    return (PIO_DATA_ (pio) & PIO_BITMASK_ (pio)) != 0;
+    return (AVRTEST_READ (PIO_DATA_ (pio)) & PIO_BITMASK_ (pio)) != 0;
 }
 
 
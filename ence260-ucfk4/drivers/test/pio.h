@@ -134,6 +134,12 @@ typedef enum pio_config_enum
 /** Private macro to access a pio data register.  */
 #define PIO_DATA_(pio) (*PIO_PORT_ (pio))
 
+/** Private macros to set, clear, or toggle bits of a register.  The
+    accesses are counted if AVRTEST_TRACE is enabled.  */
+#define PIO_SET_(REG, MASK) AVRTEST_WRITE (REG, AVRTEST_READ (REG) | (MASK))
+#define PIO_CLEAR_(REG, MASK) AVRTEST_WRITE (REG, AVRTEST_READ (REG) & ~(MASK))
+#define PIO_TOGGLE_(REG, MASK) AVRTEST_WRITE (REG, AVRTEST_READ (REG) ^ (MASK))
+
 
 #ifdef DEBUG
 /** Configure pio.
@@ -199,23 +205,23 @@ bool pio_config_set (pio_t pio, pio_config_t config)
     switch (config)
     {
     case PIO_OUTPUT_LOW:
-        PIO_DATA_ (pio) &= ~PIO_BITMASK_ (pio);
-        PIO_DDR_ (pio) |= PIO_BITMASK_ (pio);
+        PIO_CLEAR_ (PIO_DATA_ (pio), PIO_BITMASK_ (pio));
+        PIO_SET_ (PIO_DDR_ (pio), PIO_BITMASK_ (pio));
         return 1;
 
     case PIO_OUTPUT_HIGH:
-        PIO_DATA_ (pio) |= PIO_BITMASK_ (pio);
-        PIO_DDR_ (pio) |= PIO_BITMASK_ (pio);
+        PIO_SET_ (PIO_DATA_ (pio), PIO_BITMASK_ (pio));
+        PIO_SET_ (PIO_DDR_ (pio), PIO_BITMASK_ (pio));
         return 1;
 
     case PIO_INPUT:
-        PIO_DDR_ (pio) &= ~PIO_BITMASK_ (pio);
-        PIO_DATA_ (pio) &= ~PIO_BITMASK_ (pio);
+        PIO_CLEAR_ (PIO_DDR_ (pio), PIO_BITMASK_ (pio));
+        PIO_CLEAR_ (PIO_DATA_ (pio), PIO_BITMASK_ (pio));
         return 1;
 
     case PIO_PULLUP:
-        PIO_DDR_ (pio) &= ~PIO_BITMASK_ (pio);
-        PIO_DATA_ (pio) |= PIO_BITMASK_ (pio); 
+        PIO_CLEAR_ (PIO_DDR_ (pio), PIO_BITMASK_ (pio));
+        PIO_SET_ (PIO_DATA_ (pio), PIO_BITMASK_ (pio)); 
         return 1;
 
     default:
@@ -233,8 +239,8 @@ pio_config_t pio_config_get (pio_t pio)
     bool ddr;
     bool port;
 
-    ddr = PIO_DDR_ (pio) & PIO_BITMASK_ (pio);
-    port = PIO_DATA_ (pio) & PIO_BITMASK_ (pio);
+    ddr = AVRTEST_READ (PIO_DDR_ (pio)) & PIO_BITMASK_ (pio);
+    port = AVRTEST_READ (PIO_DATA_ (pio)) & PIO_BITMASK_ (pio);
     
     if (ddr)
     {
@@ -257,7 +263,7 @@ pio_config_t pio_config_get (pio_t pio)
 static inline
 void pio_output_high (pio_t pio)
 {
-    PIO_DATA_ (pio) |= PIO_BITMASK_ (pio);
+    PIO_SET_ (PIO_DATA_ (pio), PIO_BITMASK_ (pio));
 }
 
 
@@ -266,7 +272,7 @@ void pio_output_high (pio_t pio)
 static inline
 void pio_output_low (pio_t pio)
 {
-    PIO_DATA_ (pio) &= ~PIO_BITMASK_ (pio);
+    PIO_CLEAR_ (PIO_DATA_ (pio), PIO_BITMASK_ (pio));
 }
 
 
@@ -275,7 +281,7 @@ void pio_output_low (pio_t pio)
 static inline
 void pio_output_toggle (pio_t pio)
 {
-    PIO_DATA_ (pio) ^= PIO_BITMASK_ (pio);
+    PIO_TOGGLE_ (PIO_DATA_ (pio), PIO_BITMASK_ (pio));
 }
 
 
@@ -285,7 +291,7 @@ void pio_output_toggle (pio_t pio)
 static inline
 bool pio_input_get (pio_t pio)
 {
-    return (PIO_PIN_ (pio) & PIO_BITMASK_ (pio)) != 0;
+    return (AVRTEST_READ (PIO_PIN_ (pio)) & PIO_BITMASK_ (pio)) != 0;
 }
 
 
@@ -295,7 +301,7 @@ bool pio_input_get (pio_t pio)
 static inline
 bool pio_output_get (pio_t pio)
 {
-    return (PIO_DATA_ (pio) & PIO_BITMASK_ (pio)) != 0;
+    return (AVRTEST_READ (PIO_DATA_ (pio)) & PIO_BITMASK_ (pio)) != 0;
 }
 
 
@@ -308,7 +314,69 @@ void pio_output_set (pio_t pio, bool state)
     state ? pio_output_high (pio) : pio_output_low (pio);
 }
 
-/** Set input state for pio (this is only for use by the test scaffold). 
+
+/** A group of PIOs on the same port is defined by ORing their PIO
+    definitions, say PC4_PIO | PC6_PIO.  pio_config_set and
+    pio_output_set act on all the pins of a group at once since they
+    are in the same register.  Groups are not supported if DEBUG is
+    defined.  */
+
+/** Return non-zero if two PIOs (or groups) are on the same port.  */
+#define PIO_SAME_PORT_P(PIO1, PIO2) ((((PIO1) ^ (PIO2)) & 0xff) == 0)
+
+
+/** Return the bitmask of a PIO (or group) in its port.
+    @param pio
+    @return bitmask  */
+static inline
+uint8_t pio_bitmask_get (pio_t pio)
+{
+    return PIO_BITMASK_ (pio);
+}
+
+
+/** Read input states from a group of PIOs.
+    @param group
+    @return bitmask of the pins in the group that are high  */
+static inline
+uint8_t pio_group_input_get (pio_t group)
+{
+    return AVRTEST_READ (PIO_PIN_ (group)) & PIO_BITMASK_ (group);
+}
+
+
+/** Return the configuration of a group of PIOs for
+    pio_group_config_restore.
+    @param group
+    @return configuration  */
+static inline
+uint16_t pio_group_config_save (pio_t group)
+{
+    return ((AVRTEST_READ (PIO_DDR_ (group)) & PIO_BITMASK_ (group)) << 8)
+        | (AVRTEST_READ (PIO_DATA_ (group)) & PIO_BITMASK_ (group));
+}
+
+
+/** Restore the configuration of a group of PIOs.  The PORT register
+    is changed before the DDR register so that a pin going from input
+    to output is never driven to the wrong state.
+    @param group
+    @param config configuration from pio_group_config_save  */
+static inline
+void pio_group_config_restore (pio_t group, uint16_t config)
+{
+    uint8_t mask = PIO_BITMASK_ (group);
+
+    AVRTEST_WRITE (PIO_DATA_ (group),
+                   (AVRTEST_READ (PIO_DATA_ (group)) & ~mask)
+                   | (config & mask));
+    AVRTEST_WRITE (PIO_DDR_ (group),
+                   (AVRTEST_READ (PIO_DDR_ (group)) & ~mask)
+                   | ((config >> 8) & mask));
+}
+
+/** Set input state for pio (this is only for use by the test scaffold
+    so the access is not counted).
     @param pio
     @param state value for pio input  */
 static inline
@@ -2,6 +2,74 @@
     @author M. P. Hayes, UCECE
     @date   15 May 2007
     @brief  Test scaffold for UCFK4.
+
+    @note The navswitch and pushbutton are normally driven from the
+    keyboard.  For automated runs they can instead be driven from an
+    input script and a live session can be recorded in the same
+    format, as set by the environment variables:
+
+    UCFK4_INPUT   name of input script to replay; the keyboard is ignored
+    UCFK4_RECORD  name of file to record the navswitch and button to
+
+    Each line of a script is a time in seconds since system_init, an
+    action, and, for press and release, an input:
+
+    0.50 press east
+    0.70 release east
+    2.00 press button
+    2.10 release button
+    5.00 exit
+
+    The inputs are north, east, south, west, push, and button.  The
+    exit action ends the program as if it had been interrupted.  Blank
+    lines and lines starting with # are ignored.  The times are
+    rounded to the scaffold update period of 1 / SYSTEM_UPDATE_RATE.
+
+    UCFK4_VIRTUAL  non-zero to run on a virtual clock (default 0)
+
+    With a virtual clock the program runs headless and as fast as it
+    can.  Time only advances when the program waits, say in
+    timer_wait_until, when the clock jumps straight to the end of the
+    wait and the display model and input script are updated for each
+    scaffold update period on the way.  Each call of timer_get
+    advances the clock by 1 us so that a loop polling the timer
+    finishes.  There is no rendering and the keyboard is ignored, so
+    an input script is needed for any input; a run is deterministic
+    and finishes when the script says exit.  Each program has its own
+    virtual clock so the IR link between two programs needs real time
+    unless they are run by the simulator described below.
+
+    UCFK4_FPS      maximum display frame rate (default 50)
+
+    The display is rendered by a separate thread rather than by the
+    update signal handler.  Each frame is written with a single write
+    and only when the image changes.
+
+    UCFK4_TRACE    name of file to record a display trace to
+
+    A display trace is a binary file for checking what was displayed
+    offline, say with etc/displaytrace.py.  It starts with an 8 byte
+    header:
+
+    'U' 'D' 'T' '1' rows cols rate (16 bits)
+
+    where rate is the update rate.  This is followed by a record each
+    time the display changes:
+
+    tick (32 bits) on[rows] brightness[rows][cols]
+
+    where tick counts updates since system_init, each byte of on has a
+    bit set for each column of the row that is lit, and brightness is
+    the persistence-filtered brightness (0 to 100) of each LED.  A
+    record holds until the tick of the next one; the final record
+    repeats the one before at the end of the run.  Values are little
+    endian.
+
+    The multi-board simulator, sim/ucfk4sim.c, runs several copies of
+    a program in one process.  It attaches each copy with
+    system_sim_attach so that the copies run on a common virtual clock
+    and share the simulated IR link.  The settings above can then be
+    given for each board.
 */
 
 #include "system.h"
@@ -10,9 +78,12 @@
 #include "mgetkey.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <signal.h>
 #include <time.h>
+#include <pthread.h>
+#include <fcntl.h>
 
 
 /** This needs to be at least 50 * 5 for a refresh rate of 50 Hz.  */
@@ -22,8 +93,45 @@
 
 #define SYSTEM_DISPLAY_PERSISTENCE_PERIOD 0.01
 
+/* Default maximum display frame rate.  */
+#define SYSTEM_FRAME_RATE 50
+
+#define SYSTEM_STATS_NUM 8
+
+
+SFR_t SFR;
+
 
-SFR_t SFR = {0, 0, ~0, 0, 0, ~0, 0, 0, ~0};
+typedef struct
+{
+    const char *name;
+    const volatile void *reg;
+    uint32_t reads;
+    uint32_t writes;
+} system_sfr_t;
+
+#define SYSTEM_SFR(REG) {#REG, &REG, 0, 0}
+
+/* Registers with access counts for AVRTEST_TRACE.  */
+static system_sfr_t system_sfrs[] =
+{
+    SYSTEM_SFR (PORTB), SYSTEM_SFR (DDRB), SYSTEM_SFR (PINB),
+    SYSTEM_SFR (PORTC), SYSTEM_SFR (DDRC), SYSTEM_SFR (PINC),
+    SYSTEM_SFR (PORTD), SYSTEM_SFR (DDRD), SYSTEM_SFR (PIND),
+    SYSTEM_SFR (TCCR0A), SYSTEM_SFR (TCCR0B), SYSTEM_SFR (TCNT0),
+    SYSTEM_SFR (OCR0A), SYSTEM_SFR (OCR0B), SYSTEM_SFR (TIMSK0),
+    SYSTEM_SFR (TIFR0),
+    SYSTEM_SFR (TCCR1A), SYSTEM_SFR (TCCR1B), SYSTEM_SFR (TCCR1C),
+    SYSTEM_SFR (TCNT1), SYSTEM_SFR (OCR1A), SYSTEM_SFR (OCR1B),
+    SYSTEM_SFR (ICR1), SYSTEM_SFR (TIMSK1), SYSTEM_SFR (TIFR1),
+    SYSTEM_SFR (UCSR1A), SYSTEM_SFR (UCSR1B), SYSTEM_SFR (UCSR1C),
+    SYSTEM_SFR (UBRR1), SYSTEM_SFR (UDR1),
+    SYSTEM_SFR (EECR), SYSTEM_SFR (EEDR), SYSTEM_SFR (EEAR)
+};
+
+static avrtest_accesses_t system_sfr_accesses;
+static bool system_sfr_started;
+static FILE *system_sfr_trace;
 
 
 /* Define PIO pins driving LED matrix rows and columns.  */
@@ -54,6 +162,189 @@ typedef enum {NAVSWITCH_NONE, NAVSWITCH_EAST, NAVSWITCH_SOUTH,
 typedef enum {BUTTON_NONE, BUTTON_1} system_button_t;
 
 
+/* Inputs that can be scripted; these are indexed by
+   system_navswitch_t for the navswitch.  */
+#define SYSTEM_INPUT_BUTTON 6
+
+static const char * const system_input_names[] =
+{
+    "", "east", "south", "west", "north", "push", "button"
+};
+
+#define SYSTEM_INPUT_EXIT 0xff
+
+
+typedef struct
+{
+    /* Update tick that the event happens at.  */
+    unsigned long tick;
+    uint8_t input;
+    bool state;
+} system_input_event_t;
+
+
+typedef struct
+{
+    system_input_event_t *events;
+    int num;
+    int next;
+    /* File descriptor for recording.  The records are written with
+       write since they are made by the update signal handler.  */
+    int record;
+    /* Bitmask of inputs that are down, for recording.  */
+    unsigned int down;
+} system_input_t;
+
+
+static system_input_t system_input = {.record = -1};
+
+/* Number of calls to system_update.  */
+static unsigned long system_ticks;
+
+static bool system_virtual;
+/* Virtual time (us) and time of the next update.  */
+static uint64_t system_virtual_us;
+static uint64_t system_virtual_update_us;
+
+/* Display image, a bit per pixel, and its sequence number.  The
+   update makes the sequence number odd while it changes the image so
+   that the render thread can tell if its copy is torn.  */
+static volatile uint8_t system_image[LEDMAT_ROWS_NUM];
+static volatile unsigned int system_image_seq;
+
+/* Set by SIGINT, SIGTERM, or the input script; the exit is made
+   outside the signal handlers.  */
+static volatile sig_atomic_t system_exit_requested;
+static volatile sig_atomic_t system_exit_status;
+
+/* Timer that raises the update signal.  */
+static timer_t system_timer;
+static bool system_timer_running;
+
+static void system_exit_check (void);
+
+/* Simulator hooks and the board number of this copy.  */
+static const system_sim_t *system_sim;
+static int system_board;
+
+#define SYSTEM_TRACE_RECORD_SIZE \
+    (4 + LEDMAT_ROWS_NUM + LEDMAT_ROWS_NUM * LEDMAT_COLS_NUM)
+
+/* Display trace.  The records are buffered and written with write
+   since they are made by the update signal handler.  */
+static int system_trace_fd = -1;
+static uint8_t system_trace_buffer[SYSTEM_TRACE_RECORD_SIZE * 64];
+static int system_trace_len;
+static uint8_t system_trace_last[SYSTEM_TRACE_RECORD_SIZE];
+
+
+typedef struct
+{
+    const char *name;
+    const char * const *fields;
+    const uint16_t *counters;
+    uint8_t num;
+} system_stats_t;
+
+
+static system_stats_t system_stats[SYSTEM_STATS_NUM];
+static int system_stats_num;
+
+
+static void system_trace_flush (int fd)
+{
+    if (system_trace_len && write (fd, system_trace_buffer,
+                                   system_trace_len) < 0)
+        system_trace_fd = -1;
+    system_trace_len = 0;
+}
+
+
+static void system_trace_append (unsigned long tick)
+{
+    uint8_t *record;
+
+    if (system_trace_len + SYSTEM_TRACE_RECORD_SIZE
+        > (int)sizeof (system_trace_buffer))
+        system_trace_flush (system_trace_fd);
+
+    record = system_trace_buffer + system_trace_len;
+    memcpy (record, system_trace_last, SYSTEM_TRACE_RECORD_SIZE);
+    record[0] = tick;
+    record[1] = tick >> 8;
+    record[2] = tick >> 16;
+    record[3] = tick >> 24;
+    system_trace_len += SYSTEM_TRACE_RECORD_SIZE;
+}
+
+
+/* Add a record to the trace if the display has changed.  */
+static void system_trace_update (const uint8_t *on,
+                                 uint8_t tdisplay[][LEDMAT_COLS_NUM])
+{
+    uint8_t *last = system_trace_last + 4;
+
+    if (system_trace_fd < 0)
+        return;
+
+    if (system_ticks
+        && !memcmp (last, on, LEDMAT_ROWS_NUM)
+        && !memcmp (last + LEDMAT_ROWS_NUM, tdisplay,
+                    LEDMAT_ROWS_NUM * LEDMAT_COLS_NUM))
+        return;
+
+    memcpy (last, on, LEDMAT_ROWS_NUM);
+    memcpy (last + LEDMAT_ROWS_NUM, tdisplay,
+            LEDMAT_ROWS_NUM * LEDMAT_COLS_NUM);
+    system_trace_append (system_ticks);
+}
+
+
+/* Finish the trace with a copy of the last record.  */
+static void system_trace_close (void)
+{
+    int fd = system_trace_fd;
+
+    if (fd < 0)
+        return;
+    system_trace_fd = -1;
+
+    system_trace_append (system_ticks);
+    system_trace_flush (fd);
+    close (fd);
+}
+
+
+static void system_trace_init (void)
+{
+    const char *filename;
+    uint8_t header[8] = {'U', 'D', 'T', '1', LEDMAT_ROWS_NUM,
+                         LEDMAT_COLS_NUM, SYSTEM_UPDATE_RATE & 0xff,
+                         SYSTEM_UPDATE_RATE >> 8};
+
+    filename = system_getenv ("UCFK4_TRACE");
+    if (!filename || !*filename)
+        return;
+
+    system_trace_fd = open (filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (system_trace_fd < 0
+        || write (system_trace_fd, header, sizeof (header)) < 0)
+    {
+        perror (filename);
+        exit (EXIT_FAILURE);
+    }
+    atexit (system_trace_close);
+}
+
+
+/* Read the output state of a pio directly so that the access is
+   not counted.  */
+static bool system_pio_output_get (pio_t pio)
+{
+    return (PIO_DATA_ (pio) & PIO_BITMASK_ (pio)) != 0;
+}
+
+
 static void system_display_update (void)
 {
     int row;
@@ -65,36 +356,198 @@ static void system_display_update (void)
     /* Exponential filter parameter.  */
     double alpha;
     static uint8_t tdisplay[LEDMAT_ROWS_NUM][LEDMAT_COLS_NUM];
+    uint8_t image[LEDMAT_ROWS_NUM];
+    uint8_t lit[LEDMAT_ROWS_NUM];
+    bool changed = 0;
 
     delta_t = 1.0 / SYSTEM_UPDATE_RATE;
     alpha = tau / (tau + delta_t);
 
     for (row = 0; row < LEDMAT_ROWS_NUM; row++)
     {
+        image[row] = 0;
+        lit[row] = 0;
         for (col = 0; col < LEDMAT_COLS_NUM; col++)
         {
             uint8_t on;
 
             /* Determine if pixel is on.  */
-            on = !pio_output_get (ledmat_rows[row])
-                && !pio_output_get (ledmat_cols[col]);
+            on = !system_pio_output_get (ledmat_rows[row])
+                && !system_pio_output_get (ledmat_cols[col]);
+            if (on)
+                lit[row] |= BIT (col);
 
             /* Apply exponential filter to provide some persistence.
                This has an impulse response of exp(-t / tau) u(t).  */
             tdisplay[row][col] = tdisplay[row][col] * alpha + (1 - alpha) * 100 * on;
 
-            printf ("%c", tdisplay[row][col] > 1 ? '@' : '.');
+            if (tdisplay[row][col] > 1)
+                image[row] |= BIT (col);
         }
-        printf ("\n");
+        if (image[row] != system_image[row])
+            changed = 1;
+    }
+    system_trace_update (lit, tdisplay);
+
+    if (!changed)
+        return;
+
+    system_image_seq++;
+    __sync_synchronize ();
+    for (row = 0; row < LEDMAT_ROWS_NUM; row++)
+        system_image[row] = image[row];
+    __sync_synchronize ();
+    system_image_seq++;
+
+    if (system_sim)
+        system_sim->display (system_board, image);
+}
+
+
+/* Render the display whenever the image changes, at most frame_rate
+   times a second.  */
+static void *system_render_thread (void *arg)
+{
+    int frame_rate = *(int *)arg;
+    unsigned int seq;
+    unsigned int last_seq = 1;
+    uint8_t image[LEDMAT_ROWS_NUM];
+    char frame[LEDMAT_ROWS_NUM * (LEDMAT_COLS_NUM + 1) + 16];
+    sigset_t mask;
+    bool render = 1;
+    int row;
+    int col;
+    int len;
+
+    /* Leave the update signal and interrupts to the main thread.  */
+    sigfillset (&mask);
+    pthread_sigmask (SIG_BLOCK, &mask, NULL);
+
+    while (1)
+    {
+        usleep (1000000 / frame_rate);
+
+        /* The main thread may be busy polling without sleeping so
+           exit from here on an interrupt.  */
+        system_exit_check ();
+        if (!render)
+            continue;
+
+        /* Take a consistent copy of the image.  */
+        do
+        {
+            seq = system_image_seq;
+            __sync_synchronize ();
+            for (row = 0; row < LEDMAT_ROWS_NUM; row++)
+                image[row] = system_image[row];
+            __sync_synchronize ();
+        } while ((seq & 1) || seq != system_image_seq);
+
+        if (seq == last_seq)
+            continue;
+        last_seq = seq;
+
+        len = 0;
+        for (row = 0; row < LEDMAT_ROWS_NUM; row++)
+        {
+            for (col = 0; col < LEDMAT_COLS_NUM; col++)
+                frame[len++] = image[row] & BIT (col) ? '@' : '.';
+            frame[len++] = '\n';
+        }
+        frame[len++] = '\n';
+        /* Move cursor up.  */
+        len += sprintf (frame + len, "\e[%dA", LEDMAT_ROWS_NUM + 1);
+
+        if (write (STDOUT_FILENO, frame, len) < 0)
+            render = 0;
+    }
+    return NULL;
+}
+
+
+static void system_render_init (void)
+{
+    static int frame_rate;
+    const char *str;
+    pthread_t thread;
+
+    str = system_getenv ("UCFK4_FPS");
+    frame_rate = str ? atoi (str) : SYSTEM_FRAME_RATE;
+    if (frame_rate <= 0)
+        frame_rate = SYSTEM_FRAME_RATE;
+
+    if (pthread_create (&thread, NULL, system_render_thread, &frame_rate))
+    {
+        perror ("pthread_create");
+        exit (EXIT_FAILURE);
+    }
+    pthread_detach (thread);
+}
+
+
+/* Write a line of the record with the time to four decimal places.
+   The line is formatted without stdio so that this can be called from
+   the update signal handler.  */
+static void system_input_record_write (const char *action, const char *name)
+{
+    char line[64];
+    char digits[24];
+    unsigned long long tenths_ms;
+    unsigned long long secs;
+    int len = 0;
+    int num = 0;
+    int i;
+
+    tenths_ms = ((unsigned long long)system_ticks * 10000
+                 + SYSTEM_UPDATE_RATE / 2) / SYSTEM_UPDATE_RATE;
+    secs = tenths_ms / 10000;
+    do
+    {
+        digits[num++] = '0' + secs % 10;
+        secs /= 10;
+    } while (secs);
+    while (num)
+        line[len++] = digits[--num];
+
+    line[len++] = '.';
+    for (i = 1000; i; i /= 10)
+        line[len++] = '0' + tenths_ms % 10000 / i % 10;
+
+    line[len++] = ' ';
+    while (*action)
+        line[len++] = *action++;
+    if (name)
+    {
+        line[len++] = ' ';
+        while (*name)
+            line[len++] = *name++;
     }
-    printf ("\n");
-    /* Move cursor up.  */
-    printf ("\e[%dA", LEDMAT_ROWS_NUM + 1);
+    line[len++] = '\n';
+
+    if (write (system_input.record, line, len) < 0)
+        system_input.record = -1;
+}
+
+
+/* Record a change of an input.  */
+static void system_input_record (uint8_t input, bool state)
+{
+    unsigned int mask = BIT (input);
+
+    if (system_input.record < 0 || input == 0
+        || ((system_input.down & mask) != 0) == state)
+        return;
+
+    system_input.down ^= mask;
+    system_input_record_write (state ? "press" : "release",
+                               system_input_names[input]);
 }
 
 
 static void system_navswitch_set (system_navswitch_t navswitch, bool state)
 {
+    system_input_record (navswitch, state);
+
     switch (navswitch)
     {
     case NAVSWITCH_NONE:
@@ -170,6 +623,9 @@ static void system_navswitch_select (system_navswitch_t navswitch)
 
 static void system_button_set (system_button_t button, bool state)
 {
+    if (button == BUTTON_1)
+        system_input_record (SYSTEM_INPUT_BUTTON, state);
+
     switch (button)
     {
     case BUTTON_NONE:
@@ -240,6 +696,140 @@ static void system_keyboard_init (void)
 }
 
 
+/* Load an input script.  */
+static void system_input_load (const char *filename)
+{
+    FILE *file;
+    char line[80];
+    int size = 0;
+    int lineno = 0;
+
+    file = fopen (filename, "r");
+    if (!file)
+    {
+        perror (filename);
+        exit (EXIT_FAILURE);
+    }
+
+    while (fgets (line, sizeof (line), file))
+    {
+        system_input_event_t *event;
+        double when;
+        char action[16];
+        char name[16];
+        int fields;
+        uint8_t input;
+
+        lineno++;
+        fields = sscanf (line, "%lf %15s %15s", &when, action, name);
+        if (fields <= 0 || line[0] == '#')
+            continue;
+
+        if (fields == 2 && !strcmp (action, "exit"))
+            input = SYSTEM_INPUT_EXIT;
+        else
+        {
+            for (input = 1; input < ARRAY_SIZE (system_input_names); input++)
+            {
+                if (fields == 3 && !strcmp (name, system_input_names[input]))
+                    break;
+            }
+            if (input == ARRAY_SIZE (system_input_names)
+                || (strcmp (action, "press") && strcmp (action, "release")))
+            {
+                fprintf (stderr, "%s:%d: bad input event\n", filename, lineno);
+                exit (EXIT_FAILURE);
+            }
+        }
+
+        if (system_input.num == size)
+        {
+            size = size ? size * 2 : 64;
+            system_input.events = realloc (system_input.events,
+                                           size * sizeof (*event));
+            if (!system_input.events)
+            {
+                perror ("realloc");
+                exit (EXIT_FAILURE);
+            }
+        }
+
+        event = &system_input.events[system_input.num++];
+        event->tick = when * SYSTEM_UPDATE_RATE + 0.5;
+        event->input = input;
+        event->state = !strcmp (action, "press");
+
+        if (system_input.num > 1 && event->tick < event[-1].tick)
+        {
+            fprintf (stderr, "%s:%d: events out of order\n", filename, lineno);
+            exit (EXIT_FAILURE);
+        }
+    }
+    fclose (file);
+}
+
+
+/* Replay the input script up to the current time.  */
+static void system_input_update (void)
+{
+    while (system_input.next < system_input.num
+           && system_input.events[system_input.next].tick <= system_ticks)
+    {
+        system_input_event_t *event;
+
+        event = &system_input.events[system_input.next++];
+        if (event->input == SYSTEM_INPUT_EXIT)
+        {
+            if (system_sim)
+                system_sim->exit (system_board);
+            /* This may be called from the update signal handler.  */
+            system_exit_status = EXIT_SUCCESS;
+            system_exit_requested = 1;
+        }
+        else if (event->input == SYSTEM_INPUT_BUTTON)
+            system_button_set (BUTTON_1, event->state);
+        else
+            system_navswitch_set (event->input, event->state);
+    }
+}
+
+
+/* Record the end of the session so that a replay lasts as long.  */
+static void system_input_record_exit (void)
+{
+    int fd = system_input.record;
+
+    if (fd < 0)
+        return;
+    system_input_record_write ("exit", 0);
+    system_input.record = -1;
+    close (fd);
+}
+
+
+static void system_input_init (void)
+{
+    const char *filename;
+
+    filename = system_getenv ("UCFK4_INPUT");
+    if (filename && *filename)
+        system_input_load (filename);
+
+    filename = system_getenv ("UCFK4_RECORD");
+    if (filename && *filename)
+    {
+        system_input.record = open (filename, O_WRONLY | O_CREAT | O_TRUNC,
+                                    0644);
+        if (system_input.record < 0)
+        {
+            perror (filename);
+            exit (EXIT_FAILURE);
+        }
+        atexit (system_input_record_exit);
+    }
+}
+
+
 static void system_keyboard_update (void)
 {
     static int state = 0;
@@ -311,7 +901,11 @@ static void system_keyboard_update (void)
 static void system_update (void)
 {
     system_display_update ();
-    system_keyboard_update ();
+    if (system_input.events)
+        system_input_update ();
+    else if (!system_virtual)
+        system_keyboard_update ();
+    system_ticks++;
 }
 
 
@@ -323,11 +917,87 @@ system_handler (__unused__ int sig, __unused__ siginfo_t *si,
 }
 
 
+static void system_stats_print (void)
+{
+    int i;
+    int j;
+
+    /* Move below the display.  */
+    if (isatty (STDOUT_FILENO) && !system_virtual)
+        printf ("\e[%dB", LEDMAT_ROWS_NUM + 1);
+    fflush (stdout);
+
+    for (i = 0; i < system_stats_num; i++)
+    {
+        if (system_sim)
+            fprintf (stderr, "board%d ", system_board);
+        fprintf (stderr, "%s:", system_stats[i].name);
+        for (j = 0; j < system_stats[i].num; j++)
+            fprintf (stderr, " %s=%u", system_stats[i].fields[j],
+                     system_stats[i].counters[j]);
+        fprintf (stderr, "\n");
+    }
+}
+
+
+void system_stats_register (const char *name, const char * const *fields,
+                            const uint16_t *counters, uint8_t num)
+{
+    int i;
+
+    if (!system_stats_num)
+        atexit (system_stats_print);
+
+    /* A module may be initialised more than once.  */
+    for (i = 0; i < system_stats_num; i++)
+    {
+        if (system_stats[i].counters == counters)
+            return;
+    }
+
+    if (system_stats_num == SYSTEM_STATS_NUM)
+        return;
+
+    system_stats[system_stats_num].name = name;
+    system_stats[system_stats_num].fields = fields;
+    system_stats[system_stats_num].counters = counters;
+    system_stats[system_stats_num].num = num;
+    system_stats_num++;
+}
+
+
+/* On an interrupt, only note that an exit has been requested since
+   exit is not safe to call from a signal handler.  */
+static void system_exit_handler (__unused__ int sig)
+{
+    system_exit_status = EXIT_FAILURE;
+    system_exit_requested = 1;
+}
+
+
+/* Exit normally if requested so that the exit handlers run; these
+   restore the terminal and print the statistics.  This must not be
+   called from a signal handler.  */
+static void system_exit_check (void)
+{
+    /* Both the main thread and the render thread check; only one
+       of them exits.  */
+    if (!__sync_bool_compare_and_swap (&system_exit_requested, 1, 2))
+        return;
+
+    /* Stop the update signal so that the exit handlers are not
+       interrupted.  */
+    if (system_timer_running)
+        timer_delete (system_timer);
+    system_timer_running = 0;
+    exit (system_exit_status);
+}
+
+
 typedef void (*sighandler_t)(int, siginfo_t *, void *);
 
 static int system_interrupt_init (sighandler_t handler, int rate)
 {
-    timer_t timerid;
     struct sigevent sev;
     struct itimerspec its;
     long long period_ns;
@@ -362,8 +1032,8 @@ static int system_interrupt_init (sighandler_t handler, int rate)
     /* Create the timer.  */
     sev.sigev_notify = SIGEV_SIGNAL;
     sev.sigev_signo = signum;
-    sev.sigev_value.sival_ptr = &timerid;
-    if (timer_create (CLOCK_REALTIME, &sev, &timerid) == -1)
+    sev.sigev_value.sival_ptr = &system_timer;
+    if (timer_create (CLOCK_REALTIME, &sev, &system_timer) == -1)
     {
         perror ("timer_create");
         exit (EXIT_FAILURE);
@@ -375,11 +1045,12 @@ static int system_interrupt_init (sighandler_t handler, int rate)
     its.it_value.tv_nsec = period_ns % 1000000000;
     its.it_interval.tv_sec = its.it_value.tv_sec;
     its.it_interval.tv_nsec = its.it_value.tv_nsec;
-    if (timer_settime (timerid, 0, &its, NULL) == -1)
+    if (timer_settime (system_timer, 0, &its, NULL) == -1)
     {
         perror ("timer_settime");
         exit (EXIT_FAILURE);
     }
+    system_timer_running = 1;
     
     /* Unlock the timer signal, so that timer notification
        can be delivered.  */
@@ -394,9 +1065,206 @@ static int system_interrupt_init (sighandler_t handler, int rate)
 }
 
 
+/** Return the time (us), either real or virtual.  */
+uint64_t system_time_us (void)
+{
+    struct timespec time;
+
+    if (system_virtual)
+        return system_virtual_us;
+
+    clock_gettime (CLOCK_MONOTONIC, &time);
+    return (uint64_t)time.tv_sec * 1000000 + time.tv_nsec / 1000;
+}
+
+
+/* Set the virtual time, waiting for the other boards to catch up
+   when run by the simulator.  */
+static void system_virtual_set (uint64_t us)
+{
+    system_virtual_us = us;
+    if (system_sim)
+        system_sim->advance (system_board, us);
+}
+
+
+/** Sleep for a while; with a virtual clock this advances the clock,
+    running the updates that are due.  */
+void system_sleep_us (uint64_t us)
+{
+    uint64_t when;
+
+    system_exit_check ();
+
+    if (!system_virtual)
+    {
+        usleep (us);
+        return;
+    }
+
+    when = system_virtual_us + us;
+    while (system_virtual_update_us <= when)
+    {
+        system_virtual_set (system_virtual_update_us);
+        system_virtual_update_us += 1000000 / SYSTEM_UPDATE_RATE;
+        system_update ();
+        system_exit_check ();
+    }
+    system_virtual_set (when);
+}
+
+
+/** Return non-zero if running on a virtual clock.  */
+bool system_virtual_p (void)
+{
+    return system_virtual;
+}
+
+
+static void system_sfr_print (void)
+{
+    unsigned int i;
+    int j;
+
+    for (j = 0; j < 2; j++)
+    {
+        if (system_sim)
+            fprintf (stderr, "board%d ", system_board);
+        fprintf (stderr, "sfr %s:", j ? "writes" : "reads");
+        for (i = 0; i < ARRAY_SIZE (system_sfrs); i++)
+        {
+            uint32_t count;
+
+            count = j ? system_sfrs[i].writes : system_sfrs[i].reads;
+            if (count)
+                fprintf (stderr, " %s=%u", system_sfrs[i].name, count);
+        }
+        fprintf (stderr, "\n");
+    }
+
+    if (system_sfr_trace)
+        fclose (system_sfr_trace);
+}
+
+
+/* Count an access to a register and trace it.  */
+static void system_sfr_access (const volatile void *reg, bool write,
+                               uint16_t value)
+{
+    const char *filename;
+    system_sfr_t *sfr = 0;
+    unsigned int i;
+
+    if (!system_sfr_started)
+    {
+        system_sfr_started = 1;
+        filename = system_getenv ("UCFK4_SFR_TRACE");
+        if (filename && *filename)
+        {
+            system_sfr_trace = fopen (filename, "w");
+            if (!system_sfr_trace)
+                perror (filename);
+        }
+        atexit (system_sfr_print);
+    }
+
+    for (i = 0; i < ARRAY_SIZE (system_sfrs); i++)
+    {
+        if (system_sfrs[i].reg == reg)
+        {
+            sfr = &system_sfrs[i];
+            break;
+        }
+    }
+    if (!sfr)
+        return;
+
+    if (write)
+    {
+        sfr->writes++;
+        system_sfr_accesses.writes++;
+    }
+    else
+    {
+        sfr->reads++;
+        system_sfr_accesses.reads++;
+    }
+
+    if (system_sfr_trace)
+        fprintf (system_sfr_trace, "%lu %c %s 0x%02x\n", system_ticks,
+                 write ? 'W' : 'R', sfr->name, value);
+}
+
+
+uint16_t avrtest_read (const volatile void *reg, uint8_t size)
+{
+    uint16_t value;
+
+    value = size == 2 ? *(const volatile uint16_t *)reg
+        : *(const volatile uint8_t *)reg;
+    system_sfr_access (reg, 0, value);
+    return value;
+}
+
+
+void avrtest_write (volatile void *reg, uint8_t size, uint16_t value)
+{
+    if (size == 2)
+        *(volatile uint16_t *)reg = value;
+    else
+        *(volatile uint8_t *)reg = value;
+    system_sfr_access (reg, 1, value);
+}
+
+
+avrtest_accesses_t avrtest_accesses_get (void)
+{
+    return system_sfr_accesses;
+}
+
+
+const char *system_getenv (const char *name)
+{
+    if (system_sim)
+        return system_sim->getenv (system_board, name);
+    return getenv (name);
+}
+
+
+void system_sim_attach (const system_sim_t *sim, int board)
+{
+    system_sim = sim;
+    system_board = board;
+}
+
+
 void system_init (void)
 {
+    const char *str;
+
+    /* The simulator always runs on a virtual clock and handles the
+       signals itself.  */
+    if (!system_sim)
+    {
+        signal (SIGINT, system_exit_handler);
+        signal (SIGTERM, system_exit_handler);
+    }
+
+    /* Unconnected inputs read high and the transmit data register is
+       empty after reset.  */
+    PINB = PINC = PIND = 0xff;
+    UCSR1A = BIT (UDRE1);
+
+    str = system_getenv ("UCFK4_VIRTUAL");
+    system_virtual = system_sim || (str && atoi (str) != 0);
+
     system_keyboard_init ();
+    system_input_init ();
+    system_trace_init ();
 
-    system_interrupt_init (system_handler, SYSTEM_UPDATE_RATE);
+    if (!system_virtual)
+    {
+        system_render_init ();
+        system_interrupt_init (system_handler, SYSTEM_UPDATE_RATE);
+    }
 }
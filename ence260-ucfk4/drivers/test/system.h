@@ -71,4 +71,54 @@ typedef uint8_t bool;
 
 void system_init (void);
 
+
+/** Return the time (us) since some arbitrary point.  This is virtual
+    time if UCFK4_VIRTUAL is set, see system.c.  */
+uint64_t system_time_us (void);
+
+
+/** Sleep for a while, or with a virtual clock advance it.
+    @param us time to sleep (us).  */
+void system_sleep_us (uint64_t us);
+
+
+/** Return non-zero if running on a virtual clock.  */
+bool system_virtual_p (void);
+
+
+/** Register an array of 16 bit counters to be printed to stderr when
+    the program exits.
+    @param name name of module
+    @param fields array of counter names
+    @param counters pointer to counters
+    @param num number of counters.  */
+void system_stats_register (const char *name, const char * const *fields,
+                            const uint16_t *counters, uint8_t num);
+
+
+/** Return the value of a setting, normally the environment variable
+    of the same name.  Under the simulator each board can have its own
+    settings.  */
+const char *system_getenv (const char *name);
+
+
+/** Hooks provided by the multi-board simulator, sim/ucfk4sim.c.  */
+typedef struct system_sim_struct
+{
+    /** Return the setting for a board or NULL if not set.  */
+    const char *(*getenv) (int board, const char *name);
+    /** Block until the other boards reach the virtual time (us).  */
+    void (*advance) (int board, uint64_t us);
+    /** Show the display; a byte of lit columns per row.  */
+    void (*display) (int board, const uint8_t *image);
+    /** Finish the board; this does not return.  */
+    void (*exit) (int board);
+} system_sim_t;
+
+
+/** Attach the scaffold to the simulator.  This is called by the
+    simulator before main so that the board runs on the common
+    virtual clock.  */
+void system_sim_attach (const system_sim_t *sim, int board);
+
 #endif
@@ -7,17 +7,57 @@
 #include "unistd.h"
 #include "time.h"
 #include "system.h"
+#include "avrtest.h"
 
 #include <stdio.h>
 
 static timer_tick_t offset;
 
+static timer_alarm_handler_t alarm_handler;
+static timer_tick_t alarm_when;
+static bool alarm_active;
+static bool alarm_running;
+
+
+/* Get current time in ticks.  */
+static timer_tick_t timer_now (void)
+{
+    uint64_t ticks;
+
+    ticks = system_time_us () * TIMER_RATE / 1000000;
+
+    return (timer_tick_t) ticks - offset;
+}
+
 
 /* Initialise timer.  */
 void timer_init (void)
 {
+    /* Configure timer/counter 1 as the AVR driver does for a clock
+       divisor of 256.  */
+    AVRTEST_WRITE (TCCR1A, 0x00);
+    AVRTEST_WRITE (TCCR1B, 0x04);
+    AVRTEST_WRITE (TCNT1, 0);
+
     /* Save offset so timer starts around 0.  */
-    offset = timer_get ();
+    offset = timer_now ();
+}
+
+
+/* Call the alarm handler if the alarm time has passed.  The handler
+   may set another alarm that is also due.  */
+static void timer_alarm_check (timer_tick_t now)
+{
+    if (alarm_running)
+        return;
+
+    alarm_running = 1;
+    while (alarm_active && (timer_tick_t)(now - alarm_when) < 32768u)
+    {
+        alarm_active = 0;
+        alarm_handler (alarm_when);
+    }
+    alarm_running = 0;
 }
 
 
@@ -25,16 +65,17 @@ void timer_init (void)
     @return current time in ticks.  */
 timer_tick_t timer_get (void)
 {
-    struct timespec time;
-    uint64_t time_us;
-    uint64_t ticks;
-
-    clock_gettime (CLOCK_MONOTONIC, &time);
+    timer_tick_t now;
 
-    time_us = time.tv_sec * 1000000 + time.tv_nsec / 1000;
-    ticks = time_us * TIMER_RATE / 1000000;
+    /* Make sure that a loop polling the timer sees it advance.  */
+    if (system_virtual_p ())
+        system_sleep_us (1);
 
-    return (timer_tick_t) ticks - offset;
+    /* The counter runs by itself; the driver reads it.  */
+    TCNT1 = timer_now ();
+    now = AVRTEST_READ (TCNT1);
+    timer_alarm_check (now);
+    return now;
 }
 
 
@@ -58,7 +99,11 @@ timer_tick_t timer_wait_until (timer_tick_t when)
 
         diff = when - now;
 
-        usleep (diff * 1e6 / TIMER_RATE);
+        /* Wake up in time for the alarm.  */
+        if (alarm_active && (timer_tick_t)(alarm_when - now) < diff)
+            diff = alarm_when - now;
+
+        system_sleep_us (diff * 1e6 / TIMER_RATE);
     }
 }
 
@@ -70,3 +115,19 @@ timer_tick_t timer_wait (timer_tick_t period)
 {
     return timer_wait_until (timer_get () + period);
 }
+
+
+/** Set an alarm.  */
+void timer_alarm_set (timer_tick_t when, timer_alarm_handler_t handler)
+{
+    alarm_handler = handler;
+    alarm_when = when;
+    alarm_active = 1;
+}
+
+
+/** Cancel alarm.  */
+void timer_alarm_cancel (void)
+{
+    alarm_active = 0;
+}
@@ -0,0 +1,256 @@
+#!/usr/bin/env python2
+"""displaytrace V0.10
+Copyright (c) 2026 agent
+
+This program reads a display trace recorded by the test scaffold
+(run a test program with UCFK4_TRACE=filename) and prints statistics
+for each LED or exports the trace as an animation.  See
+drivers/test/system.c for the trace format.
+
+For each LED the statistics are:
+
+duty     percentage of the time the LED was driven
+rate     number of times a second the LED was turned on
+flicker  percent flicker, 100 (max - min) / (max + min), of the
+         persistence-filtered brightness while the LED appeared lit
+mean     mean filtered brightness (0 to 100) while the LED appeared lit
+
+For a multiplexed display the rate is the refresh rate and the duty
+is the brightness.  A small rate or large flicker shows a display
+that will be seen to flicker; an uneven duty or mean brightness shows
+a display that is not uniform.  An LED appears lit when its filtered
+brightness is greater than 1, as for the scaffold display.
+
+Usage: displaytrace [options] trace
+
+Options:
+    --pgm filename    write frames of filtered brightness to PGM file
+    --pbm filename    write frames of lit LEDs to PBM file
+    --fps rate        frame rate for export (default 50)
+    --scale n         size in pixels of each LED for export (default 1)
+    --start time      start time (s) for statistics and export
+    --stop time       stop time (s) for statistics and export
+
+The exported frames are concatenated into one file; most Netpbm
+tools and image viewers treat this as an animation, for example,
+ppmtompeg or convert file.pgm file.gif.
+
+Examples:
+UCFK4_TRACE=bounce1.udt ./bounce1
+displaytrace bounce1.udt
+displaytrace --pgm bounce1.pgm --scale 8 bounce1.udt
+"""
+
+import sys
+import struct
+from optparse import OptionParser
+
+
+class Trace (object):
+
+    def __init__ (self, filename):
+
+        infile = open (filename, 'rb')
+        data = infile.read ()
+        infile.close ()
+
+        if len (data) < 8 or data[0:4] != b'UDT1':
+            raise ValueError ('%s: not a display trace' % filename)
+
+        self.rows, self.cols, self.rate = struct.unpack ('<BBH', data[4:8])
+        size = 4 + self.rows + self.rows * self.cols
+
+        # Each record is (tick, on, brightness) where on and
+        # brightness are indexed by row * cols + col.
+        self.records = []
+        for offset in range (8, len (data) - size + 1, size):
+            record = data[offset : offset + size]
+            tick = struct.unpack ('<I', record[0:4])[0]
+            rows = bytearray (record[4 : 4 + self.rows])
+            on = [(rows[row] >> col) & 1 for row in range (self.rows)
+                  for col in range (self.cols)]
+            brightness = list (bytearray (record[4 + self.rows:]))
+            self.records.append ((tick, on, brightness))
+
+    def spans (self, start, stop):
+        """Generate (ticks, on, brightness) for each record clipped
+        to start and stop ticks."""
+
+        for i in range (len (self.records) - 1):
+            begin = max (self.records[i][0], start)
+            end = min (self.records[i + 1][0], stop)
+            if end > begin:
+                yield (end - begin, self.records[i][1], self.records[i][2])
+
+    def duration (self):
+
+        return self.records[-1][0]
+
+
+def stats_print (trace, start, stop):
+
+    num = trace.rows * trace.cols
+    on_ticks = [0] * num
+    lit_ticks = [0] * num
+    lit_sum = [0] * num
+    ons = [0] * num
+    bmin = [None] * num
+    bmax = [None] * num
+    previous = [0] * num
+    total = 0
+
+    for ticks, on, brightness in trace.spans (start, stop):
+        total += ticks
+        for i in range (num):
+            if on[i]:
+                on_ticks[i] += ticks
+                if not previous[i]:
+                    ons[i] += 1
+            previous[i] = on[i]
+
+            if brightness[i] > 1:
+                lit_ticks[i] += ticks
+                lit_sum[i] += brightness[i] * ticks
+                if bmin[i] is None or brightness[i] < bmin[i]:
+                    bmin[i] = brightness[i]
+                if bmax[i] is None or brightness[i] > bmax[i]:
+                    bmax[i] = brightness[i]
+
+    if not total:
+        print ('Empty trace')
+        return
+
+    seconds = float (total) / trace.rate
+    print ('%d records, %.3f s' % (len (trace.records), seconds))
+    print ('row col  duty%   rate/s  flicker%   mean')
+
+    means = []
+    for i in range (num):
+        row = i // trace.cols
+        col = i % trace.cols
+        duty = 100.0 * on_ticks[i] / total
+        rate = ons[i] / seconds
+        if lit_ticks[i]:
+            flicker = 100.0 * (bmax[i] - bmin[i]) / (bmax[i] + bmin[i])
+            mean = float (lit_sum[i]) / lit_ticks[i]
+            means.append (mean)
+            print ('%3d %3d %6.1f %8.1f %9.1f %6.1f'
+                   % (row, col, duty, rate, flicker, mean))
+        else:
+            print ('%3d %3d %6.1f %8.1f         -      -'
+                   % (row, col, duty, rate))
+
+    if means:
+        print ('Uniformity (min / max mean brightness): %.2f'
+               % (min (means) / max (means)))
+
+
+def export (trace, filename, fps, scale, start, stop, grey):
+
+    outfile = open (filename, 'wb')
+
+    width = trace.cols * scale
+    height = trace.rows * scale
+    tick = float (start)
+    step = float (trace.rate) / fps
+    frames = 0
+    index = 0
+
+    while tick < stop:
+        # Find the record in force at this time.
+        while (index + 1 < len (trace.records)
+               and trace.records[index + 1][0] <= tick):
+            index += 1
+        brightness = trace.records[index][2]
+
+        if grey:
+            outfile.write (('P5\n%d %d\n100\n' % (width, height)).encode ())
+        else:
+            outfile.write (('P4\n%d %d\n' % (width, height)).encode ())
+
+        for row in range (trace.rows):
+            if grey:
+                line = bytearray ()
+                for col in range (trace.cols):
+                    line += bytearray ([brightness[row * trace.cols + col]]) * scale
+            else:
+                # PBM rows are packed 8 pixels a byte, MSB first, with
+                # 1 for black so a lit LED is 0 (white).
+                bits = []
+                for col in range (trace.cols):
+                    bits += [brightness[row * trace.cols + col] <= 1] * scale
+                bits += [0] * (-len (bits) % 8)
+                line = bytearray ()
+                for i in range (0, len (bits), 8):
+                    byte = 0
+                    for bit in bits[i : i + 8]:
+                        byte = (byte << 1) | bit
+                    line.append (byte)
+            for i in range (scale):
+                outfile.write (bytes (line))
+
+        frames += 1
+        tick += step
+
+    outfile.close ()
+    print ('Wrote %d frames to %s' % (frames, filename))
+
+
+def main (argv = None):
+
+    if argv is None:
+        argv = sys.argv
+
+    version = __doc__.split ('\n')[0]
+
+    parser = OptionParser (usage = '%prog [options] trace', version = version,
+                           description = __doc__)
+
+    parser.add_option ('--pgm', dest = 'pgm', default = None,
+                       help = 'write frames of filtered brightness to PGM file')
+    parser.add_option ('--pbm', dest = 'pbm', default = None,
+                       help = 'write frames of lit LEDs to PBM file')
+    parser.add_option ('--fps', dest = 'fps', type = 'float', default = 50,
+                       help = 'frame rate for export')
+    parser.add_option ('--scale', dest = 'scale', type = 'int', default = 1,
+                       help = 'size in pixels of each LED for export')
+    parser.add_option ('--start', dest = 'start', type = 'float', default = 0,
+                       help = 'start time (s)')
+    parser.add_option ('--stop', dest = 'stop', type = 'float', default = None,
+                       help = 'stop time (s)')
+
+    (options, args) = parser.parse_args ()
+
+    if len (args) != 1:
+        parser.print_usage ()
+        return 1
+
+    try:
+        trace = Trace (args[0])
+    except (IOError, ValueError) as e:
+        sys.stderr.write ('%s\n' % e)
+        return 1
+
+    if len (trace.records) < 2:
+        sys.stderr.write ('%s: trace too short\n' % args[0])
+        return 1
+
+    start = int (options.start * trace.rate)
+    stop = trace.duration ()
+    if options.stop is not None:
+        stop = min (stop, int (options.stop * trace.rate))
+
+    stats_print (trace, start, stop)
+
+    if options.pgm:
+        export (trace, options.pgm, options.fps, options.scale,
+                start, stop, True)
+    if options.pbm:
+        export (trace, options.pbm, options.fps, options.scale,
+                start, stop, False)
+
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit (main ())
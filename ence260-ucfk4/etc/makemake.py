@@ -15,6 +15,7 @@ or     makemake --template template directory search-dirs
 or     makemake --builddir builddir --objext objext --template template directory search-dirs
 or     makemake --builddir builddir --modules --relpath  directory search-dirs
 or     makemake --builddir builddir --files --relpath  directory search-dirs
+or     makemake --report --cc cc --cflags cflags --size size --flash-max bytes --sram-max bytes directory search-dirs
 
 By default makemake will create a rule like foo.o: foo.c bar.h
 and this will require a VPATH if the dependencies are another directory.
@@ -37,6 +38,13 @@ There are special strings that are replaced in the template file:
 Note, the callgraph generation requires non-documented behaviour of
 gcc.   This is likely to change.
 
+The --report option is run after linking.  It prints the .text, .data,
+and .bss sizes of each object file and the executable, and the
+worst-case stack depth found from the callgraph and the frame sizes
+from gcc -fstack-usage.  It exits with status 1 if the flash (.text +
+.data) or SRAM (.data + .bss + stack) exceeds the given budget.  With
+--outfile, the report is also written to a file when within budget.
+
 """
 
 # See http://www.amk.ca/python/howto/regex/ for regular expressions in python.
@@ -52,6 +60,9 @@ import sys
 import re
 import os
 import subprocess
+import tempfile
+import shutil
+import glob
 from os import pathsep
 import os.path
 from optparse import OptionParser
@@ -63,7 +74,7 @@ def unique(list):
     for item in list:
         dict[item] = True;
 
-    return dict.keys()
+    return [item for item in dict]
 
 
 def file_search(filename, search_path, debug):
@@ -246,7 +257,7 @@ def subprocess_command(command):
     p = subprocess.Popen(command, shell=True,
                          stdin=subprocess.PIPE,
                          stdout=subprocess.PIPE,
-                         close_fds=True)
+                         close_fds=True, universal_newlines=True)
     
     child_stdout, child_stdin = (p.stdout, p.stdin)
     child_stdin.close()
@@ -269,29 +280,79 @@ def maincfilename_find(dirname):
     return filelist[0]
 
 
-def functions_find(filepath, functiondeps, functions, options):
+def stack_usage_read(filename, frames):
+    """Read the stack usage of each function from a .su file created
+    by gcc -fstack-usage.  Each line is file:line:col:function followed
+    by the number of bytes and a qualifier (static, dynamic, bounded).
+    """
 
-    command = options.compile + ' -c ' + filepath + ' -fdump-tree-cfg-raw -DDEBUG > /dev/null'
-    if options.debug:
-        print(command, file=sys.stderr)
-    os.system(command)
+    file = open(filename, 'r')
+    text = file.readlines()
+    file.close()
+
+    for line in text:
+        fields = line.strip().split('\t')
+        if len(fields) < 3:
+            continue
+        function = fields[0].split(':')[-1]
+        frames[function] = (int(fields[1]), fields[2])
+
+
+def arguments_count(arguments):
+    """Count the comma separated arguments, ignoring commas within
+    parentheses such as for function pointer types."""
+
+    if arguments.strip() == '':
+        return 0
+
+    count = 1
+    level = 0
+    for char in arguments:
+        if char == '(':
+            level += 1
+        elif char == ')':
+            level -= 1
+        elif char == ',' and level == 0:
+            count += 1
+    return count
+
+
+def functions_find(filepath, functiondeps, functions, options, info=None):
+    """Find the functions defined in filepath and the functions they
+    call.  If info is a dictionary, the stack usage of each function
+    is also found (info['frames']), with the number of arguments of
+    each function (info['arities']), the number of arguments of each
+    call through a function pointer (info['indirect']), and the names
+    that may be the addresses of functions (info['addressed']).
+    """
 
-    version = subprocess_command(options.compile + ' -dumpversion').strip()
+    # Compile into a temporary directory so that the object files
+    # of the build are not clobbered.  gcc writes the dump files
+    # alongside the object file.
+    tmpdir = tempfile.mkdtemp(prefix='makemake')
+    base = os.path.splitext(os.path.basename(filepath))[0]
 
-    if version >= '4.9.2':
-        ext = '.011t.cfg'
-    elif version > '4.5.3':
-        ext = '.014t.cfg'
+    command = options.compile + ' -c ' + filepath + ' -o ' + os.path.join(tmpdir, base + '.o') + ' -fdump-tree-cfg-raw'
+    if info is None:
+        command = command + ' -DDEBUG'
     else:
-        ext = '.012t.cfg'
+        command = command + ' -fstack-usage'
+    command = command + ' > /dev/null'
+    if options.debug:
+        print(command, file=sys.stderr)
+    status = os.system(command)
 
-    rtlfilename = os.path.abspath(os.path.basename(filepath)) + ext
+    # The dump file suffix, such as .011t.cfg, depends on the gcc
+    # version.  There is no dump if there are no functions.
+    rtlfilenames = glob.glob(os.path.join(tmpdir, '*.cfg'))
 
-    if not os.path.exists(rtlfilename):
-        print('Could not find %s to generate callgraph' % rtlfilename, file=sys.stderr)
+    if not rtlfilenames:
+        if status:
+            print('Could not find cfg dump for %s to generate callgraph' % filepath, file=sys.stderr)
+        shutil.rmtree(tmpdir)
         return
 
-    file = open(rtlfilename, 'r')
+    file = open(rtlfilenames[0], 'r')
     text = file.readlines()
     file.close()
 
@@ -313,6 +374,30 @@ def functions_find(filepath, functiondeps, functions, options):
             else:
                 print(matches[0], 'used outside function in', filepath, file=sys.stderr)
 
+        if info is None or not function:
+            continue
+
+        #  void tune_task (void * data)
+        matches = re.findall(r'^[^;].* ' + re.escape(function) + r' [(](.*)[)]$', line)
+        if matches and function not in info['arities']:
+            info['arities'][function] = arguments_count(matches[0])
+
+        #  gimple_call <_3, NULL, _4>
+        matches = re.findall(r'gimple_call <(.*)>', line)
+        if matches:
+            fields = [field.strip() for field in matches[0].split(',')]
+            if re.match(r'_[0-9]+$', fields[0]):
+                info['indirect'].setdefault(function, []).append(len(fields) - 2)
+            # A function passed as an argument, such as a callback.
+            for field in fields[2:]:
+                if re.match(r'[a-zA-Z_]\w*$', field):
+                    info['addressed'][field] = True
+
+        #  gimple_assign <addr_expr, tasks[0].func, display_task, NULL>
+        matches = re.findall(r'.*gimple_assign <addr_expr, [\w\[\].]*, ([\w]*)', line)
+        if matches:
+            info['addressed'][matches[0]] = True
+
     # Search for where a function address is taken
     function = None
     for line in text:
@@ -321,21 +406,24 @@ def functions_find(filepath, functiondeps, functions, options):
             function = matches[0]
         #  gimple_assign <addr_expr, tasks[0].func, display_task, NULL>
         matches = re.findall(r'.*gimple_assign <addr_expr, [\w\[\].]*, ([\w]*)', line)
-        if matches and functiondeps.has_key(matches[0]):
+        if matches and matches[0] in functiondeps:
             # This is an indirect link
             functiondeps[function].append('@' + matches[0])
 
-    command = 'rm ' + rtlfilename
+    if info is not None:
+        for sufilename in glob.glob(os.path.join(tmpdir, '*.su')):
+            stack_usage_read(sufilename, info['frames'])
+
     if options.debug:
-        print(command, file=sys.stderr)
-    os.system(command)
+        print('rm -r ' + tmpdir, file=sys.stderr)
+    shutil.rmtree(tmpdir)
 
 
 def files_find(filepath, search_path, filedeps, moduledeps, indent, debug):
 
     # filedeps is a cache of all known included files
 
-    if filedeps.has_key(filepath):
+    if filepath in filedeps:
         return
 
     # Find included header files
@@ -378,7 +466,7 @@ def files_find(filepath, search_path, filedeps, moduledeps, indent, debug):
 
 def alldeps_print(depsdir, options):
 
-    for target in depsdir.keys():
+    for target in depsdir:
 
         targetbase = os.path.basename(target)
         if targetbase in options.exclude:
@@ -394,9 +482,9 @@ def alldeps_print(depsdir, options):
 
 def deps_print(target, depsdir, options, record={}):
 
-    if record.has_key(target):
+    if target in record:
         return
-    if not depsdir.has_key(target):
+    if target not in depsdir:
         return
     
     deps = depsdir[target]
@@ -419,9 +507,9 @@ def deps_print(target, depsdir, options, record={}):
 
 def callgraph_print(target, functiondeps, functions, options, record={}):
 
-    if record.has_key(target):
+    if target in record:
         return
-    if not functiondeps.has_key(target):
+    if target not in functiondeps:
         return
     
     deps = functiondeps[target]
@@ -445,6 +533,154 @@ def callgraph_print(target, functiondeps, functions, options, record={}):
 
 
 
+def stack_depth(target, functiondeps, info, options, record, active):
+    """Return the worst-case stack depth (bytes) of a call to target
+    and the call chain as a list of (function, bytes) pairs.  A call
+    through a function pointer is assumed to call any function whose
+    address is taken and that has the same number of arguments.
+    Library functions, which have no known frame, are ignored.
+    """
+
+    if target in record:
+        return record[target]
+
+    if target in active:
+        if target not in info['recursive']:
+            info['recursive'][target] = True
+            print('Recursion in %s; stack depth is unbounded' % target, file=sys.stderr)
+        return 0, [(target + ' (recursive)', 0)]
+
+    frame, qualifier = info['frames'].get(target, (0, 'static'))
+    frame = frame + options.return_size
+    name = target
+    if 'dynamic' in qualifier:
+        name = name + ' (dynamic)'
+
+    callees = []
+    for dep in functiondeps.get(target, []):
+        if dep in functiondeps:
+            callees.append(dep)
+    for arity in info['indirect'].get(target, []):
+        callees.extend([function for function in info['addressed']
+                        if info['arities'].get(function) == arity])
+
+    active.append(target)
+    depth = 0
+    chain = []
+    for callee in unique(callees):
+        if callee == target:
+            continue
+        depth1, chain1 = stack_depth(callee, functiondeps, info, options,
+                                     record, active)
+        if depth1 > depth:
+            depth, chain = depth1, chain1
+    active.pop()
+
+    record[target] = (frame + depth, [(name, frame)] + chain)
+    return record[target]
+
+
+def size_get(filename, options):
+    """Return the text, data, and bss sizes of an object file."""
+
+    output = subprocess_command(options.size + ' ' + filename)
+    lines = output.strip().split('\n')
+    if len(lines) < 2:
+        return None
+
+    fields = lines[-1].split()
+    return int(fields[0]), int(fields[1]), int(fields[2])
+
+
+def report_print(options, maincfilename, cfilelist):
+    """Print the memory used by each module and the worst-case stack
+    depth and check these against the flash and SRAM budgets.  Flash
+    holds the text and the initial values of the data; SRAM holds the
+    data, the bss, and the stack.  Return non-zero if over budget."""
+
+    project = os.path.splitext(os.path.basename(maincfilename))[0]
+    exefilename = os.path.join(options.builddir, project + options.exeext)
+
+    lines = []
+    lines.append('Memory report for %s' % project)
+    lines.append('%-16s %7s %7s %7s' % ('module', 'text', 'data', 'bss'))
+
+    for cfile in sorted(cfilelist):
+        ofile = os.path.join(options.builddir, re.sub(r'[.]c$', options.objext, os.path.basename(cfile)))
+        sizes = size_get(ofile, options)
+        if not sizes:
+            print('Could not find size of %s' % ofile, file=sys.stderr)
+            return 1
+        lines.append('%-16s %7d %7d %7d' % ((os.path.basename(ofile),) + sizes))
+
+    sizes = size_get(exefilename, options)
+    if not sizes:
+        print('Could not find size of %s' % exefilename, file=sys.stderr)
+        return 1
+    text, data, bss = sizes
+    lines.append('%-16s %7d %7d %7d' % (os.path.basename(exefilename), text, data, bss))
+
+    functiondeps = {}
+    functions = {}
+    info = {'frames': {}, 'arities': {}, 'indirect': {}, 'addressed': {},
+            'recursive': {}}
+    for cfile in cfilelist:
+        functions_find(cfile, functiondeps, functions, options, info)
+
+    # Only keep the names of functions that are defined.
+    info['addressed'] = [function for function in info['addressed']
+                         if function in functiondeps]
+
+    # Interrupt handlers do not nest so the worst case is the deepest
+    # handler called from the deepest point of main.
+    record = {}
+    depth, chain = stack_depth('main', functiondeps, info, options,
+                               record, [])
+    isr_depth = 0
+    isr_chain = []
+    for function in functiondeps:
+        if function.startswith('__vector_'):
+            depth1, chain1 = stack_depth(function, functiondeps, info,
+                                         options, record, [])
+            if depth1 > isr_depth:
+                isr_depth, isr_chain = depth1, chain1
+
+    lines.append('')
+    lines.append('stack main %d: %s' % (depth, ' -> '.join(['%s %d' % item for item in chain])))
+    if isr_chain:
+        lines.append('stack interrupt %d: %s' % (isr_depth, ' -> '.join(['%s %d' % item for item in isr_chain])))
+
+    flash = text + data
+    sram = data + bss + depth + isr_depth
+    lines.append('flash %d bytes' % flash
+                 + (' of %d (%d%%)' % (options.flash_max, 100 * flash // options.flash_max) if options.flash_max else ''))
+    lines.append('sram %d bytes (%d static + %d stack)' % (sram, data + bss, depth + isr_depth)
+                 + (' of %d (%d%%)' % (options.sram_max, 100 * sram // options.sram_max) if options.sram_max else ''))
+
+    report = '\n'.join(lines) + '\n'
+    print(report, end='')
+
+    status = 0
+    if options.flash_max and flash > options.flash_max:
+        print('%s: flash %d bytes exceeds budget of %d' % (project, flash, options.flash_max), file=sys.stderr)
+        status = 1
+    if options.sram_max and sram > options.sram_max:
+        print('%s: sram %d bytes exceeds budget of %d' % (project, sram, options.sram_max), file=sys.stderr)
+        status = 1
+
+    # Only write the report when within budget so that make tries again.
+    if options.outfilename:
+        if status:
+            if os.path.exists(options.outfilename):
+                os.remove(options.outfilename)
+        else:
+            file = open(options.outfilename, 'w')
+            file.write(report)
+            file.close()
+
+    return status
+
+
 class Usage(Exception):
     def __init__(self, msg):
         self.msg = msg
@@ -491,6 +727,26 @@ def main(argv=None):
                       default='.out',
                       help='executable file extension')
     
+    parser.add_option('--report', action='store_true',
+                      dest='report', default=False,
+                      help='report memory use and check budgets')
+    
+    parser.add_option('--size', dest='size',
+                      default='size',
+                      help='size program name')
+    
+    parser.add_option('--flash-max', dest='flash_max', type='int',
+                      default=0,
+                      help='flash budget (bytes), 0 for none')
+    
+    parser.add_option('--sram-max', dest='sram_max', type='int',
+                      default=0,
+                      help='SRAM budget (bytes), 0 for none')
+    
+    parser.add_option('--return-size', dest='return_size', type='int',
+                      default=0,
+                      help='bytes pushed by each call for return address')
+    
     parser.add_option('--cc', dest='cc',
                       default='gcc',
                       help='compiler name')
@@ -580,6 +836,9 @@ def main(argv=None):
             functions_find(cfile, functiondeps, functions, options)
         callgraph_print('main', functiondeps, functions, options)
 
+    if options.report:
+        return report_print(options, maincfilename, cfilelist)
+
     if options.files:
         deps_print(outfile, filedeps, options)
 
@@ -0,0 +1,488 @@
+/** @file   ucfk4sim.c
+    @author agent
+    @date   19 October 2026
+    @brief  Run several simulated UCFK4 boards in one process.
+
+    @note Each board runs a test scaffold program built as a shared
+    object (make -f Makefile.test prog.so).  All the state of a
+    program, the scaffold's SFR and display as well as the globals of
+    the drivers and the application, is in the shared object so a
+    separate copy is loaded for each board and its main function is
+    run in its own thread.
+
+    The boards run on a common virtual clock.  A board only runs when
+    no other board is behind it, so a board that waits is held until
+    the others catch up and a character sent over the simulated IR
+    link is always sent before the virtual time it is received.  The
+    boards share the IR link of the scaffold (drivers/test/ir_uart.c);
+    each run uses its own link name.  The C library is shared, so
+    boards that call rand at the same virtual time are not
+    reproducible.
+
+    Usage: ucfk4sim [options] prog.so [prog.so ...]
+
+    Options:
+    -n boards              number of boards; the last program is
+                           repeated (default one per program, up to
+                           SIM_BOARDS_MAX)
+    -t seconds             stop after this virtual time
+    -e board:name=value    setting for a board, for example,
+                           -e 1:UCFK4_INPUT=player2.txt
+    -q                     do not show the displays
+
+    The settings of the scaffold, such as UCFK4_INPUT and the
+    UCFK4_IR_* link parameters, are otherwise taken from the
+    environment.  By default each board has UCFK4_IR_SEED set to its
+    board number plus the seed from the environment, if any.
+
+    The displays are shown side by side at up to UCFK4_FPS frames a
+    second of real time.  A program that never waits, say in
+    pacer_wait or timer_wait_until, holds up the other boards.
+*/
+#include "system.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+
+/* This is limited by the number of nodes of the simulated IR link.  */
+#define SIM_BOARDS_MAX 8
+
+#define SIM_SETTINGS_MAX 32
+
+#define SIM_FRAME_RATE 50
+
+/* Gap between displays.  */
+#define SIM_GAP 3
+
+
+typedef struct
+{
+    int board;
+    const char *name;
+    const char *value;
+} sim_setting_t;
+
+
+typedef struct
+{
+    const char *filename;
+    void *handle;
+    int (*main) (void);
+    pthread_t thread;
+    /* Virtual time (us) the board has reached.  */
+    uint64_t time;
+    bool running;
+    uint8_t image[LEDMAT_ROWS_NUM];
+    char seed[16];
+} sim_board_t;
+
+
+static sim_board_t sim_boards[SIM_BOARDS_MAX];
+static int sim_boards_num;
+
+static sim_setting_t sim_settings[SIM_SETTINGS_MAX];
+static int sim_settings_num;
+
+static char sim_link[32];
+static uint64_t sim_stop_us;
+
+static pthread_mutex_t sim_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sim_cond = PTHREAD_COND_INITIALIZER;
+
+static pthread_mutex_t sim_render_lock = PTHREAD_MUTEX_INITIALIZER;
+static volatile bool sim_render_stop;
+
+
+static const char *
+sim_getenv (int board, const char *name)
+{
+    const char *str;
+    int i;
+
+    for (i = 0; i < sim_settings_num; i++)
+    {
+        if (sim_settings[i].board == board
+            && !strcmp (sim_settings[i].name, name))
+            return sim_settings[i].value;
+    }
+
+    str = getenv (name);
+
+    if (!strcmp (name, "UCFK4_IR_LINK") && (!str || !*str))
+        return sim_link;
+
+    if (!strcmp (name, "UCFK4_IR_SEED"))
+    {
+        snprintf (sim_boards[board].seed, sizeof (sim_boards[board].seed),
+                  "%d", board + (str ? atoi (str) : 0));
+        return sim_boards[board].seed;
+    }
+    return str;
+}
+
+
+/* Return non-zero if a board other than this one is behind.  */
+static bool
+sim_behind_p (int board, uint64_t us)
+{
+    int i;
+
+    for (i = 0; i < sim_boards_num; i++)
+    {
+        if (i != board && sim_boards[i].running && sim_boards[i].time < us)
+            return 1;
+    }
+    return 0;
+}
+
+
+static void
+sim_exit (int board)
+{
+    pthread_mutex_lock (&sim_lock);
+    sim_boards[board].running = 0;
+    pthread_cond_broadcast (&sim_cond);
+    pthread_mutex_unlock (&sim_lock);
+
+    pthread_exit (NULL);
+}
+
+
+static void
+sim_advance (int board, uint64_t us)
+{
+    sim_board_t *this = &sim_boards[board];
+    uint64_t old;
+    int i;
+
+    if (sim_stop_us && us >= sim_stop_us)
+        sim_exit (board);
+
+    pthread_mutex_lock (&sim_lock);
+
+    old = this->time;
+    this->time = us;
+
+    /* Wake the boards that may have been waiting for this one.  */
+    for (i = 0; i < sim_boards_num; i++)
+    {
+        if (i != board && sim_boards[i].running && sim_boards[i].time > old)
+        {
+            pthread_cond_broadcast (&sim_cond);
+            break;
+        }
+    }
+
+    while (sim_behind_p (board, us))
+        pthread_cond_wait (&sim_cond, &sim_lock);
+
+    pthread_mutex_unlock (&sim_lock);
+}
+
+
+static void
+sim_display (int board, const uint8_t *image)
+{
+    pthread_mutex_lock (&sim_render_lock);
+    memcpy (sim_boards[board].image, image, LEDMAT_ROWS_NUM);
+    pthread_mutex_unlock (&sim_render_lock);
+}
+
+
+static const system_sim_t sim_hooks =
+{
+    .getenv = sim_getenv,
+    .advance = sim_advance,
+    .display = sim_display,
+    .exit = sim_exit
+};
+
+
+/* Return the virtual time (us) that all the running boards have
+   reached or, once they have all finished, the latest time.  */
+static uint64_t
+sim_time_us (void)
+{
+    uint64_t running = UINT64_MAX;
+    uint64_t latest = 0;
+    int i;
+
+    pthread_mutex_lock (&sim_lock);
+    for (i = 0; i < sim_boards_num; i++)
+    {
+        if (sim_boards[i].running && sim_boards[i].time < running)
+            running = sim_boards[i].time;
+        if (sim_boards[i].time > latest)
+            latest = sim_boards[i].time;
+    }
+    pthread_mutex_unlock (&sim_lock);
+    return running != UINT64_MAX ? running : latest;
+}
+
+
+/* Write the displays side by side with a single write.  */
+static void
+sim_render (bool last)
+{
+    char frame[(LEDMAT_ROWS_NUM + 2)
+               * (SIM_BOARDS_MAX * (LEDMAT_COLS_NUM + SIM_GAP) + 16) + 64];
+    uint8_t images[SIM_BOARDS_MAX][LEDMAT_ROWS_NUM];
+    int len = 0;
+    int board;
+    int row;
+    int col;
+
+    pthread_mutex_lock (&sim_render_lock);
+    for (board = 0; board < sim_boards_num; board++)
+        memcpy (images[board], sim_boards[board].image, LEDMAT_ROWS_NUM);
+    pthread_mutex_unlock (&sim_render_lock);
+
+    for (row = 0; row < LEDMAT_ROWS_NUM; row++)
+    {
+        for (board = 0; board < sim_boards_num; board++)
+        {
+            for (col = 0; col < LEDMAT_COLS_NUM; col++)
+                frame[len++] = images[board][row] & BIT (col) ? '@' : '.';
+            if (board < sim_boards_num - 1)
+                len += sprintf (frame + len, "%*s", SIM_GAP, "");
+        }
+        frame[len++] = '\n';
+    }
+    len += sprintf (frame + len, "\nt = %.3f s\n", sim_time_us () * 1e-6);
+    if (!last)
+    {
+        /* Move cursor up.  */
+        len += sprintf (frame + len, "\e[%dA", LEDMAT_ROWS_NUM + 2);
+    }
+
+    if (write (STDOUT_FILENO, frame, len) < 0)
+        sim_render_stop = 1;
+}
+
+
+static void *
+sim_render_thread (__unused__ void *arg)
+{
+    const char *str;
+    int frame_rate;
+
+    str = getenv ("UCFK4_FPS");
+    frame_rate = str ? atoi (str) : SIM_FRAME_RATE;
+    if (frame_rate <= 0)
+        frame_rate = SIM_FRAME_RATE;
+
+    /* The virtual time is shown so this renders every frame.  */
+    while (!sim_render_stop)
+    {
+        usleep (1000000 / frame_rate);
+        sim_render (0);
+    }
+    return NULL;
+}
+
+
+static void *
+sim_board_thread (void *arg)
+{
+    int board = (sim_board_t *)arg - sim_boards;
+
+    sim_boards[board].main ();
+    sim_exit (board);
+    return NULL;
+}
+
+
+/* Load a private copy of a program for a board.  A shared object is
+   only loaded once per file so each board gets a temporary copy.  */
+static void
+sim_board_load (int board, const char *filename)
+{
+    sim_board_t *this = &sim_boards[board];
+    void (*attach) (const system_sim_t *sim, int board);
+    char copy[] = "/tmp/ucfk4simXXXXXX";
+    char buffer[4096];
+    FILE *in;
+    int fd;
+    size_t len;
+
+    in = fopen (filename, "r");
+    fd = mkstemp (copy);
+    if (!in || fd < 0)
+    {
+        perror (!in ? filename : copy);
+        exit (EXIT_FAILURE);
+    }
+    while ((len = fread (buffer, 1, sizeof (buffer), in)) > 0)
+    {
+        if (write (fd, buffer, len) != (ssize_t)len)
+        {
+            perror (copy);
+            exit (EXIT_FAILURE);
+        }
+    }
+    fclose (in);
+    close (fd);
+
+    this->handle = dlopen (copy, RTLD_NOW | RTLD_LOCAL);
+    unlink (copy);
+    if (!this->handle)
+    {
+        fprintf (stderr, "%s\n", dlerror ());
+        exit (EXIT_FAILURE);
+    }
+
+    this->filename = filename;
+    this->main = (int (*) (void))dlsym (this->handle, "main");
+    attach = (void (*) (const system_sim_t *, int))
+        dlsym (this->handle, "system_sim_attach");
+    if (!this->main || !attach)
+    {
+        fprintf (stderr, "%s: not a test scaffold program\n", filename);
+        exit (EXIT_FAILURE);
+    }
+    attach (&sim_hooks, board);
+}
+
+
+static double
+sim_wall_time (void)
+{
+    struct timespec time;
+
+    clock_gettime (CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+
+static void
+sim_exit_handler (__unused__ int sig)
+{
+    exit (EXIT_FAILURE);
+}
+
+
+static void
+sim_usage (const char *name)
+{
+    fprintf (stderr, "Usage: %s [-n boards] [-t seconds] [-e board:name=value]"
+             " [-q] prog.so [prog.so ...]\n", name);
+    exit (EXIT_FAILURE);
+}
+
+
+int main (int argc, char **argv)
+{
+    const char *programs[SIM_BOARDS_MAX];
+    int programs_num = 0;
+    int boards_num = 0;
+    bool quiet = 0;
+    pthread_t render;
+    double start;
+    double wall;
+    int board;
+    int opt;
+
+    while ((opt = getopt (argc, argv, "n:t:e:q")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            boards_num = atoi (optarg);
+            break;
+
+        case 't':
+            sim_stop_us = atof (optarg) * 1e6;
+            break;
+
+        case 'e':
+            {
+                sim_setting_t *setting;
+                char *str;
+
+                str = strchr (optarg, '=');
+                if (sim_settings_num == SIM_SETTINGS_MAX
+                    || !strchr (optarg, ':') || !str)
+                    sim_usage (argv[0]);
+                *str = 0;
+                setting = &sim_settings[sim_settings_num++];
+                setting->board = atoi (optarg);
+                setting->name = strchr (optarg, ':') + 1;
+                setting->value = str + 1;
+            }
+            break;
+
+        case 'q':
+            quiet = 1;
+            break;
+
+        default:
+            sim_usage (argv[0]);
+        }
+    }
+
+    for (; optind < argc && programs_num < SIM_BOARDS_MAX; optind++)
+        programs[programs_num++] = argv[optind];
+    if (!programs_num || optind < argc)
+        sim_usage (argv[0]);
+
+    if (!boards_num)
+        boards_num = programs_num;
+    if (boards_num < programs_num || boards_num > SIM_BOARDS_MAX)
+    {
+        fprintf (stderr, "%s: between %d and %d boards\n", argv[0],
+                 programs_num, SIM_BOARDS_MAX);
+        exit (EXIT_FAILURE);
+    }
+
+    signal (SIGINT, sim_exit_handler);
+    signal (SIGTERM, sim_exit_handler);
+
+    snprintf (sim_link, sizeof (sim_link), "sim%d", getpid ());
+
+    for (board = 0; board < boards_num; board++)
+    {
+        sim_board_load (board, programs[board < programs_num
+                                        ? board : programs_num - 1]);
+        sim_boards[board].running = 1;
+    }
+    sim_boards_num = boards_num;
+
+    start = sim_wall_time ();
+    for (board = 0; board < sim_boards_num; board++)
+    {
+        if (pthread_create (&sim_boards[board].thread, NULL,
+                            sim_board_thread, &sim_boards[board]))
+        {
+            perror ("pthread_create");
+            exit (EXIT_FAILURE);
+        }
+    }
+
+    if (!quiet && pthread_create (&render, NULL, sim_render_thread, NULL))
+        quiet = 1;
+
+    for (board = 0; board < sim_boards_num; board++)
+        pthread_join (sim_boards[board].thread, NULL);
+    wall = sim_wall_time () - start;
+
+    if (!quiet)
+    {
+        sim_render_stop = 1;
+        pthread_join (render, NULL);
+        sim_render (1);
+    }
+
+    fprintf (stderr, "%d boards, %.3f s simulated in %.3f s\n",
+             sim_boards_num, sim_time_us () * 1e-6, wall);
+
+    /* This runs the exit handlers of the boards, such as those that
+       print the statistics.  */
+    exit (EXIT_SUCCESS);
+}
@@ -0,0 +1,45 @@
+/** @file   crc8.c
+    @author agent
+    @date   19 October 2026
+    @brief  8 bit cyclic redundancy check.
+*/
+#include "crc8.h"
+
+#define CRC8_POLY 0x07
+
+
+/** Update CRC with a byte of data.
+    @param crc current CRC value
+    @param data byte to add
+    @return new CRC value.  */
+uint8_t
+crc8_update (uint8_t crc, uint8_t data)
+{
+    uint8_t i;
+
+    crc ^= data;
+    for (i = 0; i < 8; i++)
+    {
+        if (crc & 0x80)
+            crc = (crc << 1) ^ CRC8_POLY;
+        else
+            crc <<= 1;
+    }
+    return crc;
+}
+
+
+/** Compute CRC of a buffer.
+    @param crc initial CRC value (usually CRC8_INIT)
+    @param data pointer to data
+    @param size number of bytes of data
+    @return CRC value.  */
+uint8_t
+crc8 (uint8_t crc, const void *data, uint8_t size)
+{
+    const uint8_t *p = data;
+
+    while (size--)
+        crc = crc8_update (crc, *p++);
+    return crc;
+}
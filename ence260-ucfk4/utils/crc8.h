@@ -0,0 +1,39 @@
+/** @file   crc8.h
+    @author agent
+    @date   19 October 2026
+    @brief  8 bit cyclic redundancy check.
+
+    @defgroup crc8 8 bit cyclic redundancy check
+
+    This module computes an 8 bit CRC using the polynomial x^8 + x^2 +
+    x + 1 (0x07).  This detects all single, double, and odd numbers of
+    bit errors and all burst errors up to 8 bits in messages of up to
+    127 bytes.  The CRC is computed a bit at a time to save the 256
+    bytes of flash that a lookup table would need.
+*/
+
+#ifndef CRC8_H
+#define CRC8_H
+
+#include "system.h"
+
+
+/** Initial value for a CRC computation.  */
+#define CRC8_INIT 0
+
+
+/** Update CRC with a byte of data.
+    @param crc current CRC value
+    @param data byte to add
+    @return new CRC value.  */
+uint8_t crc8_update (uint8_t crc, uint8_t data);
+
+
+/** Compute CRC of a buffer.
+    @param crc initial CRC value (usually CRC8_INIT)
+    @param data pointer to data
+    @param size number of bytes of data
+    @return CRC value.  */
+uint8_t crc8 (uint8_t crc, const void *data, uint8_t size);
+
+#endif
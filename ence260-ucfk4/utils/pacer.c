@@ -8,6 +8,7 @@
 #include "pacer.h"
 
 static timer_tick_t pacer_period;
+static timer_tick_t pacer_when;
 
 
 /** Initialise pacer:
@@ -23,8 +24,15 @@ void pacer_init (pacer_rate_t pacer_rate)
 /** Wait until next pacer tick.  */
 void pacer_wait (void)
 {
-    static timer_tick_t when = 0;
+    timer_wait_until (pacer_when);
+    pacer_when += pacer_period;
+}
+
 
-    timer_wait_until (when);
-    when += pacer_period;
+/** Move the next pacer tick.
+    @param ticks number of timer ticks to delay the next tick by; this
+    is negative to advance it.  */
+void pacer_adjust (int16_t ticks)
+{
+    pacer_when += ticks;
 }
@@ -39,6 +39,13 @@ typedef uint16_t pacer_rate_t;
 extern void pacer_wait (void);
 
 
+/** Move the next pacer tick.  This is for keeping the ticks in step
+    with another clock, say of another board (see @ref ir_clock).
+    @param ticks number of timer ticks to delay the next tick by; this
+    is negative to advance it.  */
+extern void pacer_adjust (int16_t ticks);
+
+
 /** Initialise pacer:
     @param pacer_rate rate in Hz.  */
 extern void pacer_init (pacer_rate_t pacer_rate);
@@ -302,7 +302,8 @@ void tinygl_draw_message (const char *string, tinygl_point_t pos,
 
     tinygl.pos = pos;
 
-    strncpy (tinygl.message, string, sizeof (tinygl.message));
+    strncpy (tinygl.message, string, sizeof (tinygl.message) - 1);
+    tinygl.message[sizeof (tinygl.message) - 1] = 0;
 
     if (tinygl.mode == TINYGL_TEXT_MODE_SCROLL)
     {